@@ -18,39 +18,164 @@
  */
 
 
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <boost/unordered_map.hpp>
 #include <graphlab.hpp>
+#include <graphlab/util/integer_mix.hpp>
+
+/*
+ * Labels are interned to dense integer ids when the graph is loaded, so
+ * that gathers count small integers rather than strings. NO_LABEL marks
+ * a vertex without a label (written "-" in the input), which does not
+ * vote.
+ */
+static const uint32_t NO_LABEL = uint32_t(-1);
+
+// Keep the labels of the labeled vertices of the input fixed
+bool SEMI_SUPERVISED = false;
+
+// The number of vertices which changed label in the current iteration
+graphlab::atomic<size_t> NUM_CHANGED;
+
+/*
+ * While the graph is loaded a label is the index of its string in the
+ * LOCAL_LABELS table of the machine which parsed it (origin). The
+ * indices are then replaced by ids into the global, sorted LABEL_NAMES.
+ */
+graphlab::mutex LABEL_LOCK;
+boost::unordered_map<std::string, uint32_t> LOCAL_LABEL_IDS;
+std::vector<std::string> LOCAL_LABELS;
+std::vector<std::string> LABEL_NAMES;
+std::vector<std::vector<uint32_t> > LOCAL_TO_GLOBAL;
+
+struct vertex_data : public graphlab::IS_POD_TYPE {
+  uint32_t label;
+  // the machine which interned the label, only used while loading
+  uint16_t origin;
+  // a labeled vertex in semi-supervised mode
+  bool seed;
+  vertex_data() : label(NO_LABEL), origin(0), seed(false) { }
+};
+
+
+/*
+ * Counts labels. The first INLINE_SIZE distinct labels are kept in an
+ * inline array, so the counter a gather returns for a single edge does
+ * not allocate. Beyond that the counts move to an open-addressing hash
+ * table with linear probing.
+ */
+class label_counter {
+public:
+  typedef std::pair<uint32_t, uint32_t> entry_type;
 
-struct label_counter {
-  std::map<std::string, int> label_count;
+  label_counter() : nsmall(0), ntable(0) { }
 
-  label_counter() {
+  // a single count of label
+  explicit label_counter(uint32_t label) : nsmall(0), ntable(0) {
+    if (label != NO_LABEL) add(label, 1);
   }
-    
-  label_counter& operator+=(const label_counter& other) { 
-    for ( std::map<std::string, int>::const_iterator iter = other.label_count.begin();
-              iter != other.label_count.end(); ++iter ) {
-            label_count[iter->first] += iter->second;
+
+  void add(uint32_t label, uint32_t count) {
+    if (table.empty()) {
+      for (size_t i = 0; i < nsmall; ++i) {
+        if (small[i].first == label) { small[i].second += count; return; }
+      }
+      if (nsmall < INLINE_SIZE) {
+        small[nsmall++] = entry_type(label, count);
+        return;
+      }
+      // spill the inline entries into the table
+      table.assign(4 * INLINE_SIZE, entry_type(NO_LABEL, 0));
+      ntable = 0;
+      for (size_t i = 0; i < nsmall; ++i) table_add(small[i].first, small[i].second);
+      nsmall = 0;
     }
+    table_add(label, count);
+  }
 
-    return *this; 
+  label_counter& operator+=(const label_counter& other) {
+    for (size_t i = 0; i < other.nsmall; ++i)
+      add(other.small[i].first, other.small[i].second);
+    for (size_t i = 0; i < other.table.size(); ++i) {
+      if (other.table[i].first != NO_LABEL)
+        add(other.table[i].first, other.table[i].second);
+    }
+    return *this;
+  }
+
+  /*
+   * The most frequent label. Ties keep the current label if it is among
+   * them, else go to the smallest id, so that the result does not
+   * depend on the order of the gathers. NO_LABEL if empty.
+   */
+  uint32_t most_frequent(uint32_t current) const {
+    uint32_t best = NO_LABEL, best_count = 0;
+    for (size_t i = 0; i < nsmall; ++i) consider(small[i], current, best, best_count);
+    for (size_t i = 0; i < table.size(); ++i) {
+      if (table[i].first != NO_LABEL) consider(table[i], current, best, best_count);
+    }
+    return best;
   }
 
   void save(graphlab::oarchive& oarc) const {
-    oarc << label_count;
+    std::vector<entry_type> entries(small, small + nsmall);
+    for (size_t i = 0; i < table.size(); ++i) {
+      if (table[i].first != NO_LABEL) entries.push_back(table[i]);
+    }
+    oarc << entries;
   }
 
   void load(graphlab::iarchive& iarc) {
-    iarc >> label_count;
+    std::vector<entry_type> entries;
+    iarc >> entries;
+    nsmall = 0; table.clear();
+    for (size_t i = 0; i < entries.size(); ++i)
+      add(entries[i].first, entries[i].second);
   }
-};
 
-// The vertex data is its label 
-typedef std::string vertex_data_type;
+private:
+  static const size_t INLINE_SIZE = 4;
+  entry_type small[INLINE_SIZE];
+  size_t nsmall;
+  // a power of two number of slots, free slots have the key NO_LABEL
+  std::vector<entry_type> table;
+  size_t ntable;
+
+  void table_add(uint32_t label, uint32_t count) {
+    const size_t mask = table.size() - 1;
+    size_t i = graphlab::integer_mix(label) & mask;
+    while (table[i].first != NO_LABEL && table[i].first != label) i = (i + 1) & mask;
+    if (table[i].first == label) { table[i].second += count; return; }
+    table[i] = entry_type(label, count);
+    // keep the load factor at most 1/2
+    if (2 * ++ntable > table.size()) {
+      std::vector<entry_type> old(2 * table.size(), entry_type(NO_LABEL, 0));
+      old.swap(table);
+      ntable = 0;
+      for (size_t j = 0; j < old.size(); ++j) {
+        if (old[j].first != NO_LABEL) table_add(old[j].first, old[j].second);
+      }
+    }
+  }
+
+  static void consider(const entry_type& e, uint32_t current,
+                       uint32_t& best, uint32_t& best_count) {
+    if (e.second > best_count ||
+        (e.second == best_count && best != current &&
+         (e.first == current || e.first < best))) {
+      best = e.first;
+      best_count = e.second;
+    }
+  }
+};
 
 typedef label_counter gather_type;
- 
+
 // The graph type is determined by the vertex and edge data types
-typedef graphlab::distributed_graph<std::string, graphlab::empty> graph_type;
+typedef graphlab::distributed_graph<vertex_data, graphlab::empty> graph_type;
 
 bool line_parser(graph_type& graph, const std::string& filename, const std::string& textline) {
   std::stringstream strm(textline);
@@ -59,8 +184,24 @@ bool line_parser(graph_type& graph, const std::string& filename, const std::stri
   // first entry in the line is a vertex ID
   strm >> vid;
   strm >> label;
+  // intern the label
+  vertex_data vdata;
+  if (label != "-") {
+    LABEL_LOCK.lock();
+    boost::unordered_map<std::string, uint32_t>::const_iterator iter =
+      LOCAL_LABEL_IDS.find(label);
+    if (iter == LOCAL_LABEL_IDS.end()) {
+      iter = LOCAL_LABEL_IDS.insert(std::make_pair(label,
+                                                   uint32_t(LOCAL_LABELS.size()))).first;
+      LOCAL_LABELS.push_back(label);
+    }
+    vdata.label = iter->second;
+    LABEL_LOCK.unlock();
+    vdata.origin = graphlab::distributed_control::get_instance()->procid();
+    vdata.seed = SEMI_SUPERVISED;
+  }
   // insert this vertex with its label 
-  graph.add_vertex(vid, label);
+  graph.add_vertex(vid, vdata);
   // while there are elements in the line, continue to read until we fail
   while(1){
     graphlab::vertex_id_type other_vid;
@@ -73,6 +214,40 @@ bool line_parser(graph_type& graph, const std::string& filename, const std::stri
   return true;
 }
 
+/*
+ * Builds the sorted table of all labels of all machines and the mapping
+ * from the local indices of each machine into it.
+ */
+void intern_labels(graphlab::distributed_control& dc) {
+  std::vector<std::vector<std::string> > all_labels(dc.numprocs());
+  all_labels[dc.procid()] = LOCAL_LABELS;
+  dc.all_gather(all_labels);
+  LABEL_NAMES.clear();
+  for (size_t p = 0; p < all_labels.size(); ++p) {
+    LABEL_NAMES.insert(LABEL_NAMES.end(), all_labels[p].begin(), all_labels[p].end());
+  }
+  std::sort(LABEL_NAMES.begin(), LABEL_NAMES.end());
+  LABEL_NAMES.erase(std::unique(LABEL_NAMES.begin(), LABEL_NAMES.end()),
+                    LABEL_NAMES.end());
+  LOCAL_TO_GLOBAL.resize(dc.numprocs());
+  for (size_t p = 0; p < all_labels.size(); ++p) {
+    LOCAL_TO_GLOBAL[p].resize(all_labels[p].size());
+    for (size_t i = 0; i < all_labels[p].size(); ++i) {
+      LOCAL_TO_GLOBAL[p][i] =
+        std::lower_bound(LABEL_NAMES.begin(), LABEL_NAMES.end(),
+                         all_labels[p][i]) - LABEL_NAMES.begin();
+    }
+  }
+  LOCAL_LABEL_IDS.clear();
+  LOCAL_LABELS.clear();
+}
+
+void globalize_label(graph_type::vertex_type& vertex) {
+  vertex_data& vdata = vertex.data();
+  if (vdata.label != NO_LABEL) vdata.label = LOCAL_TO_GLOBAL[vdata.origin][vdata.label];
+  vdata.origin = 0;
+}
+
 class labelpropagation :
   public graphlab::ivertex_program<graph_type, gather_type>,
   public graphlab::IS_POD_TYPE {
@@ -80,47 +255,27 @@ class labelpropagation :
 
   public:
     edge_dir_type gather_edges(icontext_type& context, const vertex_type& vertex) const {
-      return graphlab::ALL_EDGES;
+      return vertex.data().seed ? graphlab::NO_EDGES : graphlab::ALL_EDGES;
     }
 
     gather_type gather(icontext_type& context, const vertex_type& vertex, edge_type& edge) const {
       // figure out which data to get from the edge.
       bool isEdgeSource = (vertex.id() == edge.source().id());
-      std::string neighbor_label = isEdgeSource ? edge.target().data() : edge.source().data();
-
-      // make a label_counter and place the neighbor data in it
-      label_counter counter;
-      counter.label_count[neighbor_label] = 1;
-
-
-      // gather_type is a label counter, so += will add neighbor counts to the
-      // label_count map.
-      return counter;
+      return label_counter(isEdgeSource ? edge.target().data().label
+                                        : edge.source().data().label);
     }
 
     void apply(icontext_type& context, vertex_type& vertex, const gather_type& total) {
-
-      int maxCount = 0;
-
-      std::string maxLabel = vertex.data();
-
-      // Figure out which label of the vertex's neighbors' labels is most common
-      for ( std::map<std::string, int>::const_iterator iter = total.label_count.begin();
-                iter != total.label_count.end(); ++iter ) {
-              if (iter->second > maxCount) {
-                maxCount = iter->second;
-                maxLabel = iter->first;
-              }
-      }
-
-      
+      changed = false;
+      // seeds keep their label
+      if (vertex.data().seed) return;
+      const uint32_t max_label = total.most_frequent(vertex.data().label);
       // if maxLabel differs to vertex data, mark vertex as changed and update
       // its data.
-      if ((vertex.data()).compare(maxLabel) != 0) {
+      if (max_label != NO_LABEL && max_label != vertex.data().label) {
         changed = true;
-        vertex.data() = maxLabel;
-      } else {
-        changed = false;
+        vertex.data().label = max_label;
+        NUM_CHANGED.inc();
       }
     }
 
@@ -143,7 +298,9 @@ class labelpropagation :
 struct labelpropagation_writer {
   std::string save_vertex(graph_type::vertex_type v) {
     std::stringstream strm;
-    strm << v.id() << "\t" << v.data() << "\n";
+    strm << v.id() << "\t"
+         << (v.data().label == NO_LABEL ? "-" : LABEL_NAMES[v.data().label])
+         << "\n";
     return strm.str();
   }
   std::string save_edge (graph_type::edge_type e) { return ""; }
@@ -160,13 +317,25 @@ int main(int argc, char** argv) {
   graphlab::command_line_options clopts("Label Propagation algorithm.");
   std::string graph_dir;
   std::string execution_type = "synchronous";
+  double tolerance = 0;
+  size_t max_iterations = 100;
   clopts.attach_option("graph", graph_dir, "The graph file. Required ");
   clopts.add_positional("graph");
   clopts.attach_option("execution", execution_type, "Execution type (synchronous or asynchronous)");
+  clopts.attach_option("semi_supervised", SEMI_SUPERVISED,
+                       "If true, the labeled vertices are seeds which keep "
+                       "their label, and the labels spread to the "
+                       "unlabeled (\"-\") vertices.");
+  clopts.attach_option("tol", tolerance,
+                       "Synchronous execution stops once the fraction of "
+                       "vertices changing label in an iteration is at "
+                       "most tol.");
+  clopts.attach_option("iterations", max_iterations,
+                       "The maximum number of synchronous iterations.");
 
   std::string saveprefix;
   clopts.attach_option("saveprefix", saveprefix,
-                       "If set, will save the resultant pagerank to a "
+                       "If set, will save the resultant labels to a "
                        "sequence of files with prefix saveprefix");
 
   if(!clopts.parse(argc, argv)) {
@@ -184,15 +353,34 @@ int main(int argc, char** argv) {
   graph.load(graph_dir, line_parser);
   // must call finalize before querying the graph
   graph.finalize();
+  intern_labels(dc);
+  graph.transform_vertices(globalize_label);
+
+  dc.cout() << "#vertices: " << graph.num_vertices() << " #edges:" << graph.num_edges()
+            << " #labels: " << LABEL_NAMES.size() << std::endl;
+
+  graphlab::timer ti; ti.start();
+  if (execution_type == "synchronous") {
+    // one iteration per start() to check the fraction of changed labels
+    clopts.get_engine_args().set_option("max_iterations", 1);
+    graphlab::omni_engine<labelpropagation> engine(dc, graph, execution_type, clopts);
+    engine.signal_all();
+    for (size_t iter = 0; iter < max_iterations; ++iter) {
+      NUM_CHANGED = 0;
+      engine.start();
+      size_t num_changed = NUM_CHANGED.value;
+      dc.all_reduce(num_changed);
+      dc.cout() << "Iteration " << iter + 1 << ": " << num_changed
+                << " labels changed" << std::endl;
+      if (num_changed <= tolerance * graph.num_vertices()) break;
+    }
+  } else {
+    graphlab::omni_engine<labelpropagation> engine(dc, graph, execution_type, clopts);
+    engine.signal_all();
+    engine.start();
+  }
 
-  dc.cout() << "#vertices: " << graph.num_vertices() << " #edges:" << graph.num_edges() << std::endl;
-
-  graphlab::omni_engine<labelpropagation> engine(dc, graph, execution_type, clopts);
-
-  engine.signal_all();
-  engine.start();
-
-  const float runtime = engine.elapsed_seconds();
+  const float runtime = ti.current_time();
   dc.cout() << "Finished Running engine in " << runtime << " seconds." << std::endl;
 
   if (saveprefix != "") {
@@ -65,8 +65,9 @@ namespace graphlab {
         PlusEqual plusequal;
 
     public:
-        distributed_data(distributed_control& dc,
-                boost::unordered_set<graphlab::vertex_id_type>* sources,
+        /// SourceSet is any container of vertex ids, e.g. source_set
+        template <typename SourceSet>
+        distributed_data(distributed_control& dc, const SourceSet* sources,
                 PlusEqual plusequal):
             rmi(dc, this), plusequal(plusequal) {
             for (auto const& source: *sources) {
@@ -25,25 +25,43 @@
 
 #include <graphlab.hpp>
 
+#include "source_set.hpp"
+
 typedef float float_type;
 // Global random reset probability
 const float_type RESET_PROB = 0.15;
 float_type threshold;
 int niters;
-boost::unordered_set<graphlab::vertex_id_type> *sources = NULL;
+bool use_delta_cache;
+graphlab::source_set *sources = NULL;
 
 enum phase_t {INIT_GRAPH, COMPUTE};
 phase_t phase = INIT_GRAPH;
+// whether mirrors need the PPR vectors (only read by backward gathers)
+bool sync_ppr = false;
 
 typedef boost::unordered_map<graphlab::vertex_id_type, uint16_t> map_t;
 typedef boost::unordered_map<graphlab::vertex_id_type, float_type> ppr_t;
 
-struct VertexData {
+struct VertexData : public graphlab::HAS_MIRROR_DATA {
     ppr_t ppr;
     graphlab::dense_bitset schedule;
 
     VertexData() : ppr(), schedule(niters) {}
 
+    // mirrors need the schedule for gather_edges, and the PPR vectors
+    // once the backward expansion gathers them
+    void save_mirror(graphlab::oarchive& oarc) const {
+        oarc << schedule << sync_ppr;
+        if (sync_ppr) oarc << ppr;
+    }
+
+    void load_mirror(graphlab::iarchive& iarc) {
+        bool has_ppr;
+        iarc >> schedule >> has_ppr;
+        if (has_ppr) iarc >> ppr;
+    }
+
     void save(graphlab::oarchive& oarc) const {
         if (phase == INIT_GRAPH) {
             map_t counter;
@@ -120,7 +138,7 @@ public:
     void init(icontext_type& context, const vertex_type& vertex,
             const message_type& msg) {
         if (context.iteration() == 0) {
-            if (sources == NULL || sources->find(vertex.id()) != sources->end())
+            if (sources == NULL || sources->contains_vertex(vertex))
                 flow = 1.0;
         } else
             flow = msg.value;
@@ -169,8 +187,18 @@ public:
     }
 };
 
+/**
+ * With delta caching (the default), a vertex keeps the sum of the PPR
+ * vectors of its out-neighbors in the engine's gather cache. A vertex
+ * whose PPR changed posts the sparse difference to its in-neighbors,
+ * so a full gather is only run the first time a vertex is scheduled.
+ */
 class BackwardExpansion : public graphlab::ivertex_program<graph_type,
-    ppr_gather_t>, public graphlab::IS_POD_TYPE {
+    ppr_gather_t> {
+private:
+    // new ppr - old ppr, only the entries which changed
+    ppr_gather_t delta;
+
 public:
     void init(icontext_type& context, const vertex_type& vertex,
             const message_type& msg) {
@@ -193,12 +221,14 @@ public:
     void apply(icontext_type& context, vertex_type& vertex,
             const gather_type& total) {
         if (vertex.data().schedule.get(niters-context.iteration()-1)) {
-            vertex.data().ppr = total.ppr;
+            ppr_t ppr = total.ppr;
             float_type c = (1-RESET_PROB) / vertex.num_out_edges();
-            for (ppr_t::iterator it = vertex.data().ppr.begin();
-                    it != vertex.data().ppr.end(); it++)
+            for (ppr_t::iterator it = ppr.begin(); it != ppr.end(); it++)
                 it->second *= c;
-            vertex.data().ppr[vertex.id()] += RESET_PROB;
+            ppr[vertex.id()] += RESET_PROB;
+            if (use_delta_cache)
+                diff(ppr, vertex.data().ppr);
+            vertex.data().ppr.swap(ppr);
         }
         if (context.iteration() < niters-1 &&
                 vertex.data().schedule.get(niters-context.iteration()-2))
@@ -207,11 +237,39 @@ public:
 
     edge_dir_type scatter_edges(icontext_type& context,
             const vertex_type& vertex) const {
-        return graphlab::NO_EDGES;
+        if (delta.empty())
+            return graphlab::NO_EDGES;
+        else
+            return graphlab::IN_EDGES;
     }
 
     void scatter(icontext_type& context, const vertex_type& vertex,
-            edge_type& edge) const { }
+            edge_type& edge) const {
+        context.post_delta(edge.source(), delta);
+    }
+
+    void save(graphlab::oarchive& oarc) const {
+        oarc << delta;
+    }
+
+    void load(graphlab::iarchive& iarc) {
+        iarc >> delta;
+    }
+
+private:
+    // delta = next - prev
+    void diff(const ppr_t& next, const ppr_t& prev) {
+        delta.ppr.clear();
+        for (ppr_t::const_iterator it = next.begin(); it != next.end(); it++) {
+            ppr_t::const_iterator old = prev.find(it->first);
+            float_type d = it->second - (old == prev.end() ? 0 : old->second);
+            if (d != 0) delta.ppr[it->first] = d;
+        }
+        for (ppr_t::const_iterator it = prev.begin(); it != prev.end(); it++) {
+            if (next.find(it->first) == next.end())
+                delta.ppr[it->first] = -it->second;
+        }
+    }
 };
 
 bool compare(const std::pair<graphlab::vertex_id_type, float_type>& firstElem,
@@ -266,6 +324,10 @@ int main(int argc, char** argv) {
     clopts.attach_option("saveprefix", saveprefix,
             "If set, will save the whole graph to a "
             "sequence of files with prefix saveprefix");
+    use_delta_cache = true;
+    clopts.attach_option("delta_cache", use_delta_cache,
+            "Keep the gather of the backward expansion in the engine's "
+            "cache and only propagate the changes of PPR vectors");
     size_t topk = 100;
     clopts.attach_option("topk", topk,
             "Output top-k elements of PPR vectors");
@@ -281,7 +343,6 @@ int main(int argc, char** argv) {
         return EXIT_FAILURE;
     }
 
-    clopts.get_engine_args().set_option("enable_sync_vertex_data", false);
     clopts.get_engine_args().set_option("max_iterations", niters);
 
     // Build the graph ----------------------------------------------------------
@@ -297,15 +358,9 @@ int main(int argc, char** argv) {
     dc.cout() << "loading : " << runtime << " seconds" << std::endl;
 
     if (sources_file.length() > 0) {
-        sources = new boost::unordered_set<graphlab::vertex_id_type>();
-        std::ifstream fin(sources_file.c_str());
-        int num_sources;
-        fin >> num_sources;
-        for (int i = 0; i < std::min(num_sources, max_num_sources); i++) {
-            graphlab::vertex_id_type vid;
-            fin >> vid;
-            sources->insert(vid);
-        }
+        sources = new graphlab::source_set();
+        sources->load(sources_file, max_num_sources);
+        sources->index(graph);
     }
 
     // Running The Engine -------------------------------------------------------
@@ -313,12 +368,19 @@ int main(int argc, char** argv) {
     graphlab::synchronous_engine<ForwardExpansion> *engine = new
         graphlab::synchronous_engine<ForwardExpansion>(dc, graph, clopts);
     graphlab::timer timer;
-    engine->signal_all();
+    if (sources) {
+        // only the sources start in the first iteration
+        engine->signal_vids(sources->list(), max_combiner(), true);
+    } else {
+        engine->signal_all();
+    }
     engine->start();
     dc.cout() << "forward : " << engine->elapsed_seconds() <<
         " seconds" << std::endl;
     delete engine;
 
+    sync_ppr = true;
+    clopts.get_engine_args().set_option("use_cache", use_delta_cache);
     graphlab::synchronous_engine<BackwardExpansion> engine2(dc, graph, clopts);
     engine2.signal_all();
     engine2.start();
@@ -27,6 +27,7 @@
 #include <graphlab.hpp>
 
 #include "distributed_data.hpp"
+#include "source_set.hpp"
 
 typedef float float_type;
 
@@ -36,7 +37,7 @@ const float_type RESET_PROB = 0.15;
 float_type threshold;
 int niters;
 bool no_index;
-boost::unordered_set<graphlab::vertex_id_type> *sources = NULL;
+graphlab::source_set *sources = NULL;
 
 enum phase_t {INIT_GRAPH, COMPUTE};
 phase_t phase = INIT_GRAPH;
@@ -53,6 +54,9 @@ void plusequal(vec_map2_t& a, const vec_map2_t& b) {
     }
 }
 
+DECLARE_SAMPLED_TRACER(ppr_vec_serialize, "PPR Vector Serialization")
+DECLARE_SAMPLED_TRACER(ppr_vec_add, "PPR Vector Add")
+
 template <typename T>
 struct vec_type {
     typedef T map_type;
@@ -66,11 +70,15 @@ struct vec_type {
     vec_type(vec_type&& other) : val(std::move(other.val)) { }
 
     inline void save(graphlab::oarchive& oarc) const {
+        BEGIN_SAMPLED_TRACEPOINT(ppr_vec_serialize);
         oarc << val;
+        END_SAMPLED_TRACEPOINT(ppr_vec_serialize);
     }
 
     inline void load(graphlab::iarchive& iarc) {
+        BEGIN_SAMPLED_TRACEPOINT(ppr_vec_serialize);
         iarc >> val;
+        END_SAMPLED_TRACEPOINT(ppr_vec_serialize);
     }
 
     inline bool empty() const {
@@ -82,9 +90,11 @@ struct vec_type {
     }
 
     vec_type& operator+=(const vec_type& other) {
+        BEGIN_SAMPLED_TRACEPOINT(ppr_vec_add);
         for (auto it = other.val.begin(); it != other.val.end(); ++it) {
             val[it->first] += it->second;
         }
+        END_SAMPLED_TRACEPOINT(ppr_vec_add);
         return *this;
     }
 
@@ -148,7 +158,7 @@ public:
     void init(icontext_type& context, const vertex_type& vertex,
             const message_type& msg) {
         if (context.iteration() == 0) {
-            if (sources->find(vertex.id()) != sources->end())
+            if (sources->contains_vertex(vertex))
                 flow.val[vertex.id()] = 1.0;
         } else
             flow = std::move(msg);
@@ -208,7 +218,10 @@ public:
     }
 };
 
+DECLARE_SAMPLED_TRACER(ppr_sum_up, "PPR Sum Up")
+
 graphlab::empty sum_up(const graph_type::vertex_type& vertex) {
+    BEGIN_SAMPLED_TRACEPOINT(ppr_sum_up);
     if (!no_index) {
         for (auto it = vertex.data().flow.val.begin(); it !=
                 vertex.data().flow.val.end(); ++it) {
@@ -238,6 +251,7 @@ graphlab::empty sum_up(const graph_type::vertex_type& vertex) {
         results->unlock(it->first);
     }
 
+    END_SAMPLED_TRACEPOINT(ppr_sum_up);
     return graphlab::empty();
 }
 
@@ -253,7 +267,7 @@ struct pagerank_writer {
 
     std::string save_vertex(graph_type::vertex_type vertex) {
         std::stringstream strm;
-        if (sources->find(vertex.id()) != sources->end()) {
+        if (sources->contains_vertex(vertex)) {
             strm << vertex.id();
             auto& ppr = results->get_data(vertex.id());
             std::vector<std::pair<graphlab::vertex_id_type, float_type> >
@@ -348,6 +362,10 @@ int main(int argc, char** argv) {
     no_index = false;
     clopts.attach_option("no_index", no_index,
             "Compute PPR vectors without preprocessed index.");
+    bool metrics = false;
+    clopts.attach_option("metrics", metrics,
+            "Serve /metrics (including query latency) on port 8090 "
+            "of machine 0.");
 
     if(!clopts.parse(argc, argv)) {
         dc.cout() << "Error in parsing command line arguments." << std::endl;
@@ -356,6 +374,10 @@ int main(int argc, char** argv) {
 
     clopts.get_engine_args().set_option("enable_sync_vertex_data", false);
     clopts.get_engine_args().set_option("max_iterations", ++niters);
+    if (metrics) graphlab::launch_metric_server();
+    graphlab::latency_histogram& query_latency =
+        graphlab::get_latency_histogram("graphlab_ppr_query_seconds",
+                "End-to-end runtime of a batch of PPR queries");
 
     // Build the graph ----------------------------------------------------------
     double start_time = graphlab::timer::approx_time_seconds();
@@ -396,15 +418,9 @@ int main(int argc, char** argv) {
         if (sources_file.length() > 0) {
             if (sources)
                 delete sources;
-            sources = new boost::unordered_set<graphlab::vertex_id_type>();
-            std::ifstream fin(sources_file.c_str());
-            int total_sources;
-            fin >> total_sources;
-            for (int i = 0; i < std::min(total_sources, num_sources); ++i) {
-                graphlab::vertex_id_type vid;
-                fin >> vid;
-                sources->insert(vid);
-            }
+            sources = new graphlab::source_set();
+            sources->load(sources_file, num_sources);
+            sources->index(graph);
         } else {
             assert(true);
         }
@@ -417,7 +433,12 @@ int main(int argc, char** argv) {
             delete results;
         results = new graphlab::distributed_data<vec_map2_t>(dc, sources, plusequal);
         graphlab::timer timer;
-        engine->signal_all();
+        if (sources) {
+            // only the sources start in the first iteration
+            engine->signal_vids(sources->list(), vec_t(), true);
+        } else {
+            engine->signal_all();
+        }
         engine->start();
         dc.cout() << "decomposition : " << engine->elapsed_seconds() <<
             " seconds" << std::endl;
@@ -435,6 +456,7 @@ int main(int argc, char** argv) {
 
         dc.cout() << "runtime : " << timer.current_time() << " seconds" <<
             std::endl;
+        query_latency.observe(timer.current_time());
 
         delete engine;
     }
@@ -453,6 +475,7 @@ int main(int argc, char** argv) {
     delete sources;
     runtime = graphlab::timer::approx_time_seconds() - start_time;
     dc.cout() << "save : " << runtime << " seconds" << std::endl;
+    if (metrics) graphlab::stop_metric_server();
 
     // Tear-down communication layer and quit -----------------------------------
     graphlab::mpi_tools::finalize();
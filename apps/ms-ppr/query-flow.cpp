@@ -26,6 +26,8 @@
 
 #include <graphlab.hpp>
 
+#include "source_set.hpp"
+
 typedef float float_type;
 
 // Global random reset probability
@@ -34,7 +36,7 @@ const float_type RESET_PROB = 0.15;
 float_type threshold;
 int niters;
 bool no_index;
-boost::unordered_set<graphlab::vertex_id_type> *sources = NULL;
+graphlab::source_set *sources = NULL;
 
 enum phase_t {INIT_GRAPH, COMPUTE};
 phase_t phase = INIT_GRAPH;
@@ -43,6 +45,9 @@ typedef boost::container::flat_map<graphlab::vertex_id_type, uint16_t> map_t;
 typedef boost::container::flat_map<graphlab::vertex_id_type, float_type> vec_map_t;
 typedef boost::unordered_map<graphlab::vertex_id_type, float_type> vec_map2_t;
 
+DECLARE_SAMPLED_TRACER(ppr_vec_serialize, "PPR Vector Serialization")
+DECLARE_SAMPLED_TRACER(ppr_vec_add, "PPR Vector Add")
+
 template <typename T>
 struct vec_type {
     typedef T map_type;
@@ -56,11 +61,15 @@ struct vec_type {
     vec_type(vec_type&& other) : val(std::move(other.val)) { }
 
     inline void save(graphlab::oarchive& oarc) const {
+        BEGIN_SAMPLED_TRACEPOINT(ppr_vec_serialize);
         oarc << val;
+        END_SAMPLED_TRACEPOINT(ppr_vec_serialize);
     }
 
     inline void load(graphlab::iarchive& iarc) {
+        BEGIN_SAMPLED_TRACEPOINT(ppr_vec_serialize);
         iarc >> val;
+        END_SAMPLED_TRACEPOINT(ppr_vec_serialize);
     }
 
     inline bool empty() const {
@@ -72,9 +81,11 @@ struct vec_type {
     }
 
     vec_type& operator+=(const vec_type& other) {
+        BEGIN_SAMPLED_TRACEPOINT(ppr_vec_add);
         for (auto it = other.val.begin(); it != other.val.end(); ++it) {
             val[it->first] += it->second;
         }
+        END_SAMPLED_TRACEPOINT(ppr_vec_add);
         return *this;
     }
 
@@ -141,7 +152,7 @@ public:
     void init(icontext_type& context, const vertex_type& vertex,
             const message_type& msg) {
         if (context.iteration() == 0) {
-            if (sources == NULL || sources->find(vertex.id()) != sources->end())
+            if (sources == NULL || sources->contains_vertex(vertex))
                 flow.val[vertex.id()] = 1.0;
         } else
             flow = std::move(msg);
@@ -373,15 +384,9 @@ int main(int argc, char** argv) {
     dc.cout() << "loading : " << runtime << " seconds" << std::endl;
 
     if (sources_file.length() > 0) {
-        sources = new boost::unordered_set<graphlab::vertex_id_type>();
-        std::ifstream fin(sources_file.c_str());
-        int num_sources;
-        fin >> num_sources;
-        for (int i = 0; i < std::min(num_sources, max_num_sources); ++i) {
-            graphlab::vertex_id_type vid;
-            fin >> vid;
-            sources->insert(vid);
-        }
+        sources = new graphlab::source_set();
+        sources->load(sources_file, max_num_sources);
+        sources->index(graph);
     }
 
     // Running The Engine -------------------------------------------------------
@@ -389,7 +394,12 @@ int main(int argc, char** argv) {
     graphlab::synchronous_engine<DecompositionProgram> *engine = new
         graphlab::synchronous_engine<DecompositionProgram>(dc, graph, clopts);
     graphlab::timer timer;
-    engine->signal_all();
+    if (sources) {
+        // only the sources start in the first iteration
+        engine->signal_vids(sources->list(), vec_t(), true);
+    } else {
+        engine->signal_all();
+    }
     engine->start();
     dc.cout() << "decomposition : " << engine->elapsed_seconds() <<
         " seconds" << std::endl;
@@ -25,13 +25,15 @@
 
 #include <graphlab.hpp>
 
+#include "source_set.hpp"
+
 // Global random reset probability
 const double RESET_PROB = 0.15;
 
 uint16_t num_walkers;
 size_t niters;
 size_t degree_threshold;
-boost::unordered_set<graphlab::vertex_id_type> *sources = NULL;
+graphlab::source_set *sources = NULL;
 
 typedef boost::unordered_map<graphlab::vertex_id_type, uint16_t> map_t;
 
@@ -84,7 +86,7 @@ public:
             const message_type& msg) {
         if (context.iteration() == 0) {
             walkers = Counter();
-            if ((sources == NULL || sources->find(vertex.id()) != sources->end())
+            if ((sources == NULL || sources->contains_vertex(vertex))
                     && vertex.num_in_edges() >= degree_threshold)
                 walkers.counter[vertex.id()] = num_walkers;
         } else
@@ -238,7 +240,7 @@ struct pagerank_writer {
 };
 
 graphlab::vertex_id_type count_hubs(graph_type::vertex_type vertex) {
-    return ((sources == NULL || sources->find(vertex.id()) != sources->end())
+    return ((sources == NULL || sources->contains_vertex(vertex))
             && vertex.num_in_edges() >= degree_threshold);
 }
 
@@ -321,15 +323,9 @@ int main(int argc, char** argv) {
     dc.cout() << "loading : " << runtime << " seconds" << std::endl;
 
     if (sources_file.length() > 0) {
-        sources = new boost::unordered_set<graphlab::vertex_id_type>();
-        std::ifstream fin(sources_file.c_str());
-        int num_sources;
-        fin >> num_sources;
-        for (int i = 0; i < std::min(num_sources, max_num_sources); i++) {
-            graphlab::vertex_id_type vid;
-            fin >> vid;
-            sources->insert(vid);
-        }
+        sources = new graphlab::source_set();
+        sources->load(sources_file, max_num_sources);
+        sources->index(graph);
     }
 
     if (degree_threshold > 0) {
@@ -343,7 +339,12 @@ int main(int argc, char** argv) {
     graphlab::synchronous_engine<PreprocessProgram> *engine = new
         graphlab::synchronous_engine<PreprocessProgram>(dc, graph, clopts);
     graphlab::timer timer;
-    engine->signal_all();
+    if (sources) {
+        // only the sources start in the first iteration
+        engine->signal_vids(sources->list(), MessageData(), true);
+    } else {
+        engine->signal_all();
+    }
     engine->start();
     dc.cout() << "jumping : " << engine->elapsed_seconds() << " seconds" <<
         std::endl;
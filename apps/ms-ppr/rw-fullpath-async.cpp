@@ -25,12 +25,14 @@
 
 #include <graphlab.hpp>
 
+#include "source_set.hpp"
+
 // Global random reset probability
 const double RESET_PROB = 0.15;
 
 uint16_t num_walkers;
 size_t degree_threshold;
-boost::unordered_set<graphlab::vertex_id_type> *sources = NULL;
+graphlab::source_set *sources = NULL;
 
 typedef boost::unordered_map<graphlab::vertex_id_type, uint16_t> map_t;
 
@@ -148,7 +150,7 @@ public:
 void init_vertex(graphlab::async_consistent_engine<PreprocessProgram>::icontext_type& context,
         graph_type::vertex_type& vertex) {
     Counter walkers;
-    if ((sources == NULL || sources->find(vertex.id()) != sources->end())
+    if ((sources == NULL || sources->contains_vertex(vertex))
             && vertex.num_in_edges() >= degree_threshold)
         walkers.counter[vertex.id()] = num_walkers;
     context.signal(vertex, walkers);
@@ -239,7 +241,7 @@ struct pagerank_writer {
 };
 
 graphlab::vertex_id_type count_hubs(graph_type::vertex_type vertex) {
-    return ((sources == NULL || sources->find(vertex.id()) != sources->end())
+    return ((sources == NULL || sources->contains_vertex(vertex))
             && vertex.num_in_edges() >= degree_threshold);
 }
 
@@ -316,15 +318,9 @@ int main(int argc, char** argv) {
     dc.cout() << "loading : " << runtime << " seconds" << std::endl;
 
     if (sources_file.length() > 0) {
-        sources = new boost::unordered_set<graphlab::vertex_id_type>();
-        std::ifstream fin(sources_file.c_str());
-        int num_sources;
-        fin >> num_sources;
-        for (int i = 0; i < std::min(num_sources, max_num_sources); i++) {
-            graphlab::vertex_id_type vid;
-            fin >> vid;
-            sources->insert(vid);
-        }
+        sources = new graphlab::source_set();
+        sources->load(sources_file, max_num_sources);
+        sources->index(graph);
     }
 
     if (degree_threshold > 0) {
@@ -25,6 +25,8 @@
 
 #include <graphlab.hpp>
 
+#include "source_set.hpp"
+
 // Global random reset probability
 const double RESET_PROB = 0.15;
 
@@ -32,21 +34,29 @@ uint16_t num_walkers;
 size_t niters;
 size_t degree_threshold;
 bool long_path;
-boost::unordered_set<graphlab::vertex_id_type> *sources = NULL;
+graphlab::source_set *sources = NULL;
 
 typedef boost::unordered_map<graphlab::vertex_id_type, uint16_t> map_t;
 
+DECLARE_SAMPLED_TRACER(rw_counter_serialize, "RW Counter Serialization")
+DECLARE_SAMPLED_TRACER(rw_counter_add, "RW Counter Add")
+DECLARE_SAMPLED_TRACER(rw_select_prob, "RW Select Prob")
+
 struct Counter {
     map_t counter;
 
     Counter() : counter() { }
 
     void save(graphlab::oarchive& oarc) const {
+        BEGIN_SAMPLED_TRACEPOINT(rw_counter_serialize);
         oarc << counter;
+        END_SAMPLED_TRACEPOINT(rw_counter_serialize);
     }
 
     void load(graphlab::iarchive& iarc) {
+        BEGIN_SAMPLED_TRACEPOINT(rw_counter_serialize);
         iarc >> counter;
+        END_SAMPLED_TRACEPOINT(rw_counter_serialize);
     }
 
     bool empty() const {
@@ -54,9 +64,11 @@ struct Counter {
     }
 
     Counter& operator+=(const Counter& other) {
+        BEGIN_SAMPLED_TRACEPOINT(rw_counter_add);
         for (map_t::const_iterator it = other.counter.begin();
                 it != other.counter.end(); it++)
             counter[it->first] += it->second;
+        END_SAMPLED_TRACEPOINT(rw_counter_add);
         return *this;
     }
 };
@@ -69,9 +81,11 @@ typedef Counter MessageData;
 typedef graphlab::distributed_graph<VertexData, EdgeData> graph_type;
 
 inline uint16_t select_prob(uint16_t count, double prob = 1-RESET_PROB) {
+    BEGIN_SAMPLED_TRACEPOINT(rw_select_prob);
     double remain = count * prob;
     uint16_t new_count = (uint16_t) remain;
     new_count += (graphlab::random::rand01() < remain-new_count) ? 1 : 0;
+    END_SAMPLED_TRACEPOINT(rw_select_prob);
     return new_count;
 }
 
@@ -85,7 +99,7 @@ public:
             const message_type& msg) {
         if (context.iteration() == 0) {
             walkers = Counter();
-            if ((sources == NULL || sources->find(vertex.id()) != sources->end())
+            if ((sources == NULL || sources->contains_vertex(vertex))
                     && vertex.num_in_edges() >= degree_threshold)
                 walkers.counter[vertex.id()] = num_walkers;
         } else
@@ -243,7 +257,7 @@ struct pagerank_writer {
 };
 
 graphlab::vertex_id_type count_hubs(graph_type::vertex_type vertex) {
-    return ((sources == NULL || sources->find(vertex.id()) != sources->end())
+    return ((sources == NULL || sources->contains_vertex(vertex))
             && vertex.num_in_edges() >= degree_threshold);
 }
 
@@ -339,15 +353,9 @@ int main(int argc, char** argv) {
         int num_sources = num_sources_vec[i];
         if (sources_file.length() > 0) {
             dc.cout() << "num_sources : " << num_sources << std::endl;
-            sources = new boost::unordered_set<graphlab::vertex_id_type>();
-            std::ifstream fin(sources_file.c_str());
-            int total_sources;
-            fin >> total_sources;
-            for (int i = 0; i < std::min(total_sources, num_sources); i++) {
-                graphlab::vertex_id_type vid;
-                fin >> vid;
-                sources->insert(vid);
-            }
+            sources = new graphlab::source_set();
+            sources->load(sources_file, num_sources);
+            sources->index(graph);
         }
 
         if (degree_threshold > 0) {
@@ -362,7 +370,12 @@ int main(int argc, char** argv) {
         graphlab::synchronous_engine<PreprocessProgram> *engine = new
             graphlab::synchronous_engine<PreprocessProgram>(dc, graph, clopts);
         graphlab::timer timer;
-        engine->signal_all();
+        if (sources) {
+            // only the sources start in the first iteration
+            engine->signal_vids(sources->list(), MessageData(), true);
+        } else {
+            engine->signal_all();
+        }
         engine->start();
         dc.cout() << "jumping : " << engine->elapsed_seconds() << " seconds" <<
             std::endl;
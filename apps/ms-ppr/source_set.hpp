@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) 2015 Qin Liu.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ */
+
+#ifndef GRAPHLAB_SOURCE_SET_HPP
+#define GRAPHLAB_SOURCE_SET_HPP
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <algorithm>
+
+#include <graphlab/logger/logger.hpp>
+#include <graphlab/graph/graph_basic_types.hpp>
+#include <graphlab/util/dense_bitset.hpp>
+#include <graphlab/util/bloom_filter.hpp>
+
+namespace graphlab {
+    /**
+     * The set of PPR sources of a batch.
+     *
+     * The sources are kept as a sorted vector of global ids behind a
+     * Bloom filter, so contains() on an id which is not a source (the
+     * common case) usually costs one cache line. After index(graph),
+     * contains_vertex() is a single bit test keyed by the local vertex
+     * id, which is what the per-vertex checks in the vertex programs and
+     * map-reduce functions use.
+     *
+     * The set is built once per batch and must not be modified while
+     * it is read by the engine.
+     */
+    class source_set {
+    private:
+        std::vector<vertex_id_type> vids;
+        bloom_filter filter;
+        dense_bitset local_sources;
+        bool indexed;
+
+    public:
+        typedef std::vector<vertex_id_type>::const_iterator const_iterator;
+
+        source_set() : indexed(false) { }
+
+        template <typename Iterator>
+        source_set(Iterator begin, Iterator end) : indexed(false) {
+            assign(begin, end);
+        }
+
+        /// Replace the sources by the ids in [begin, end)
+        template <typename Iterator>
+        void assign(Iterator begin, Iterator end) {
+            vids.assign(begin, end);
+            std::sort(vids.begin(), vids.end());
+            vids.erase(std::unique(vids.begin(), vids.end()), vids.end());
+            filter.init(vids.size());
+            for (size_t i = 0; i < vids.size(); ++i) filter.insert(vids[i]);
+            indexed = false;
+        }
+
+        /**
+         * Read the first max_sources ids of a sources file, which
+         * contains the number of ids followed by the ids.
+         */
+        void load(const std::string& fname, size_t max_sources) {
+            std::ifstream fin(fname.c_str());
+            if (!fin.good()) {
+                logstream(LOG_FATAL) << "Cannot open sources file " << fname
+                    << std::endl;
+            }
+            size_t total_sources = 0;
+            fin >> total_sources;
+            std::vector<vertex_id_type> list;
+            list.reserve(std::min(total_sources, max_sources));
+            for (size_t i = 0; i < std::min(total_sources, max_sources); ++i) {
+                vertex_id_type vid;
+                fin >> vid;
+                list.push_back(vid);
+            }
+            assign(list.begin(), list.end());
+        }
+
+        /**
+         * Build the bitset of the sources present on this machine keyed
+         * by local vertex id. Must be called again if the graph changes.
+         */
+        template <typename Graph>
+        void index(const Graph& graph) {
+            local_sources.resize(graph.num_local_vertices());
+            local_sources.clear();
+            for (size_t i = 0; i < vids.size(); ++i) {
+                if (graph.contains_vertex(vids[i]))
+                    local_sources.set_bit_unsync(graph.local_vid(vids[i]));
+            }
+            indexed = true;
+        }
+
+        /// Returns true if vid is a source
+        inline bool contains(vertex_id_type vid) const {
+            return filter.may_contain(vid) &&
+                std::binary_search(vids.begin(), vids.end(), vid);
+        }
+
+        /// Returns true if the vertex is a source, using the index if built
+        template <typename Vertex>
+        inline bool contains_vertex(const Vertex& vertex) const {
+            if (indexed) return local_sources.get(vertex.local_id());
+            return contains(vertex.id());
+        }
+
+        inline size_t size() const { return vids.size(); }
+        inline bool empty() const { return vids.empty(); }
+        inline const_iterator begin() const { return vids.begin(); }
+        inline const_iterator end() const { return vids.end(); }
+
+        /// The sources as a sorted vector
+        inline const std::vector<vertex_id_type>& list() const { return vids; }
+    };
+} // end of namespace graphlab
+
+#endif
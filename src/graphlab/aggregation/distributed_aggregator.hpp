@@ -889,6 +889,44 @@ namespace graphlab {
       }
     }
 
+    /**
+     * Returns the time left until each scheduled periodic aggregator
+     * runs next. The result is the same on all machines.
+     * Must be called on all machines simultaneously.
+     */
+    std::vector<std::pair<std::string, float> > get_schedule() {
+      float curtime = timer::approx_time_seconds() - start_time;
+      rmi.broadcast(curtime, rmi.procid() == 0);
+      std::vector<std::pair<std::string, float> > ret;
+      schedule_lock.lock();
+      // the first heap element is unused
+      for (size_t i = 1; i < schedule.values().size(); ++i) {
+        const std::pair<std::string, float>& entry = schedule.values()[i];
+        ret.push_back(std::make_pair(entry.first,
+                                     std::max(-entry.second - curtime, 0.0f)));
+      }
+      schedule_lock.unlock();
+      return ret;
+    }
+
+    /**
+     * Replaces the schedule with one returned by get_schedule(), for
+     * instance to resume from an engine checkpoint. Keys which are not
+     * periodic aggregators are ignored. Must be called after start()
+     * on all machines simultaneously.
+     */
+    void set_schedule(const std::vector<std::pair<std::string, float> >& remaining) {
+      float curtime = timer::approx_time_seconds() - start_time;
+      rmi.broadcast(curtime, rmi.procid() == 0);
+      schedule_lock.lock();
+      schedule.clear();
+      for (size_t i = 0; i < remaining.size(); ++i) {
+        if (aggregate_period.count(remaining[i].first) == 0) continue;
+        schedule.push(remaining[i].first, -(curtime + remaining[i].second));
+      }
+      schedule_lock.unlock();
+    }
+
     /**
      * Must be called on engine stop. Clears the internal scheduler
      * And resets all incomplete states.
@@ -0,0 +1,260 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#ifndef GRAPHLAB_SUPERSTEP_PROFILER_HPP
+#define GRAPHLAB_SUPERSTEP_PROFILER_HPP
+
+#include <ctime>
+#include <sys/time.h>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+#include <boost/function.hpp>
+
+#include <graphlab/logger/logger.hpp>
+#include <graphlab/serialization/serialization_includes.hpp>
+#include <graphlab/rpc/dc.hpp>
+#include <graphlab/rpc/dc_dist_object.hpp>
+#include <graphlab/parallel/cache_line_pad.hpp>
+
+#include <graphlab/macros_def.hpp>
+namespace graphlab {
+
+  /**
+   * \ingroup engines
+   *
+   * \brief Returns the callback invoked with the name and wall time
+   * (in seconds) of every superstep phase of every synchronous engine
+   * of this process. Empty by default; launch_metric_server() installs
+   * one which feeds the /metrics page. Must be set before any engine
+   * is started.
+   */
+  inline boost::function<void(const char*, double)>& superstep_phase_observer() {
+    static boost::function<void(const char*, double)> observer;
+    return observer;
+  }
+
+  /**
+   * \ingroup engines
+   *
+   * \brief Records the wall time, CPU time, thread barrier wait time
+   * and bytes sent of every phase of every superstep executed by the
+   * synchronous engine on every machine, together with the number of
+   * active vertices and messages per superstep.
+   *
+   * The profile of a run is collected on machine 0 and written as a
+   * Chrome trace (load it in chrome://tracing or any trace viewer
+   * understanding the JSON trace event format). Each machine is a
+   * process in the trace and each phase is a complete event, so
+   * stragglers and communication stalls show up as long bars on a
+   * single machine.
+   *
+   * Independently of the trace, the wall time of every phase is always
+   * passed to the superstep_phase_observer() if one is installed. All
+   * other recording is skipped while the profiler is disabled.
+   * begin_phase(), end_phase() and end_superstep() must be called by
+   * a single thread outside of the parallel phases; add_barrier_wait()
+   * may be called in parallel with distinct thread ids.
+   */
+  class superstep_profiler {
+  public:
+    /// The phases of a superstep
+    enum phase_enum {EXCHANGE = 0, RECEIVE, GATHER, APPLY, SCATTER,
+                     NUM_PHASES};
+
+    /// One phase executed on one machine
+    struct phase_record : public IS_POD_TYPE {
+      int iteration;
+      int phase;
+      /// seconds since the epoch
+      double begin;
+      double wall;
+      /// CPU time of the process (all threads)
+      double cpu;
+      /// Total and maximum (over threads) time waiting at thread barriers
+      double barrier_wait;
+      double max_barrier_wait;
+      size_t bytes_sent;
+    };
+
+    /// Counters of one superstep executed on one machine
+    struct superstep_record : public IS_POD_TYPE {
+      int iteration;
+      double end;
+      size_t active_vertices;
+      /// messages posted to vertices on this machine
+      size_t messages;
+    };
+
+  private:
+    dc_dist_object<superstep_profiler> rmi;
+    bool enabled;
+    phase_record current;
+    double cpu_begin;
+    size_t bytes_begin;
+    std::vector<cache_line_pad<double> > thread_barrier_wait;
+    std::vector<phase_record> phases;
+    std::vector<superstep_record> supersteps;
+
+    static double wall_now() {
+      struct timeval tv;
+      gettimeofday(&tv, NULL);
+      return double(tv.tv_sec) + double(tv.tv_usec) / 1e6;
+    }
+
+    static double cpu_now() {
+      struct timespec ts;
+      clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+      return double(ts.tv_sec) + double(ts.tv_nsec) / 1e9;
+    }
+
+    static const char* phase_name(int phase) {
+      static const char* names[NUM_PHASES] =
+        {"exchange", "receive", "gather", "apply", "scatter"};
+      return names[phase];
+    }
+
+  public:
+    superstep_profiler(distributed_control& dc, size_t ncpus) :
+      rmi(dc, this), enabled(false), thread_barrier_wait(ncpus) { }
+
+    /// Enable or disable recording
+    void enable(bool value = true) { enabled = value; }
+
+    /// Returns true if recording is enabled
+    inline bool is_enabled() const { return enabled; }
+
+    /// Forget all records
+    void clear() { phases.clear(); supersteps.clear(); }
+
+    void begin_phase(int iteration, phase_enum phase) {
+      current.iteration = iteration;
+      current.phase = phase;
+      current.begin = wall_now();
+      if (!enabled) return;
+      for (size_t i = 0; i < thread_barrier_wait.size(); ++i) {
+        thread_barrier_wait[i].value = 0;
+      }
+      cpu_begin = cpu_now();
+      bytes_begin = rmi.dc().network_bytes_sent();
+    }
+
+    void end_phase() {
+      current.wall = wall_now() - current.begin;
+      if (superstep_phase_observer()) {
+        superstep_phase_observer()(phase_name(current.phase), current.wall);
+      }
+      if (!enabled) return;
+      current.cpu = cpu_now() - cpu_begin;
+      current.bytes_sent = rmi.dc().network_bytes_sent() - bytes_begin;
+      current.barrier_wait = 0;
+      current.max_barrier_wait = 0;
+      for (size_t i = 0; i < thread_barrier_wait.size(); ++i) {
+        current.barrier_wait += thread_barrier_wait[i].value;
+        current.max_barrier_wait = std::max(current.max_barrier_wait,
+                                            thread_barrier_wait[i].value);
+      }
+      phases.push_back(current);
+    }
+
+    /// Accumulate the time thread_id spent waiting at a thread barrier
+    inline void add_barrier_wait(size_t thread_id, double seconds) {
+      thread_barrier_wait[thread_id].value += seconds;
+    }
+
+    void end_superstep(int iteration, size_t active_vertices,
+                       size_t messages) {
+      if (!enabled) return;
+      superstep_record rec;
+      rec.iteration = iteration;
+      rec.end = wall_now();
+      rec.active_vertices = active_vertices;
+      rec.messages = messages;
+      supersteps.push_back(rec);
+    }
+
+    /**
+     * \brief Collect the records of all machines on machine 0 and
+     * write them to fname as a Chrome trace. Must be called on all
+     * machines simultaneously.
+     */
+    void write_trace(const std::string& fname) {
+      if (!enabled) return;
+      std::vector<std::vector<phase_record> > all_phases(rmi.numprocs());
+      std::vector<std::vector<superstep_record> > all_supersteps(rmi.numprocs());
+      all_phases[rmi.procid()] = phases;
+      all_supersteps[rmi.procid()] = supersteps;
+      rmi.gather(all_phases, 0);
+      rmi.gather(all_supersteps, 0);
+      if (rmi.procid() != 0) return;
+
+      // timestamps are relative to the first recorded phase
+      double origin = -1;
+      for (size_t p = 0; p < all_phases.size(); ++p) {
+        foreach(const phase_record& rec, all_phases[p]) {
+          if (origin < 0 || rec.begin < origin) origin = rec.begin;
+        }
+      }
+      std::ofstream fout(fname.c_str());
+      if (!fout.good()) {
+        logstream(LOG_ERROR) << "Cannot write profile to " << fname << std::endl;
+        return;
+      }
+      fout << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+      bool first = true;
+      for (size_t p = 0; p < all_phases.size(); ++p) {
+        if (!first) fout << ",\n";
+        first = false;
+        fout << "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": " << p
+             << ", \"args\": {\"name\": \"rank " << p << "\"}}";
+        foreach(const phase_record& rec, all_phases[p]) {
+          fout << ",\n{\"name\": \"" << phase_name(rec.phase)
+               << "\", \"cat\": \"superstep\", \"ph\": \"X\", \"pid\": " << p
+               << ", \"tid\": 0, \"ts\": " << size_t((rec.begin - origin) * 1e6)
+               << ", \"dur\": " << size_t(rec.wall * 1e6)
+               << ", \"args\": {\"iteration\": " << rec.iteration
+               << ", \"cpu_ms\": " << rec.cpu * 1e3
+               << ", \"barrier_wait_ms\": " << rec.barrier_wait * 1e3
+               << ", \"max_thread_barrier_wait_ms\": "
+               << rec.max_barrier_wait * 1e3
+               << ", \"bytes_sent\": " << rec.bytes_sent << "}}";
+        }
+        foreach(const superstep_record& rec, all_supersteps[p]) {
+          fout << ",\n{\"name\": \"superstep\", \"ph\": \"C\", \"pid\": " << p
+               << ", \"ts\": " << size_t(std::max(0.0, rec.end - origin) * 1e6)
+               << ", \"args\": {\"active_vertices\": " << rec.active_vertices
+               << ", \"messages\": " << rec.messages << "}}";
+        }
+      }
+      fout << "\n]}\n";
+      fout.close();
+      logstream(LOG_EMPH) << "Superstep profile written to " << fname
+                          << std::endl;
+    }
+  }; // end of class superstep_profiler
+
+} // end of namespace graphlab
+#include <graphlab/macros_undef.hpp>
+
+#endif
@@ -26,7 +26,11 @@
 #define GRAPHLAB_SYNCHRONOUS_ENGINE_HPP
 
 #include <deque>
+#include <fstream>
 #include <boost/bind.hpp>
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
 
 #include <graphlab/engine/iengine.hpp>
 
@@ -35,6 +39,8 @@
 #include <graphlab/vertex_program/context.hpp>
 
 #include <graphlab/engine/execution_status.hpp>
+#include <graphlab/engine/superstep_profiler.hpp>
+#include <graphlab/graph/mirror_data.hpp>
 #include <graphlab/options/graphlab_options.hpp>
 
 
@@ -44,6 +50,7 @@
 #include <graphlab/parallel/fiber_barrier.hpp>
 #include <graphlab/util/tracepoint.hpp>
 #include <graphlab/util/memory_info.hpp>
+#include <graphlab/util/hdfs.hpp>
 
 #include <graphlab/rpc/dc_dist_object.hpp>
 #include <graphlab/rpc/distributed_event_log.hpp>
@@ -186,7 +193,16 @@ namespace graphlab {
    * vertices that already have a cached value.  To use caching the
    * vertex program must either clear (\ref icontext::clear_gather_cache)
    * or update (\ref icontext::post_delta) the cache values of
-   * neighboring vertices during the scatter phase.
+   * neighboring vertices during the scatter phase. Cached values are
+   * sent to the master without being copied and a delta is merged in
+   * place with operator+=, so sparse gather types (e.g. maps) only pay
+   * for the entries which changed.
+   *
+   * \li <b>enable_sync_vertex_data</b>: (default: true) Send the
+   * vertex data of a master to its mirrors after each apply. If only a
+   * small part of the vertex data is read on mirrors, have the vertex
+   * data inherit from \ref graphlab::HAS_MIRROR_DATA to send just that
+   * part instead of disabling the synchronization.
    *
    * \li \b snapshot_interval If set to a positive value, a snapshot
    * is taken every this number of iterations. If set to 0, a snapshot
@@ -199,6 +215,46 @@ namespace graphlab {
    * for the snapshot. The path including folder and file prefix in
    * which the snapshots should be saved.
    *
+   * \li \b checkpoint_interval If set to a positive value, an
+   * engine checkpoint is taken every this number of iterations.
+   * Unlike a snapshot, a checkpoint captures the complete superstep
+   * state: the vertex data of all masters, all pending messages
+   * together with the vertex programs which will receive them, the
+   * edge data and the schedule of the periodic aggregators, so that
+   * the computation can be resumed mid-run. Only the first checkpoint
+   * of a run holds all vertex data; the following ones only hold the
+   * vertex data changed since the previous checkpoint. Checkpoints
+   * are staged in memory by all engine threads at the end of a
+   * superstep and compressed and written in the background while the
+   * next superstep runs. Defaults to -1 (no checkpoints).
+   *
+   * \li \b checkpoint_path If checkpoint_interval is set, this option
+   * must be specified and should contain the target basename of the
+   * checkpoint files.
+   *
+   * \li \b checkpoint_edge_data (default: true) Store the edge data
+   * in every checkpoint. May be set to false if the vertex program
+   * never modifies edge data, in which case the edge data of the
+   * resumed run must be loaded exactly as in the checkpointed run.
+   *
+   * \li \b profile_path If set, the wall time, CPU time, thread
+   * barrier wait time and bytes sent of every phase of every
+   * superstep, and the number of active vertices and messages per
+   * superstep, are recorded on every machine and written to this
+   * file as a Chrome trace (JSON) when start() returns. See
+   * \ref graphlab::superstep_profiler.
+   *
+   * \li \b resume_from The checkpoint_path of a previous run. The
+   * next call to start() restores the vertex data, the pending
+   * messages and vertex programs, the edge data, the aggregator
+   * schedule and the iteration counter of the last checkpoint
+   * completed by all machines, and continues from there. The
+   * periodic aggregators are run once on the restored state before
+   * the first superstep. The graph must be loaded and partitioned
+   * exactly as in the checkpointed run and the same number of
+   * machines must be used. If gather caching is enabled the caches
+   * are rebuilt by the first gather.
+   *
    * \see graphlab::omni_engine
    * \see graphlab::async_consistent_engine
    * \see graphlab::semi_synchronous_engine
@@ -383,6 +439,54 @@ namespace graphlab {
     /// \brief The target base name the snapshot is saved in.
     std::string snapshot_path;
 
+    /**
+     * \brief The interval (in iterations) between engine checkpoints.
+     * A value <= 0 disables checkpointing.
+     */
+    int checkpoint_interval;
+
+    /// \brief The target base name the checkpoints are saved in.
+    std::string checkpoint_path;
+
+    /// \brief The base name of the checkpoints to resume from.
+    std::string resume_from;
+
+    /// \brief Whether checkpoints store the edge data
+    bool checkpoint_edge_data;
+
+    /// \brief The number of checkpoints in the current chain.
+    size_t num_checkpoints;
+
+    /**
+     * \brief The number of signals sent to other machines since the
+     * last checkpoint. A checkpoint only needs a full barrier to
+     * collect the pending messages if some machine sent one.
+     */
+    atomic<size_t> remote_signals;
+
+    /**
+     * \brief The per thread archives of the checkpoint being staged.
+     */
+    std::vector<std::pair<char*, size_t> > checkpoint_chunks;
+
+    /**
+     * \brief The aggregator schedule restored from a checkpoint which
+     * is installed once the aggregator is started.
+     */
+    std::vector<std::pair<std::string, float> > resumed_schedule;
+
+    /**
+     * \brief Bit indicating that the vertex data of a master vertex
+     * has changed since the last checkpoint was staged.
+     */
+    dense_bitset dirty_vdata;
+
+    /**
+     * \brief The background thread writing out the last staged
+     * checkpoint.
+     */
+    thread_group checkpoint_writer;
+
     /**
      * \brief A counter that tracks the current iteration number since
      * start was last invoked.
@@ -538,14 +642,16 @@ namespace graphlab {
     vprog_exchange_type vprog_exchange;
 
     /**
-     * \brief The pair type used to synchronize vertex across across machines.
+     * \brief The record used to synchronize vertex data across
+     * machines. Only the mirror part is sent if the vertex data
+     * inherits from \ref graphlab::HAS_MIRROR_DATA.
      */
-    typedef std::pair<vertex_id_type, vertex_data_type> vid_vdata_pair_type;
+    typedef mirror_data_record<vertex_data_type> vdata_record_type;
 
     /**
      * \brief The type of the exchange used to synchronize vertex data
      */
-    typedef fiber_buffered_exchange<vid_vdata_pair_type> vdata_exchange_type;
+    typedef fiber_buffered_exchange<vdata_record_type> vdata_exchange_type;
 
     /**
      * \brief The distributed exchange used to synchronize changes to
@@ -592,6 +698,21 @@ namespace graphlab {
      */
     aggregator_type aggregator;
 
+    /**
+     * \brief The per-superstep phase profiler. Only records if
+     * profile_path is set.
+     */
+    superstep_profiler profiler;
+
+    /// \brief The file the profile is written to.
+    std::string profile_path;
+
+    /**
+     * \brief The number of messages posted to local vertices since the
+     * end of the last superstep. Only counted while profiling.
+     */
+    atomic<size_t> num_messages;
+
     DECLARE_EVENT(EVENT_APPLIES);
     DECLARE_EVENT(EVENT_GATHERS);
     DECLARE_EVENT(EVENT_SCATTERS);
@@ -661,6 +782,37 @@ namespace graphlab {
                     const message_type& message = message_type(),
                     const std::string& order = "shuffle");
 
+    /**
+     * \brief Signals the vertices with the given global ids.
+     *
+     * Unlike signal_all() and signal_vset() this does not look at every
+     * local vertex, so starting a computation from a small set of
+     * sources costs time proportional to the number of sources rather
+     * than to the size of the graph. Vertices which are not signaled do
+     * not run in the first iteration.
+     *
+     * Must be called on all machines simultaneously. Each machine may
+     * pass a different (possibly empty) list, and the ids are routed to
+     * their masters. If every machine passes the same list (for
+     * instance read from the same file) set replicated to true: each
+     * machine then signals the listed vertices it masters without any
+     * communication. An id listed more than once is signaled more than
+     * once, combining the messages.
+     *
+     * \code
+     * std::vector<vertex_id_type> sources = ...;
+     * engine.signal_vids(sources);
+     * engine.start();
+     * \endcode
+     *
+     * @param [in] vids The global ids of the vertices to signal
+     * @param [in] message The message to send to each of the vertices
+     * @param [in] replicated True if all machines pass the same list
+     */
+    void signal_vids(const std::vector<vertex_id_type>& vids,
+                     const message_type& message = message_type(),
+                     bool replicated = false);
+
 
     // documentation inherited from iengine
     float elapsed_seconds() const;
@@ -821,6 +973,20 @@ namespace graphlab {
       }
     } // end of run_synchronous
 
+    /**
+     * \brief Wait at the thread barrier, accounting the time spent
+     * waiting to the profiler.
+     */
+    inline void wait_thread_barrier(size_t thread_id) {
+      if (profiler.is_enabled()) {
+        timer ti;
+        thread_barrier.wait();
+        profiler.add_barrier_wait(thread_id, ti.current_time());
+      } else {
+        thread_barrier.wait();
+      }
+    } // end of wait_thread_barrier
+
     // /**
     //  * \brief Initialize all vertex programs by invoking
     //  * \ref graphlab::ivertex_program::init on all vertices.
@@ -924,9 +1090,13 @@ namespace graphlab {
      * \brief Send the gather value for the vertex id to its master.
      *
      * @param [in] lvid the vertex to send the gather value to
-     * @param [in] accum the locally computed gather value.
+     * @param [in,out] accum the locally computed gather value.
+     * @param [in] consume if true accum is no longer needed by the
+     *             caller and may be swapped into the master's gather
+     *             accumulator instead of copied. It is left in an
+     *             unspecified state.
      */
-    void sync_gather(lvid_type lvid, const gather_type& accum,
+    void sync_gather(lvid_type lvid, gather_type& accum, bool consume,
                      size_t thread_id);
 
 
@@ -956,6 +1126,50 @@ namespace graphlab {
      */
     void recv_messages();
 
+    // Checkpointing ==========================================================
+    /**
+     * \brief Stage the current superstep state (changed vertex data,
+     * pending messages and vertex programs, edge data and aggregator
+     * schedule) in memory and launch a background write of the
+     * staged checkpoint.
+     */
+    void stage_checkpoint();
+
+    /**
+     * \brief Stage the share of the checkpoint of one engine thread
+     * into checkpoint_chunks[thread_id].
+     */
+    void stage_checkpoint_chunk(size_t thread_id);
+
+    /**
+     * \brief Write the staged checkpoint buffers to disk and update
+     * the checkpoint manifest. Runs in the checkpoint writer thread
+     * and releases the buffers.
+     */
+    void write_checkpoint(std::vector<std::pair<char*, size_t> > chunks,
+                          size_t seq);
+
+    /**
+     * \brief Restore the superstep state from the checkpoint chain
+     * with the given base name.
+     */
+    void load_checkpoints(const std::string& prefix);
+
+    /**
+     * \brief Push the restored vertex data (dirty_vdata bits) of the
+     * masters to all mirrors.
+     */
+    void sync_restored_vertex_data(size_t thread_id);
+
+    /// \brief The file holding the seq-th checkpoint of this machine.
+    std::string checkpoint_fname(const std::string& prefix, size_t seq) const {
+      return prefix + "." + tostr(rmi.procid()) + "." + tostr(seq) + ".ckpt";
+    }
+
+    /// \brief The file holding the number of completed checkpoints.
+    std::string checkpoint_manifest(const std::string& prefix) const {
+      return prefix + "." + tostr(rmi.procid()) + ".manifest";
+    }
 
   }; // end of class synchronous engine
 
@@ -1011,13 +1225,16 @@ namespace graphlab {
     ncpus(opts.get_ncpus()),
     threads(2*1024*1024 /* 2MB stack per fiber*/),
     thread_barrier(opts.get_ncpus()),
-    max_iterations(-1), snapshot_interval(-1), iteration_counter(0),
+    max_iterations(-1), snapshot_interval(-1), checkpoint_interval(-1),
+    checkpoint_edge_data(true), num_checkpoints(0), remote_signals(0),
+    iteration_counter(0),
     timeout(0), sched_allv(false), enable_sync_vertex_data(true),
     vprog_exchange(dc),
     vdata_exchange(dc),
     gather_exchange(dc),
     message_exchange(dc),
-    aggregator(dc, graph, new context_type(*this, graph)) {
+    aggregator(dc, graph, new context_type(*this, graph)),
+    profiler(dc, opts.get_ncpus()) {
     // Process any additional options
     std::vector<std::string> keys = opts.get_engine_args().get_option_keys();
     per_thread_compute_time.resize(opts.get_ncpus());
@@ -1048,6 +1265,34 @@ namespace graphlab {
         if (rmi.procid() == 0)
           logstream(LOG_EMPH) << "Engine Option: snapshot_path = "
             << snapshot_path << std::endl;
+      } else if (opt == "checkpoint_interval") {
+        opts.get_engine_args().get_option("checkpoint_interval",
+                checkpoint_interval);
+        if (rmi.procid() == 0)
+          logstream(LOG_EMPH) << "Engine Option: checkpoint_interval = "
+            << checkpoint_interval << std::endl;
+      } else if (opt == "checkpoint_path") {
+        opts.get_engine_args().get_option("checkpoint_path", checkpoint_path);
+        if (rmi.procid() == 0)
+          logstream(LOG_EMPH) << "Engine Option: checkpoint_path = "
+            << checkpoint_path << std::endl;
+      } else if (opt == "checkpoint_edge_data") {
+        opts.get_engine_args().get_option("checkpoint_edge_data",
+                checkpoint_edge_data);
+        if (rmi.procid() == 0)
+          logstream(LOG_EMPH) << "Engine Option: checkpoint_edge_data = "
+            << checkpoint_edge_data << std::endl;
+      } else if (opt == "resume_from") {
+        opts.get_engine_args().get_option("resume_from", resume_from);
+        if (rmi.procid() == 0)
+          logstream(LOG_EMPH) << "Engine Option: resume_from = "
+            << resume_from << std::endl;
+      } else if (opt == "profile_path") {
+        opts.get_engine_args().get_option("profile_path", profile_path);
+        profiler.enable(!profile_path.empty());
+        if (rmi.procid() == 0)
+          logstream(LOG_EMPH) << "Engine Option: profile_path = "
+            << profile_path << std::endl;
       } else if (opt == "sched_allv") {
         opts.get_engine_args().get_option("sched_allv", sched_allv);
         if (rmi.procid() == 0)
@@ -1068,6 +1313,10 @@ namespace graphlab {
       logstream(LOG_FATAL)
         << "Snapshot interval specified, but no snapshot path" << std::endl;
     }
+    if (checkpoint_interval > 0 && checkpoint_path.length() == 0) {
+      logstream(LOG_FATAL)
+        << "Checkpoint interval specified, but no checkpoint path" << std::endl;
+    }
     INITIALIZE_EVENT_LOG(dc);
     ADD_CUMULATIVE_EVENT(EVENT_APPLIES, "Applies", "Calls");
     ADD_CUMULATIVE_EVENT(EVENT_GATHERS , "Gathers", "Calls");
@@ -1116,6 +1365,10 @@ namespace graphlab {
     // Allocate bitset to track active vertices on each bitset.
     active_superstep.resize(graph.num_local_vertices());
     active_minorstep.resize(graph.num_local_vertices());
+    // Track changed vertex data if checkpoints are taken or restored
+    if (checkpoint_interval > 0 || !resume_from.empty()) {
+      dirty_vdata.resize(graph.num_local_vertices());
+    }
 
     // Print memory usage after initialization
     memory_info::log_usage("After Engine Initialization");
@@ -1171,21 +1424,80 @@ namespace graphlab {
   void synchronous_engine<VertexProgram>::
   signal_vset(const vertex_set& vset,
              const message_type& message, const std::string& order) {
+    if (vset.lazy) {
+      if (vset.is_complete_set) signal_all(message, order);
+      return;
+    }
     if (vlocks.size() != graph.num_local_vertices())
       resize();
-    for(lvid_type lvid = 0; lvid < graph.num_local_vertices(); ++lvid) {
-      if(graph.l_is_master(lvid) && vset.l_contains(lvid)) {
+    // only visit the members of the set
+    foreach(size_t lvid, vset.get_lvid_bitset(graph)) {
+      if(graph.l_is_master(lvid)) {
         internal_signal(vertex_type(graph.l_vertex(lvid)), message);
       }
     }
-  } // end of signal all
+  } // end of signal vset
 
 
+  template<typename VertexProgram>
+  void synchronous_engine<VertexProgram>::
+  signal_vids(const std::vector<vertex_id_type>& vids,
+              const message_type& message, bool replicated) {
+    if (vlocks.size() != graph.num_local_vertices())
+      resize();
+    if (replicated) {
+      foreach(vertex_id_type gvid, vids) {
+        if (graph.contains_vertex(gvid)) {
+          const lvid_type lvid = graph.local_vid(gvid);
+          if (graph.l_is_master(lvid)) {
+            internal_signal(vertex_type(graph.l_vertex(lvid)), message);
+          }
+        }
+      }
+      return;
+    }
+    // ids with a local replica are sent to the owner of the replica.
+    // The master of the other ids is not known here, so they are sent
+    // to every machine.
+    std::vector<std::vector<vertex_id_type> > routed(rmi.numprocs());
+    std::vector<std::vector<vertex_id_type> > unrouted(rmi.numprocs());
+    foreach(vertex_id_type gvid, vids) {
+      if (graph.contains_vertex(gvid)) {
+        const lvid_type lvid = graph.local_vid(gvid);
+        routed[graph.l_get_vertex_record(lvid).owner].push_back(gvid);
+      } else {
+        unrouted[rmi.procid()].push_back(gvid);
+      }
+    }
+    rmi.all_to_all(routed);
+    rmi.all_gather(unrouted);
+    for (size_t p = 0; p < routed.size(); ++p) {
+      foreach(vertex_id_type gvid, routed[p]) {
+        internal_signal(graph.vertex(gvid), message);
+      }
+    }
+    for (size_t p = 0; p < unrouted.size(); ++p) {
+      foreach(vertex_id_type gvid, unrouted[p]) {
+        if (graph.contains_vertex(gvid)) {
+          const lvid_type lvid = graph.local_vid(gvid);
+          if (graph.l_is_master(lvid)) {
+            internal_signal(vertex_type(graph.l_vertex(lvid)), message);
+          }
+        }
+      }
+    }
+  } // end of signal vids
+
+
+  DECLARE_SAMPLED_TRACER(sync_engine_signal, "Engine Signal")
+
   template<typename VertexProgram>
   void synchronous_engine<VertexProgram>::
   internal_signal(const vertex_type& vertex,
                   const message_type& message) {
+    BEGIN_SAMPLED_TRACEPOINT(sync_engine_signal);
     const lvid_type lvid = vertex.local_id();
+    if (profiler.is_enabled()) num_messages.inc();
     vlocks[lvid].lock();
     if( has_message.get(lvid) ) {
       messages[lvid] += message;
@@ -1194,6 +1506,7 @@ namespace graphlab {
       has_message.set_bit(lvid);
     }
     vlocks[lvid].unlock();
+    END_SAMPLED_TRACEPOINT(sync_engine_signal);
   } // end of internal_signal
 
 
@@ -1209,6 +1522,7 @@ namespace graphlab {
       internal_signal(graph.vertex(gvid), message);
     else {
       procid_t proc = graph.master(gvid);
+      if (checkpoint_interval > 0) remote_signals.inc();
       rmi.remote_call(proc, 
                       &synchronous_engine<VertexProgram>::internal_signal_rpc,
                       gvid, message);
@@ -1306,7 +1620,22 @@ namespace graphlab {
     //   // Initialize all vertex programs
     //   run_synchronous( &synchronous_engine::initialize_vertex_programs );
     // }
+    profiler.clear();
+    // The first checkpoint of a chain holds all vertex data
+    num_checkpoints = 0;
+    dirty_vdata.fill();
+    if (!resume_from.empty()) {
+      load_checkpoints(resume_from);
+    }
     aggregator.start();
+    if (!resume_from.empty()) {
+      // continue the periodic aggregators where the checkpoint left
+      // them, starting from values computed on the restored state
+      aggregator.aggregate_all_periodic();
+      aggregator.set_schedule(resumed_schedule);
+      resumed_schedule.clear();
+      resume_from.clear();
+    }
     rmi.barrier();
 
     if (snapshot_interval == 0) {
@@ -1345,7 +1674,9 @@ namespace graphlab {
       // Exchange Messages --------------------------------------------------
       // Exchange any messages in the local message vectors
       // if (rmi.procid() == 0) std::cout << "Exchange messages..." << std::endl;
+      profiler.begin_phase(iteration_counter, superstep_profiler::EXCHANGE);
       run_synchronous( &synchronous_engine::exchange_messages );
+      profiler.end_phase();
       /**
        * Post conditions:
        *   1) only master vertices have messages
@@ -1358,7 +1689,9 @@ namespace graphlab {
 
       // if (rmi.procid() == 0) std::cout << "Receive messages..." << std::endl;
       num_active_vertices = 0;
+      profiler.begin_phase(iteration_counter, superstep_profiler::RECEIVE);
       run_synchronous( &synchronous_engine::receive_messages );
+      profiler.end_phase();
       if (sched_allv) {
         active_minorstep.fill();
       }
@@ -1391,7 +1724,9 @@ namespace graphlab {
       // Execute the gather operation for all vertices that are active
       // in this minor-step (active-minorstep bit set).
       // if (rmi.procid() == 0) std::cout << "Gathering..." << std::endl;
+      profiler.begin_phase(iteration_counter, superstep_profiler::GATHER);
       run_synchronous( &synchronous_engine::execute_gathers );
+      profiler.end_phase();
       // Clear the minor step bit since only super-step vertices
       // (only master vertices are required to participate in the
       // apply step)
@@ -1407,7 +1742,9 @@ namespace graphlab {
       // Execute Apply Operations -------------------------------------------
       // Run the apply function on all active vertices
       // if (rmi.procid() == 0) std::cout << "Applying..." << std::endl;
+      profiler.begin_phase(iteration_counter, superstep_profiler::APPLY);
       run_synchronous( &synchronous_engine::execute_applys );
+      profiler.end_phase();
       /**
        * Post conditions:
        *   1) any changes to the vertex data have been synchronized
@@ -1422,11 +1759,16 @@ namespace graphlab {
 
       // Execute Scatter Operations -----------------------------------------
       // Execute each of the scatters on all minor-step active vertices.
+      profiler.begin_phase(iteration_counter, superstep_profiler::SCATTER);
       run_synchronous( &synchronous_engine::execute_scatters );
+      profiler.end_phase();
       /**
        * Post conditions:
        *   1) NONE
        */
+      profiler.end_superstep(iteration_counter, num_active_vertices,
+                             num_messages.value);
+      num_messages = 0;
       if(rmi.procid() == 0 && print_this_round)
         logstream(LOG_EMPH) << "\t Running Aggregators" << std::endl;
       // probe the aggregator
@@ -1437,7 +1779,14 @@ namespace graphlab {
       if (snapshot_interval > 0 && iteration_counter % snapshot_interval == 0) {
         graph.save_binary(snapshot_path);
       }
+
+      if (checkpoint_interval > 0 &&
+          iteration_counter % checkpoint_interval == 0) {
+        stage_checkpoint();
+      }
     }
+    // Wait for the last checkpoint to hit the disk
+    checkpoint_writer.join();
 
     if (rmi.procid() == 0) {
       logstream(LOG_EMPH) << iteration_counter
@@ -1464,6 +1813,7 @@ namespace graphlab {
       logstream(LOG_INFO) << std::endl;
     }
     rmi.full_barrier();
+    if (profiler.is_enabled()) profiler.write_trace(profile_path);
     // Stop the aggregator
     aggregator.stop();
     // return the final reason for termination
@@ -1479,14 +1829,11 @@ namespace graphlab {
     const size_t TRY_RECV_MOD = 100;
     size_t vcount = 0;
     fixed_dense_bitset<8 * sizeof(size_t)> local_bitset; // a word-size = 64 bit
-    while (1) {
-      // increment by a word at a time
-      lvid_type lvid_block_start =
-                  shared_lvid_counter.inc_ret_last(8 * sizeof(size_t));
-      if (lvid_block_start >= graph.num_local_vertices()) break;
-      // get the bit field from has_message
-      size_t lvid_bit_block = has_message.containing_word(lvid_block_start);
-      if (lvid_bit_block == 0) continue;
+    dense_bitset::word_scanner scanner(has_message, shared_lvid_counter);
+    size_t lvid_block_start = 0;
+    size_t lvid_bit_block = 0;
+    // grab a few words at a time and skip over the empty words
+    while (scanner.next_word(lvid_block_start, lvid_bit_block)) {
       // initialize a word sized bitfield
       local_bitset.clear();
       local_bitset.initialize_from_mem(&lvid_bit_block, sizeof(size_t));
@@ -1506,9 +1853,9 @@ namespace graphlab {
     } // end of loop over vertices to send messages
     message_exchange.partial_flush();
     // Finish sending and receiving all messages
-    thread_barrier.wait();
+    wait_thread_barrier(thread_id);
     if(thread_id == 0) message_exchange.flush();
-    thread_barrier.wait();
+    wait_thread_barrier(thread_id);
     recv_messages();
   } // end of exchange_messages
 
@@ -1523,14 +1870,11 @@ namespace graphlab {
     size_t nactive_inc = 0;
     fixed_dense_bitset<8 * sizeof(size_t)> local_bitset; // a word-size = 64 bit
 
-    while (1) {
-      // increment by a word at a time
-      lvid_type lvid_block_start =
-                  shared_lvid_counter.inc_ret_last(8 * sizeof(size_t));
-      if (lvid_block_start >= graph.num_local_vertices()) break;
-      // get the bit field from has_message
-      size_t lvid_bit_block = has_message.containing_word(lvid_block_start);
-      if (lvid_bit_block == 0) continue;
+    dense_bitset::word_scanner scanner(has_message, shared_lvid_counter);
+    size_t lvid_block_start = 0;
+    size_t lvid_bit_block = 0;
+    // grab a few words at a time and skip over the empty words
+    while (scanner.next_word(lvid_block_start, lvid_bit_block)) {
       // initialize a word sized bitfield
       local_bitset.clear();
       local_bitset.initialize_from_mem(&lvid_bit_block, sizeof(size_t));
@@ -1567,11 +1911,11 @@ namespace graphlab {
     vprog_exchange.partial_flush();
     // Flush the buffer and finish receiving any remaining vertex
     // programs.
-    thread_barrier.wait();
+    wait_thread_barrier(thread_id);
     if(thread_id == 0) {
       vprog_exchange.flush();
     }
-    thread_barrier.wait();
+    wait_thread_barrier(thread_id);
 
     recv_vertex_programs();
 
@@ -1589,14 +1933,11 @@ namespace graphlab {
 
     fixed_dense_bitset<8 * sizeof(size_t)> local_bitset; // a word-size = 64 bit
 
-    while (1) {
-      // increment by a word at a time
-      lvid_type lvid_block_start =
-                  shared_lvid_counter.inc_ret_last(8 * sizeof(size_t));
-      if (lvid_block_start >= graph.num_local_vertices()) break;
-      // get the bit field from has_message
-      size_t lvid_bit_block = active_minorstep.containing_word(lvid_block_start);
-      if (lvid_bit_block == 0) continue;
+    dense_bitset::word_scanner scanner(active_minorstep, shared_lvid_counter);
+    size_t lvid_block_start = 0;
+    size_t lvid_bit_block = 0;
+    // grab a few words at a time and skip over the empty words
+    while (scanner.next_word(lvid_block_start, lvid_bit_block)) {
       // initialize a word sized bitfield
       local_bitset.clear();
       local_bitset.initialize_from_mem(&lvid_bit_block, sizeof(size_t));
@@ -1607,11 +1948,12 @@ namespace graphlab {
 
         bool accum_is_set = false;
         gather_type accum = gather_type();
-        // if caching is enabled and we have a cache entry then use
-        // that as the accum
+        // if caching is enabled and we have a cache entry then send
+        // it in place. The cache is only modified by post_delta, which
+        // is not called during the gather, so there is no need to copy
+        // it (which matters for large gather types such as sparse maps).
         if( caching_enabled && has_cache.get(lvid) ) {
-          accum = gather_cache[lvid];
-          accum_is_set = true;
+          sync_gather(lvid, gather_cache[lvid], false, thread_id);
         } else {
           // recompute the local contribution to the gather
           const vertex_program_type& vprog = vertex_programs[lvid];
@@ -1652,17 +1994,20 @@ namespace graphlab {
             INCREMENT_EVENT(EVENT_GATHERS, edges_touched);
           } // end of if out_edges/all_edges
           vprog.post_local_gather(accum);
-          // If caching is enabled then save the accumulator to the
+          // If caching is enabled then move the accumulator to the
           // cache for future iterations.  Note that it is possible
           // that the accumulator was never set in which case we are
           // effectively "zeroing out" the cache.
           if(caching_enabled && accum_is_set) {
-            gather_cache[lvid] = accum; has_cache.set_bit(lvid);
-          } // end of if caching enabled
+            std::swap(gather_cache[lvid], accum); has_cache.set_bit(lvid);
+            sync_gather(lvid, gather_cache[lvid], false, thread_id);
+          } else if(accum_is_set) {
+            // If the accum contains a value for the local gather we put
+            // that estimate in the gather exchange. accum is not used
+            // again so a master may take it without copying.
+            sync_gather(lvid, accum, true, thread_id);
+          }
         }
-        // If the accum contains a value for the local gather we put
-        // that estimate in the gather exchange.
-        if(accum_is_set) sync_gather(lvid, accum, thread_id);
         if(!graph.l_is_master(lvid)) {
           // if this is not the master clear the vertex program
           vertex_programs[lvid] = vertex_program_type();
@@ -1675,9 +2020,9 @@ namespace graphlab {
     per_thread_compute_time[thread_id] += ti.current_time();
     gather_exchange.partial_flush();
       // Finish sending and receiving all gather operations
-    thread_barrier.wait();
+    wait_thread_barrier(thread_id);
     if(thread_id == 0) gather_exchange.flush();
-    thread_barrier.wait();
+    wait_thread_barrier(thread_id);
     recv_gathers();
   } // end of execute_gathers
 
@@ -1691,14 +2036,11 @@ namespace graphlab {
     timer ti;
 
     fixed_dense_bitset<8 * sizeof(size_t)> local_bitset;  // allocate a word size = 64bits
-    while (1) {
-      // increment by a word at a time
-      lvid_type lvid_block_start =
-                  shared_lvid_counter.inc_ret_last(8 * sizeof(size_t));
-      if (lvid_block_start >= graph.num_local_vertices()) break;
-      // get the bit field from has_message
-      size_t lvid_bit_block = active_superstep.containing_word(lvid_block_start);
-      if (lvid_bit_block == 0) continue;
+    dense_bitset::word_scanner scanner(active_superstep, shared_lvid_counter);
+    size_t lvid_block_start = 0;
+    size_t lvid_bit_block = 0;
+    // grab a few words at a time and skip over the empty words
+    while (scanner.next_word(lvid_block_start, lvid_bit_block)) {
       // initialize a word sized bitfield
       local_bitset.clear();
       local_bitset.initialize_from_mem(&lvid_bit_block, sizeof(size_t));
@@ -1716,6 +2058,7 @@ namespace graphlab {
         vertex_programs[lvid].apply(context, vertex, accum);
         // record an apply as a completed task
         ++completed_applys;
+        if (checkpoint_interval > 0) dirty_vdata.set_bit(lvid);
         // Clear the accumulator to save some memory
         gather_accum[lvid] = gather_type();
         // synchronize the changed vertex data with all mirrors
@@ -1743,11 +2086,11 @@ namespace graphlab {
     vprog_exchange.partial_flush();
     vdata_exchange.partial_flush();
       // Finish sending and receiving all changes due to apply operations
-    thread_barrier.wait();
+    wait_thread_barrier(thread_id);
     if(thread_id == 0) { 
       vprog_exchange.flush(); vdata_exchange.flush(); 
     }
-    thread_barrier.wait();
+    wait_thread_barrier(thread_id);
     recv_vertex_programs();
     recv_vertex_data();
   } // end of execute_applys
@@ -1761,14 +2104,11 @@ namespace graphlab {
     context_type context(*this, graph);
     timer ti;
     fixed_dense_bitset<8 * sizeof(size_t)> local_bitset; // allocate a word size = 64 bits
-    while (1) {
-      // increment by a word at a time
-      lvid_type lvid_block_start =
-                  shared_lvid_counter.inc_ret_last(8 * sizeof(size_t));
-      if (lvid_block_start >= graph.num_local_vertices()) break;
-      // get the bit field from has_message
-      size_t lvid_bit_block = active_minorstep.containing_word(lvid_block_start);
-      if (lvid_bit_block == 0) continue;
+    dense_bitset::word_scanner scanner(active_minorstep, shared_lvid_counter);
+    size_t lvid_block_start = 0;
+    size_t lvid_bit_block = 0;
+    // grab a few words at a time and skip over the empty words
+    while (scanner.next_word(lvid_block_start, lvid_bit_block)) {
       // initialize a word sized bitfield
       local_bitset.clear();
       local_bitset.initialize_from_mem(&lvid_bit_block, sizeof(size_t));
@@ -1851,8 +2191,10 @@ namespace graphlab {
     ASSERT_TRUE(graph.l_is_master(lvid));
     const vertex_id_type vid = graph.global_vid(lvid);
     local_vertex_type vertex = graph.l_vertex(lvid);
+    // serialized in place from the vertex data by send()
+    const vdata_record_type record(vid, vertex.data());
     foreach(const procid_t& mirror, vertex.mirrors()) {
-      vdata_exchange.send(mirror, std::make_pair(vid, vertex.data()));
+      vdata_exchange.send(mirror, record);
     }
   } // end of sync_vertex_data
 
@@ -1867,10 +2209,10 @@ namespace graphlab {
     while(vdata_exchange.recv(recv_buffer)) {
       for (size_t i = 0;i < recv_buffer.size(); ++i) {
         typename vdata_exchange_type::buffer_type& buffer = recv_buffer[i].buffer;
-        foreach(const vid_vdata_pair_type& pair, buffer) {
-          const lvid_type lvid = graph.local_vid(pair.first);
+        foreach(const vdata_record_type& record, buffer) {
+          const lvid_type lvid = graph.local_vid(record.vid);
           ASSERT_FALSE(graph.l_is_master(lvid));
-          graph.l_vertex(lvid).data() = pair.second;
+          record.apply(graph.l_vertex(lvid).data());
         }
       }
     }
@@ -1879,20 +2221,24 @@ namespace graphlab {
 
   template<typename VertexProgram>
   void synchronous_engine<VertexProgram>::
-  sync_gather(lvid_type lvid, const gather_type& accum, const size_t thread_id) {
+  sync_gather(lvid_type lvid, gather_type& accum, const bool consume,
+              const size_t thread_id) {
     if(graph.l_is_master(lvid)) {
       vlocks[lvid].lock();
       if(has_gather_accum.get(lvid)) {
         gather_accum[lvid] += accum;
       } else {
-        gather_accum[lvid] = accum;
+        if(consume) std::swap(gather_accum[lvid], accum);
+        else gather_accum[lvid] = accum;
         has_gather_accum.set_bit(lvid);
       }
       vlocks[lvid].unlock();
     } else {
+      // serialize the accumulator straight into the send buffer rather
+      // than copying it into a (vid, accum) pair first
       const procid_t master = graph.l_master(lvid);
       const vertex_id_type vid = graph.global_vid(lvid);
-      gather_exchange.send(master, std::make_pair(vid, accum));
+      gather_exchange.send(master, vid, accum);
     }
   } // end of sync_gather
 
@@ -1903,15 +2249,16 @@ namespace graphlab {
     while(gather_exchange.recv(recv_buffer)) {
       for (size_t i = 0;i < recv_buffer.size(); ++i) {
         typename gather_exchange_type::buffer_type& buffer = recv_buffer[i].buffer;
-        foreach(const vid_gather_pair_type& pair, buffer) {
+        foreach(vid_gather_pair_type& pair, buffer) {
           const lvid_type lvid = graph.local_vid(pair.first);
-          const gather_type& accum = pair.second;
+          gather_type& accum = pair.second;
           ASSERT_TRUE(graph.l_is_master(lvid));
           vlocks[lvid].lock();
           if( has_gather_accum.get(lvid) ) {
             gather_accum[lvid] += accum;
           } else {
-            gather_accum[lvid] = accum;
+            // the receive buffer is discarded, so take its value
+            std::swap(gather_accum[lvid], accum);
             has_gather_accum.set_bit(lvid);
           }
           vlocks[lvid].unlock();
@@ -1958,6 +2305,297 @@ namespace graphlab {
 
 
 
+  // Checkpointing ==========================================================
+  template<typename VertexProgram>
+  void synchronous_engine<VertexProgram>::stage_checkpoint() {
+    // Signals sent to other machines by the last superstep have to
+    // land before the messages are staged. This only costs a full
+    // barrier if some machine actually sent one.
+    size_t nremote = remote_signals.value;
+    remote_signals = 0;
+    rmi.all_reduce(nremote);
+    if (nremote > 0) rmi.full_barrier();
+    // the previous checkpoint has to be out of the way
+    checkpoint_writer.join();
+    timer ti;
+    // The header holds the aggregator schedule which is the same on
+    // all machines
+    std::vector<std::pair<std::string, float> > schedule =
+                                                aggregator.get_schedule();
+    // Each engine thread stages a part of the vertices and edges in
+    // its own archive. The next superstep may freely modify the
+    // graph and the messages once staging completes.
+    checkpoint_chunks.resize(ncpus);
+    run_synchronous( &synchronous_engine::stage_checkpoint_chunk );
+    dirty_vdata.clear();
+    oarchive oarc;
+    oarc << size_t(rmi.numprocs()) << size_t(rmi.procid())
+         << iteration_counter << schedule << checkpoint_edge_data
+         << checkpoint_chunks.size();
+    std::vector<std::pair<char*, size_t> > chunks;
+    chunks.push_back(std::make_pair(oarc.buf, oarc.off));
+    chunks.insert(chunks.end(), checkpoint_chunks.begin(),
+                  checkpoint_chunks.end());
+    checkpoint_chunks.clear();
+    if (rmi.procid() == 0) {
+      logstream(LOG_INFO) << "Checkpoint " << num_checkpoints
+                          << " at iteration " << iteration_counter
+                          << " staged in " << ti.current_time()
+                          << " seconds" << std::endl;
+    }
+    // The writer thread takes ownership of the buffers
+    checkpoint_writer.launch(
+        boost::bind(&synchronous_engine::write_checkpoint, this,
+                    chunks, num_checkpoints));
+    ++num_checkpoints;
+  } // end of stage_checkpoint
+
+
+  template<typename VertexProgram>
+  void synchronous_engine<VertexProgram>::
+  stage_checkpoint_chunk(const size_t thread_id) {
+    timer ti;
+    const size_t nverts = graph.num_local_vertices();
+    const lvid_type begin = nverts * thread_id / ncpus;
+    const lvid_type end = nverts * (thread_id + 1) / ncpus;
+    oarchive oarc;
+    // the changed master vertex data
+    std::vector<lvid_type> lvids;
+    for (size_t b = begin; b < end; ++b) {
+      if (dirty_vdata.get(b) && graph.l_is_master(b)) lvids.push_back(b);
+    }
+    oarc << lvids.size();
+    foreach(lvid_type lvid, lvids) {
+      oarc << graph.global_vid(lvid) << graph.l_vertex(lvid).data();
+    }
+    // the pending messages (including those held by mirrors) and the
+    // vertex programs which will receive them
+    lvids.clear();
+    for (size_t b = begin; b < end; ++b) {
+      if (has_message.get(b)) lvids.push_back(b);
+    }
+    oarc << lvids.size();
+    foreach(lvid_type lvid, lvids) {
+      oarc << graph.global_vid(lvid) << messages[lvid]
+           << vertex_programs[lvid];
+    }
+    // the edge data, by local edge id
+    if (checkpoint_edge_data) {
+      const size_t nedges = graph.num_local_edges();
+      const size_t ebegin = nedges * thread_id / ncpus;
+      const size_t eend = nedges * (thread_id + 1) / ncpus;
+      oarc << ebegin << eend;
+      for (size_t eid = ebegin; eid < eend; ++eid) {
+        oarc << graph.get_local_graph().edge_data(eid);
+      }
+    }
+    checkpoint_chunks[thread_id] = std::make_pair(oarc.buf, oarc.off);
+    per_thread_compute_time[thread_id] += ti.current_time();
+  } // end of stage_checkpoint_chunk
+
+
+  template<typename VertexProgram>
+  void synchronous_engine<VertexProgram>::
+  write_checkpoint(std::vector<std::pair<char*, size_t> > chunks,
+                   size_t seq) {
+    const std::string fname = checkpoint_fname(checkpoint_path, seq);
+    const std::string manifest = checkpoint_manifest(checkpoint_path);
+    if(boost::starts_with(fname, "hdfs://")) {
+      graphlab::hdfs hdfs;
+      {
+        graphlab::hdfs::fstream out_file(hdfs, fname, true);
+        boost::iostreams::filtering_stream<boost::iostreams::output> fout;
+        fout.push(boost::iostreams::gzip_compressor());
+        fout.push(out_file);
+        for (size_t i = 0; i < chunks.size(); ++i) {
+          fout.write(chunks[i].first, chunks[i].second);
+        }
+        fout.pop();
+        fout.pop();
+        out_file.close();
+      }
+      graphlab::hdfs::fstream manifest_file(hdfs, manifest, true);
+      std::string nchkpts = tostr(seq + 1);
+      manifest_file.write(nchkpts.c_str(), nchkpts.length());
+      manifest_file.close();
+    } else {
+      std::ofstream out_file(fname.c_str(),
+                             std::ios_base::out | std::ios_base::binary);
+      if (!out_file.good()) {
+        logstream(LOG_ERROR) << "\n\tError opening file: " << fname
+                             << std::endl;
+      } else {
+        {
+          boost::iostreams::filtering_stream<boost::iostreams::output> fout;
+          fout.push(boost::iostreams::gzip_compressor());
+          fout.push(out_file);
+          for (size_t i = 0; i < chunks.size(); ++i) {
+            fout.write(chunks[i].first, chunks[i].second);
+          }
+          fout.pop();
+          fout.pop();
+          out_file.close();
+        }
+        // The manifest is only updated once the checkpoint is complete
+        std::ofstream manifest_file(manifest.c_str());
+        manifest_file << seq + 1 << std::endl;
+        manifest_file.close();
+      }
+    }
+    for (size_t i = 0; i < chunks.size(); ++i) free(chunks[i].first);
+  } // end of write_checkpoint
+
+
+  template<typename VertexProgram>
+  void synchronous_engine<VertexProgram>::
+  load_checkpoints(const std::string& prefix) {
+    rmi.full_barrier();
+    timer ti;
+    // Find the last checkpoint which was completed by all machines
+    size_t nchkpts = 0;
+    const std::string manifest = checkpoint_manifest(prefix);
+    if(boost::starts_with(manifest, "hdfs://")) {
+      graphlab::hdfs hdfs;
+      graphlab::hdfs::fstream manifest_file(hdfs, manifest, false);
+      manifest_file >> nchkpts;
+      manifest_file.close();
+    } else {
+      std::ifstream fin(manifest.c_str());
+      fin >> nchkpts;
+    }
+    std::vector<size_t> all_nchkpts(rmi.numprocs());
+    all_nchkpts[rmi.procid()] = nchkpts;
+    rmi.all_gather(all_nchkpts);
+    nchkpts = *std::min_element(all_nchkpts.begin(), all_nchkpts.end());
+    if (nchkpts == 0) {
+      logstream(LOG_FATAL) << "No complete checkpoint found in " << prefix
+                           << std::endl;
+    }
+
+    // Replay the chain: vertex data accumulates over all checkpoints
+    // while the rest of the state is that of the last one.
+    has_message.clear();
+    dirty_vdata.clear();
+    for (size_t seq = 0; seq < nchkpts; ++seq) {
+      const std::string fname = checkpoint_fname(prefix, seq);
+      logstream(LOG_INFO) << "Load checkpoint from " << fname << std::endl;
+      boost::iostreams::filtering_stream<boost::iostreams::input> fin;
+      fin.push(boost::iostreams::gzip_decompressor());
+      graphlab::hdfs hdfs;
+      boost::shared_ptr<graphlab::hdfs::fstream> hdfs_file;
+      std::ifstream in_file;
+      if(boost::starts_with(fname, "hdfs://")) {
+        hdfs_file.reset(new graphlab::hdfs::fstream(hdfs, fname, false));
+        fin.push(*hdfs_file);
+      } else {
+        in_file.open(fname.c_str(), std::ios_base::in | std::ios_base::binary);
+        if (!in_file.good()) {
+          logstream(LOG_FATAL) << "\n\tError opening file: " << fname
+                               << std::endl;
+        }
+        fin.push(in_file);
+      }
+      iarchive iarc(fin);
+      // Only the messages, vertex programs, edge data and schedule of
+      // the last checkpoint are restored
+      const bool last = (seq + 1 == nchkpts);
+      size_t numprocs, procid, nchunks;
+      bool has_edge_data;
+      std::vector<std::pair<std::string, float> > schedule;
+      iarc >> numprocs >> procid >> iteration_counter >> schedule
+           >> has_edge_data >> nchunks;
+      ASSERT_EQ(numprocs, rmi.numprocs());
+      ASSERT_EQ(procid, rmi.procid());
+      if (last) resumed_schedule = schedule;
+      for (size_t chunk = 0; chunk < nchunks; ++chunk) {
+        size_t nvdata, nmessages;
+        iarc >> nvdata;
+        for (size_t i = 0; i < nvdata; ++i) {
+          vertex_id_type vid;
+          iarc >> vid;
+          const lvid_type lvid = graph.local_vid(vid);
+          ASSERT_TRUE(graph.l_is_master(lvid));
+          iarc >> graph.l_vertex(lvid).data();
+          dirty_vdata.set_bit(lvid);
+        }
+        iarc >> nmessages;
+        for (size_t i = 0; i < nmessages; ++i) {
+          vertex_id_type vid;
+          message_type message;
+          vertex_program_type vprog;
+          iarc >> vid >> message >> vprog;
+          if (!last) continue;
+          const lvid_type lvid = graph.local_vid(vid);
+          messages[lvid] = message;
+          vertex_programs[lvid] = vprog;
+          has_message.set_bit(lvid);
+        }
+        if (has_edge_data) {
+          size_t ebegin, eend;
+          iarc >> ebegin >> eend;
+          ASSERT_LE(eend, graph.num_local_edges());
+          for (size_t eid = ebegin; eid < eend; ++eid) {
+            if (last) {
+              iarc >> graph.get_local_graph().edge_data(eid);
+            } else {
+              edge_data_type edata;
+              iarc >> edata;
+            }
+          }
+        }
+      }
+      fin.pop();
+      fin.pop();
+      if (hdfs_file) hdfs_file->close();
+    }
+    // Bring the mirrors up to date
+    run_synchronous( &synchronous_engine::sync_restored_vertex_data );
+    if (prefix == checkpoint_path) {
+      // Continue the chain we resumed from
+      num_checkpoints = nchkpts;
+      dirty_vdata.clear();
+    } else {
+      dirty_vdata.fill();
+    }
+    if (rmi.procid() == 0) {
+      logstream(LOG_EMPH) << "Resumed from checkpoint " << nchkpts - 1
+                          << " at iteration " << iteration_counter
+                          << " in " << ti.current_time() << " seconds"
+                          << std::endl;
+    }
+  } // end of load_checkpoints
+
+
+  template<typename VertexProgram>
+  void synchronous_engine<VertexProgram>::
+  sync_restored_vertex_data(const size_t thread_id) {
+    const size_t TRY_RECV_MOD = 1000;
+    size_t vcount = 0;
+    fixed_dense_bitset<8 * sizeof(size_t)> local_bitset; // a word-size = 64 bit
+    dense_bitset::word_scanner scanner(dirty_vdata, shared_lvid_counter);
+    size_t lvid_block_start = 0;
+    size_t lvid_bit_block = 0;
+    // grab a few words at a time and skip over the empty words
+    while (scanner.next_word(lvid_block_start, lvid_bit_block)) {
+      // initialize a word sized bitfield
+      local_bitset.clear();
+      local_bitset.initialize_from_mem(&lvid_bit_block, sizeof(size_t));
+      foreach(size_t lvid_block_offset, local_bitset) {
+        lvid_type lvid = lvid_block_start + lvid_block_offset;
+        if (lvid >= graph.num_local_vertices()) break;
+        sync_vertex_data(lvid, thread_id);
+        if(++vcount % TRY_RECV_MOD == 0) recv_vertex_data();
+      }
+    }
+    vdata_exchange.partial_flush();
+    wait_thread_barrier(thread_id);
+    if(thread_id == 0) vdata_exchange.flush();
+    wait_thread_barrier(thread_id);
+    recv_vertex_data();
+  } // end of sync_restored_vertex_data
+
+
+
 
 
 
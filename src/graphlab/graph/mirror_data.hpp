@@ -0,0 +1,139 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#ifndef GRAPHLAB_MIRROR_DATA_HPP
+#define GRAPHLAB_MIRROR_DATA_HPP
+
+#include <cstdlib>
+#include <string>
+#include <boost/type_traits.hpp>
+#include <graphlab/graph/graph_basic_types.hpp>
+#include <graphlab/serialization/serialization_includes.hpp>
+
+namespace graphlab {
+
+  /**
+   * \ingroup group_graph
+   * \brief Inheriting from this type declares that the mirrors of a
+   * vertex only need part of its vertex data.
+   *
+   * When the engine synchronizes the vertex data of a master with its
+   * mirrors it normally sends the whole vertex data. A vertex data type
+   * deriving from HAS_MIRROR_DATA instead provides
+   *
+   * \code
+   * // write the fields the mirrors need
+   * void save_mirror(graphlab::oarchive& oarc) const;
+   * // read them into the mirror, leaving the other fields untouched
+   * void load_mirror(graphlab::iarchive& iarc);
+   * \endcode
+   *
+   * and only those fields are sent. This is useful when the vertex data
+   * holds large state used only by the apply function (which runs on
+   * the master) next to a small part read by gathers and scatters. The
+   * fields written may change from call to call (e.g. only those
+   * changed since the last save, using a dirty mask) as long as
+   * load_mirror() reads what the matching save_mirror() wrote.
+   */
+  struct HAS_MIRROR_DATA { };
+
+  /**
+   * \ingroup group_graph
+   * \brief has_mirror_data<T>::value is true if T inherits from
+   * HAS_MIRROR_DATA.
+   */
+  template <typename T>
+  struct has_mirror_data {
+    BOOST_STATIC_CONSTANT(bool, value =
+                          (boost::is_base_of<HAS_MIRROR_DATA, T>::value));
+  };
+
+
+  /**
+   * \internal
+   * The record used by the engines to synchronize the vertex data of a
+   * master with its mirrors. The sender serializes the vertex data in
+   * place from a pointer; the receiver applies it to the mirror with
+   * apply(). The generic version sends the whole vertex data.
+   */
+  template <typename VertexData,
+            bool Partial = has_mirror_data<VertexData>::value>
+  struct mirror_data_record {
+    vertex_id_type vid;
+    const VertexData* source;
+    VertexData data;
+
+    mirror_data_record() : vid(0), source(NULL) { }
+    mirror_data_record(vertex_id_type vid, const VertexData& source)
+      : vid(vid), source(&source) { }
+
+    void save(oarchive& oarc) const {
+      oarc << vid << *source;
+    }
+    void load(iarchive& iarc) {
+      iarc >> vid >> data;
+    }
+    void apply(VertexData& mirror) const {
+      mirror = data;
+    }
+  }; // end of mirror_data_record
+
+
+  /**
+   * \internal
+   * Only sends what VertexData::save_mirror() writes. Since the receiver
+   * cannot deserialize it without the mirror, the bytes are length
+   * prefixed and kept until apply().
+   */
+  template <typename VertexData>
+  struct mirror_data_record<VertexData, true> {
+    vertex_id_type vid;
+    const VertexData* source;
+    std::string bytes;
+
+    mirror_data_record() : vid(0), source(NULL) { }
+    mirror_data_record(vertex_id_type vid, const VertexData& source)
+      : vid(vid), source(&source) { }
+
+    void save(oarchive& oarc) const {
+      oarchive part;
+      source->save_mirror(part);
+      oarc << vid << part.off;
+      oarc.write(part.buf, part.off);
+      free(part.buf);
+    }
+    void load(iarchive& iarc) {
+      size_t len = 0;
+      iarc >> vid >> len;
+      bytes.resize(len);
+      if (len > 0) iarc.read(&bytes[0], len);
+    }
+    void apply(VertexData& mirror) const {
+      iarchive iarc(bytes.data(), bytes.size());
+      mirror.load_mirror(iarc);
+    }
+  }; // end of mirror_data_record
+
+} // namespace graphlab
+
+#endif
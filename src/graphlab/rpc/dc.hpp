@@ -942,6 +942,23 @@ class distributed_control{
     return ret;
   }
 
+  /** \brief Returns the number of bytes sent to machine target excluding
+   *  headers and other control overhead.
+   */
+  inline size_t bytes_sent_to(procid_t target) const {
+    return senders[target]->bytes_sent();
+  }
+
+  /// \brief Returns the number of bytes received from machine source
+  inline size_t bytes_received_from(procid_t source) const {
+    return global_bytes_received[source].value;
+  }
+
+  /// \brief Returns the number of RPC calls made to machine target
+  inline size_t calls_sent_to(procid_t target) const {
+    return global_calls_sent[target].value;
+  }
+
   /// \cond GRAPHLAB_INTERNAL
 
   /// \internal
@@ -462,6 +462,27 @@ void distributed_event_logger::free_callback_entry(size_t entry) {
   logs[entry]->lock.unlock();
 }
 
+double distributed_event_logger::get_local_value(size_t entry) {
+  ASSERT_LT(entry, MAX_LOG_SIZE);
+  double value = 0;
+  logs[entry]->lock.lock();
+  if (logs[entry]->is_callback_entry) {
+    if (logs[entry]->callback != NULL) value = logs[entry]->callback();
+  } else {
+    // instantaneous counters may be decremented on another thread,
+    // so sum with wrap around before converting
+    size_t total = 0;
+    thread_local_count_lock.lock();
+    foreach(size_t thr, thread_local_count_slots) {
+      total += thread_local_count[thr]->values[entry];
+    }
+    thread_local_count_lock.unlock();
+    value = (double)(int64_t)total;
+  }
+  logs[entry]->lock.unlock();
+  return value;
+}
+
 distributed_event_logger& get_event_log() {
   static distributed_event_logger dist_event_log;
   return dist_event_log;
@@ -224,6 +224,13 @@ class distributed_event_logger {
     void thr_dec_log_entry(size_t entry, size_t value);
 
 
+    /**
+     * Returns the current value of a log entry on this machine: the
+     * total over all threads of a counter entry, or the value of the
+     * callback of a callback entry.
+     */
+    double get_local_value(size_t entry);
+
     /// \cond GRAPHLAB_INTERNAL
     inline double get_current_time() const {
       return ti.current_time();
@@ -191,6 +191,30 @@ namespace graphlab {
       }
     } // end of send
 
+    /**
+     * Sends a std::pair to a target machine without constructing it.
+     * The two halves are serialized back to back, which is exactly the
+     * wire format of std::pair, so this is only valid when T is
+     * std::pair<First, Second>. Must be called from within a fiber.
+     */
+    template <typename First, typename Second>
+    void send(const procid_t proc, const First& first, const Second& second) {
+      size_t wid = fiber_control::get_worker_id();
+      if (send_buffers[wid][proc].oarc == NULL) {
+        send_buffers[wid][proc].oarc = rpc.split_call_begin(&fiber_buffered_exchange::rpc_recv);
+        // write a header
+        (*send_buffers[wid][proc].oarc) << rpc.procid();
+        send_buffers[wid][proc].numinserts = 0;
+      }
+
+      (*(send_buffers[wid][proc].oarc)) << first << second;
+      ++send_buffers[wid][proc].numinserts;
+
+      if(send_buffers[wid][proc].oarc->off >= max_buffer_size) {
+        flush_buffer(wid, proc);
+      }
+    } // end of send
+
     /**
      * Flushes the send buffers owned by the worker currently running the 
      * current fiber.
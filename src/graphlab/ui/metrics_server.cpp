@@ -34,6 +34,7 @@
 
 #include <graphlab/ui/mongoose/mongoose.h>
 #include <graphlab/ui/metrics_server.hpp>
+#include <graphlab/ui/prometheus_metrics.hpp>
 
 #include <graphlab/macros_def.hpp>
 
@@ -192,6 +193,7 @@ static void fill_builtin_callbacks() {
   callbacks()["echo"] = echo;
   callbacks()[""] = index_page;
   callbacks()["index.html"] = index_page;
+  callbacks()["metrics"] = prometheus_metrics_page;
 }
 
 
@@ -203,6 +205,9 @@ void add_metric_server_callback(std::string page,
 }
 
 void launch_metric_server() {
+  // every machine records its engine phase times, machine 0 collects
+  // them when serving /metrics
+  install_engine_phase_metrics();
   if (distributed_control::get_instance_procid() == 0) {
     const char *options[] = {"listening_ports", "8090", NULL};
     metric_context = mg_start(process_request, (void*)(&(callbacks())), options);
@@ -86,8 +86,9 @@ void add_metric_server_callback(std::string page,
   \ingroup httpserver
   \brief Starts the metrics reporting server.
 
-  The function may be called by all machines simultaneously since it only
-  does useful work on machine 0. Only machine 0 will launch the web server.
+  The function should be called by all machines simultaneously. Only
+  machine 0 will launch the web server; every machine starts recording
+  the engine metrics which machine 0 collects for the /metrics page.
  */
 void launch_metric_server();
 
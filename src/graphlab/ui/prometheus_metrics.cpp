@@ -0,0 +1,347 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+#include <cmath>
+#include <string>
+#include <map>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/rpc/dc.hpp>
+#include <graphlab/rpc/distributed_event_log.hpp>
+#include <graphlab/util/memory_info.hpp>
+#include <graphlab/engine/superstep_profiler.hpp>
+#include <graphlab/ui/prometheus_metrics.hpp>
+
+#include <graphlab/macros_def.hpp>
+
+namespace graphlab {
+
+void latency_histogram::observe(double seconds) {
+  if (seconds < 0) seconds = 0;
+  // bucket i holds (2^(i-1), 2^i] microseconds
+  double us = seconds * 1e6;
+  size_t b = 0;
+  while (b < NUM_BUCKETS && us > bucket_upper_bound(b) * 1e6) ++b;
+  counts[b].inc();
+  sum_ns.inc(size_t(seconds * 1e9));
+}
+
+double latency_histogram::bucket_upper_bound(size_t i) {
+  return std::ldexp(1e-6, int(i));
+}
+
+size_t latency_histogram::count() const {
+  size_t total = 0;
+  for (size_t i = 0; i <= NUM_BUCKETS; ++i) total += counts[i].value;
+  return total;
+}
+
+double latency_histogram::quantile(double q) const {
+  size_t total = count();
+  if (total == 0) return 0;
+  double rank = q * total;
+  size_t cumulative = 0;
+  for (size_t i = 0; i < NUM_BUCKETS; ++i) {
+    size_t c = counts[i].value;
+    if (c > 0 && cumulative + c >= rank) {
+      double lower = i == 0 ? 0 : bucket_upper_bound(i - 1);
+      double upper = bucket_upper_bound(i);
+      return lower + (upper - lower) * (rank - cumulative) / c;
+    }
+    cumulative += c;
+  }
+  // falls in the +Inf bucket
+  return bucket_upper_bound(NUM_BUCKETS - 1);
+}
+
+
+namespace {
+
+struct histogram_entry {
+  std::string help;
+  // label set -> histogram. Histograms are never freed.
+  std::map<std::string, latency_histogram*> series;
+};
+
+struct gauge_entry {
+  std::string help;
+  std::map<std::string, boost::function<double(void)> > series;
+};
+
+mutex& registry_lock() {
+  static mutex lock;
+  return lock;
+}
+
+std::map<std::string, histogram_entry>& histograms() {
+  static std::map<std::string, histogram_entry> h;
+  return h;
+}
+
+std::map<std::string, gauge_entry>& gauges() {
+  static std::map<std::string, gauge_entry> g;
+  return g;
+}
+
+/// Turns an event log name like "Active Threads" into a metric name
+std::string sanitize_name(const std::string& name) {
+  std::string ret;
+  for (size_t i = 0; i < name.length(); ++i) {
+    char c = name[i];
+    if (isalnum(c)) ret += tolower(c);
+    else if (ret.length() > 0 && ret[ret.length() - 1] != '_') ret += '_';
+  }
+  while (ret.length() > 0 && ret[ret.length() - 1] == '_') {
+    ret.erase(ret.length() - 1);
+  }
+  return ret;
+}
+
+/// Joins two label sets
+std::string join_labels(const std::string& a, const std::string& b) {
+  if (a.empty()) return b;
+  if (b.empty()) return a;
+  return a + "," + b;
+}
+
+std::string braces(const std::string& labels) {
+  return labels.empty() ? std::string() : "{" + labels + "}";
+}
+
+} // anonymous namespace
+
+
+latency_histogram& get_latency_histogram(const std::string& name,
+                                         const std::string& help,
+                                         const std::string& labels) {
+  registry_lock().lock();
+  histogram_entry& entry = histograms()[name];
+  entry.help = help;
+  latency_histogram*& hist = entry.series[labels];
+  if (hist == NULL) hist = new latency_histogram;
+  latency_histogram& ret = *hist;
+  registry_lock().unlock();
+  return ret;
+}
+
+
+void add_prometheus_gauge(const std::string& name,
+                          const std::string& help,
+                          boost::function<double(void)> callback,
+                          const std::string& labels) {
+  registry_lock().lock();
+  gauge_entry& entry = gauges()[name];
+  entry.help = help;
+  entry.series[labels] = callback;
+  registry_lock().unlock();
+}
+
+
+namespace {
+
+/// The HELP and TYPE lines of a metric and its samples on all machines
+struct metric_family {
+  std::string help;
+  std::string type;
+  std::vector<std::string> samples;
+  void save(oarchive& oarc) const { oarc << help << type << samples; }
+  void load(iarchive& iarc) { iarc >> help >> type >> samples; }
+};
+
+typedef std::map<std::string, metric_family> family_map;
+
+metric_family& family(family_map& families, const std::string& name,
+                      const std::string& help, const std::string& type) {
+  metric_family& ret = families[name];
+  ret.help = help;
+  ret.type = type;
+  return ret;
+}
+
+template <typename T>
+std::string sample(const std::string& name, const std::string& labels,
+                   const T& value) {
+  std::stringstream strm;
+  strm << name << braces(labels) << " " << value << "\n";
+  return strm.str();
+}
+
+/// Collects the metrics of this machine, labeled with its machine id
+family_map local_metric_families() {
+  family_map families;
+  distributed_control* dc = distributed_control::get_instance();
+  std::string machine;
+  if (dc != NULL) machine = "machine=\"" + tostr(dc->procid()) + "\"";
+
+  // Event log counters of this machine
+  distributed_event_logger& evlog = get_event_log();
+  log_group** logs = evlog.get_logs_ptr();
+  fixed_dense_bitset<MAX_LOG_SIZE>& has_log_entry = evlog.get_logs_bitset();
+  foreach(size_t log, has_log_entry) {
+    bool cumulative = logs[log]->logtype == log_type::CUMULATIVE;
+    std::string name = "graphlab_" + sanitize_name(logs[log]->name);
+    if (cumulative) name += "_total";
+    family(families, name, logs[log]->name + " (" + logs[log]->units + ")",
+           cumulative ? "counter" : "gauge").samples.push_back(
+        sample(name, machine, evlog.get_local_value(log)));
+  }
+
+  // RPC traffic per peer machine
+  if (dc != NULL) {
+    metric_family& sent = family(families, "graphlab_rpc_sent_bytes_total",
+        "Bytes sent to each peer excluding headers", "counter");
+    metric_family& received = family(families,
+        "graphlab_rpc_received_bytes_total",
+        "Bytes received from each peer excluding headers", "counter");
+    metric_family& calls = family(families, "graphlab_rpc_calls_sent_total",
+        "RPC calls made to each peer", "counter");
+    for (procid_t p = 0; p < dc->numprocs(); ++p) {
+      std::string labels = join_labels(machine, "peer=\"" + tostr(p) + "\"");
+      sent.samples.push_back(sample("graphlab_rpc_sent_bytes_total", labels,
+                                    dc->bytes_sent_to(p)));
+      received.samples.push_back(sample("graphlab_rpc_received_bytes_total",
+                                        labels, dc->bytes_received_from(p)));
+      calls.samples.push_back(sample("graphlab_rpc_calls_sent_total", labels,
+                                     dc->calls_sent_to(p)));
+    }
+    family(families, "graphlab_network_sent_bytes_total",
+           "Bytes sent including headers and control overhead",
+           "counter").samples.push_back(
+        sample("graphlab_network_sent_bytes_total", machine,
+               dc->network_bytes_sent()));
+  }
+
+  // Memory usage
+  if (memory_info::available()) {
+    family(families, "graphlab_heap_bytes", "Size of the heap",
+           "gauge").samples.push_back(
+        sample("graphlab_heap_bytes", machine, memory_info::heap_bytes()));
+    family(families, "graphlab_allocated_bytes", "Bytes allocated on the heap",
+           "gauge").samples.push_back(
+        sample("graphlab_allocated_bytes", machine,
+               memory_info::allocated_bytes()));
+  }
+
+  registry_lock().lock();
+  // Registered gauges
+  typedef std::map<std::string, gauge_entry>::value_type gauge_pair;
+  foreach(gauge_pair& g, gauges()) {
+    metric_family& f = family(families, g.first, g.second.help, "gauge");
+    typedef std::map<std::string, boost::function<double(void)> >::value_type
+        series_pair;
+    foreach(series_pair& s, g.second.series) {
+      f.samples.push_back(sample(g.first, join_labels(machine, s.first),
+                                 s.second()));
+    }
+  }
+
+  // Registered histograms, followed by the p50/p99/p999 estimates
+  typedef std::map<std::string, histogram_entry>::value_type hist_pair;
+  foreach(hist_pair& h, histograms()) {
+    typedef std::map<std::string, latency_histogram*>::value_type series_pair;
+    metric_family& f = family(families, h.first, h.second.help, "histogram");
+    std::string qname = h.first + "_quantile";
+    metric_family& qf = family(families, qname,
+                               "Quantile estimates of " + h.first, "gauge");
+    foreach(series_pair& s, h.second.series) {
+      const latency_histogram& hist = *s.second;
+      std::string labels = join_labels(machine, s.first);
+      size_t cumulative = 0;
+      for (size_t i = 0; i < latency_histogram::NUM_BUCKETS; ++i) {
+        cumulative += hist.bucket_count(i);
+        std::stringstream le;
+        le << "le=\"" << latency_histogram::bucket_upper_bound(i) << "\"";
+        f.samples.push_back(sample(h.first + "_bucket",
+                                   join_labels(labels, le.str()), cumulative));
+      }
+      cumulative += hist.bucket_count(latency_histogram::NUM_BUCKETS);
+      f.samples.push_back(sample(h.first + "_bucket",
+                                 join_labels(labels, "le=\"+Inf\""), cumulative));
+      f.samples.push_back(sample(h.first + "_sum", labels, hist.sum()));
+      f.samples.push_back(sample(h.first + "_count", labels, cumulative));
+      const double qs[3] = {0.5, 0.99, 0.999};
+      for (size_t i = 0; i < 3; ++i) {
+        std::stringstream q;
+        q << "quantile=\"" << qs[i] << "\"";
+        qf.samples.push_back(sample(qname, join_labels(labels, q.str()),
+                                    s.second->quantile(qs[i])));
+      }
+    }
+  }
+  registry_lock().unlock();
+  return families;
+}
+
+/// Records the wall time of a superstep phase of the synchronous engine
+void observe_engine_phase(const char* phase, double seconds) {
+  get_latency_histogram(
+      "graphlab_engine_phase_seconds",
+      "Wall time of each superstep phase of the synchronous engine",
+      std::string("phase=\"") + phase + "\"").observe(seconds);
+}
+
+} // anonymous namespace
+
+
+void install_engine_phase_metrics() {
+  superstep_phase_observer() = observe_engine_phase;
+}
+
+
+std::string prometheus_metrics_text() {
+  family_map families = local_metric_families();
+  // machine 0 adds the samples of all other machines
+  distributed_control* dc = distributed_control::get_instance();
+  if (dc != NULL && dc->procid() == 0) {
+    for (procid_t p = 1; p < dc->numprocs(); ++p) {
+      family_map remote = dc->remote_request(p, local_metric_families);
+      typedef family_map::value_type family_pair;
+      foreach(family_pair& f, remote) {
+        metric_family& local = families[f.first];
+        local.help = f.second.help;
+        local.type = f.second.type;
+        local.samples.insert(local.samples.end(), f.second.samples.begin(),
+                             f.second.samples.end());
+      }
+    }
+  }
+  std::stringstream strm;
+  typedef family_map::value_type family_pair;
+  foreach(const family_pair& f, families) {
+    strm << "# HELP " << f.first << " " << f.second.help << "\n"
+         << "# TYPE " << f.first << " " << f.second.type << "\n";
+    foreach(const std::string& s, f.second.samples) strm << s;
+  }
+  return strm.str();
+}
+
+
+std::pair<std::string, std::string>
+prometheus_metrics_page(std::map<std::string, std::string>& varmap) {
+  return std::make_pair(std::string("text/plain; version=0.0.4"),
+                        prometheus_metrics_text());
+}
+
+} // namespace graphlab
@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+#ifndef GRAPHLAB_PROMETHEUS_METRICS_HPP
+#define GRAPHLAB_PROMETHEUS_METRICS_HPP
+#include <string>
+#include <map>
+#include <utility>
+#include <boost/function.hpp>
+#include <graphlab/parallel/atomic.hpp>
+
+namespace graphlab {
+
+/**
+  \ingroup httpserver
+  \brief A fixed bucket latency histogram which is cheap enough to be
+  updated on every request or superstep.
+
+  Buckets are powers of two starting at 1 microsecond, so the
+  histogram covers latencies up to about 35 minutes. observe() is
+  lock free (two atomic increments). Quantiles are estimated by linear
+  interpolation within the bucket containing the quantile.
+ */
+class latency_histogram {
+ public:
+  /// The number of finite buckets. There is one extra +Inf bucket.
+  static const size_t NUM_BUCKETS = 32;
+
+  latency_histogram() { }
+
+  /// Record one observation of the given number of seconds
+  void observe(double seconds);
+
+  /// The upper bound in seconds of the i-th bucket
+  static double bucket_upper_bound(size_t i);
+
+  /// Number of observations in bucket i (not cumulative)
+  size_t bucket_count(size_t i) const { return counts[i].value; }
+
+  /// Total number of observations
+  size_t count() const;
+
+  /// Sum of all observations in seconds
+  double sum() const { return double(sum_ns.value) / 1e9; }
+
+  /// Estimate the q-th quantile (0 < q < 1) in seconds
+  double quantile(double q) const;
+
+ private:
+  atomic<size_t> counts[NUM_BUCKETS + 1];
+  atomic<size_t> sum_ns;
+
+  // not copyable
+  latency_histogram(const latency_histogram&);
+  latency_histogram& operator=(const latency_histogram&);
+};
+
+
+/**
+  \ingroup httpserver
+  \brief Returns the latency histogram with the given metric name and
+  label set, creating it if it does not exist yet.
+
+  The returned reference stays valid for the lifetime of the program,
+  so callers on hot paths should look the histogram up once and keep
+  the reference.
+
+  \param name The metric name, e.g. "graphlab_engine_phase_seconds"
+  \param help A one line description of the metric
+  \param labels The label set without braces, e.g. "phase=\"gather\""
+ */
+latency_histogram& get_latency_histogram(const std::string& name,
+                                         const std::string& help,
+                                         const std::string& labels = "");
+
+
+/**
+  \ingroup httpserver
+  \brief Adds a gauge to the /metrics page. The callback is invoked on
+  every scrape and must be thread safe. Adding a gauge with an existing
+  name and label set replaces the callback.
+ */
+void add_prometheus_gauge(const std::string& name,
+                          const std::string& help,
+                          boost::function<double(void)> callback,
+                          const std::string& labels = "");
+
+
+/**
+  \ingroup httpserver
+  \brief Renders all metrics in the Prometheus text exposition format.
+
+  This includes the event log counters, RPC traffic per peer machine,
+  memory usage, and all registered histograms and gauges. Every sample
+  carries a machine label. Called on machine 0, the samples of all
+  machines are collected (with one remote request per machine), so the
+  page served by the metrics server covers the whole cluster; on any
+  other machine only its own samples are returned.
+ */
+std::string prometheus_metrics_text();
+
+
+/**
+  \ingroup httpserver
+  \brief Records the wall time of every superstep phase of the
+  synchronous engines of this machine in the
+  graphlab_engine_phase_seconds histogram. Called by
+  launch_metric_server() on every machine.
+ */
+void install_engine_phase_metrics();
+
+
+/**
+  \ingroup httpserver
+  \brief The metrics server callback serving prometheus_metrics_text()
+  on /metrics.
+ */
+std::pair<std::string, std::string>
+prometheus_metrics_page(std::map<std::string, std::string>& varmap);
+
+} // graphlab
+#endif // GRAPHLAB_PROMETHEUS_METRICS_HPP
@@ -0,0 +1,205 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#ifndef GRAPHLAB_BITSET_KERNELS_HPP
+#define GRAPHLAB_BITSET_KERNELS_HPP
+
+#include <cstddef>
+#include <stdint.h>
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+namespace graphlab {
+
+  /**
+   * \ingroup util
+   * Word parallel kernels over arrays of size_t used by dense_bitset.
+   *
+   * The AVX-512 and AVX2 versions are selected at compile time from the
+   * target architecture (the build uses -march=native by default).
+   * Otherwise the scalar loops are used. All kernels accept unaligned
+   * arrays of any length.
+   */
+  namespace bitset_kernels {
+
+    struct and_op {
+      static inline size_t apply(size_t a, size_t b) { return a & b; }
+#ifdef __AVX512F__
+      static inline __m512i apply(__m512i a, __m512i b) {
+        return _mm512_and_si512(a, b);
+      }
+#endif
+#ifdef __AVX2__
+      static inline __m256i apply(__m256i a, __m256i b) {
+        return _mm256_and_si256(a, b);
+      }
+#endif
+    };
+
+    struct or_op {
+      static inline size_t apply(size_t a, size_t b) { return a | b; }
+#ifdef __AVX512F__
+      static inline __m512i apply(__m512i a, __m512i b) {
+        return _mm512_or_si512(a, b);
+      }
+#endif
+#ifdef __AVX2__
+      static inline __m256i apply(__m256i a, __m256i b) {
+        return _mm256_or_si256(a, b);
+      }
+#endif
+    };
+
+    /// a & ~b
+    struct andnot_op {
+      static inline size_t apply(size_t a, size_t b) { return a & ~b; }
+#ifdef __AVX512F__
+      static inline __m512i apply(__m512i a, __m512i b) {
+        return _mm512_andnot_si512(b, a);
+      }
+#endif
+#ifdef __AVX2__
+      static inline __m256i apply(__m256i a, __m256i b) {
+        return _mm256_andnot_si256(b, a);
+      }
+#endif
+    };
+
+    /**
+     * out[i] = Op(a[i], b[i]) for i in [0, n). out may alias a or b.
+     */
+    template <typename Op>
+    inline void binary_op(size_t* out, const size_t* a, const size_t* b,
+                          size_t n) {
+      size_t i = 0;
+#if defined(__AVX512F__)
+      for (; i + 8 <= n; i += 8) {
+        __m512i x = _mm512_loadu_si512((const void*)(a + i));
+        __m512i y = _mm512_loadu_si512((const void*)(b + i));
+        _mm512_storeu_si512((void*)(out + i), Op::apply(x, y));
+      }
+#endif
+#if defined(__AVX2__)
+      for (; i + 4 <= n; i += 4) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+        __m256i y = _mm256_loadu_si256((const __m256i*)(b + i));
+        _mm256_storeu_si256((__m256i*)(out + i), Op::apply(x, y));
+      }
+#endif
+      for (; i < n; ++i) out[i] = Op::apply(a[i], b[i]);
+    }
+
+    /// Number of set bits in a[0, n)
+    inline size_t popcount(const size_t* a, size_t n) {
+      size_t ret = 0;
+      size_t i = 0;
+#if defined(__AVX512F__) && defined(__AVX512VPOPCNTDQ__)
+      __m512i acc512 = _mm512_setzero_si512();
+      for (; i + 8 <= n; i += 8) {
+        __m512i x = _mm512_loadu_si512((const void*)(a + i));
+        acc512 = _mm512_add_epi64(acc512, _mm512_popcnt_epi64(x));
+      }
+      ret += _mm512_reduce_add_epi64(acc512);
+#endif
+#if defined(__AVX2__)
+      // nibble lookup popcount (Mula et al.), summed per 64 bit lane
+      const __m256i lookup =
+          _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                           0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+      const __m256i low_mask = _mm256_set1_epi8(0x0f);
+      __m256i acc = _mm256_setzero_si256();
+      for (; i + 4 <= n; i += 4) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+        __m256i lo = _mm256_and_si256(x, low_mask);
+        __m256i hi = _mm256_and_si256(_mm256_srli_epi16(x, 4), low_mask);
+        __m256i cnt = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, lo),
+                                      _mm256_shuffle_epi8(lookup, hi));
+        acc = _mm256_add_epi64(acc, _mm256_sad_epu8(cnt,
+                                                    _mm256_setzero_si256()));
+      }
+      ret += _mm256_extract_epi64(acc, 0) + _mm256_extract_epi64(acc, 1) +
+             _mm256_extract_epi64(acc, 2) + _mm256_extract_epi64(acc, 3);
+#endif
+      for (; i < n; ++i) ret += __builtin_popcountl(a[i]);
+      return ret;
+    }
+
+    /// Returns true if a[0, n) is all zero
+    inline bool all_zero(const size_t* a, size_t n) {
+      size_t i = 0;
+#if defined(__AVX2__)
+      for (; i + 4 <= n; i += 4) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+        if (!_mm256_testz_si256(x, x)) return false;
+      }
+#endif
+      for (; i < n; ++i) if (a[i]) return false;
+      return true;
+    }
+
+    /**
+     * Returns the index of the first non-zero word in a[begin, end),
+     * or end if there is none.
+     */
+    inline size_t next_nonzero_word(const size_t* a, size_t begin,
+                                    size_t end) {
+      size_t i = begin;
+#if defined(__AVX512F__)
+      for (; i + 8 <= end; i += 8) {
+        __m512i x = _mm512_loadu_si512((const void*)(a + i));
+        __mmask8 m = _mm512_test_epi64_mask(x, x);
+        if (m) return i + __builtin_ctz(m);
+      }
+#endif
+#if defined(__AVX2__)
+      for (; i + 4 <= end; i += 4) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+        if (!_mm256_testz_si256(x, x)) break;
+      }
+#endif
+      for (; i < end; ++i) if (a[i]) return i;
+      return end;
+    }
+
+    /**
+     * Returns the index of the first word in a[begin, end) which is not
+     * all ones, or end if there is none.
+     */
+    inline size_t next_nonfull_word(const size_t* a, size_t begin,
+                                    size_t end) {
+      size_t i = begin;
+#if defined(__AVX2__)
+      const __m256i ones = _mm256_set1_epi64x(-1);
+      for (; i + 4 <= end; i += 4) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+        if (!_mm256_testc_si256(x, ones)) break;
+      }
+#endif
+      for (; i < end; ++i) if (~a[i]) return i;
+      return end;
+    }
+
+  } // namespace bitset_kernels
+} // namespace graphlab
+#endif
@@ -28,8 +28,11 @@
 #include <cstdlib>
 #include <cstring>
 #include <stdint.h>
+#include <algorithm>
 #include <graphlab/logger/logger.hpp>
+#include <graphlab/parallel/atomic.hpp>
 #include <graphlab/parallel/atomic_ops.hpp>
+#include <graphlab/util/bitset_kernels.hpp>
 #include <graphlab/serialization/serialization_includes.hpp>
 
 namespace graphlab {
@@ -99,8 +102,7 @@ namespace graphlab {
     }
     
     inline bool empty() const {
-      for (size_t i = 0; i < arrlen; ++i) if (array[i]) return false;
-      return true;
+      return bitset_kernels::all_zero(array, arrlen);
     }
     
     /// Sets all bits to 1
@@ -312,11 +314,10 @@ namespace graphlab {
         If such a bit does not exist, this function returns false.
     */
     inline bool first_bit(size_t &b) const {
-      for (size_t i = 0; i < arrlen; ++i) {
-        if (array[i]) {
-          b = (size_t)(i * (sizeof(size_t) * 8)) + first_bit_in_block(array[i]);
-          return true;
-        }
+      size_t i = bitset_kernels::next_nonzero_word(array, 0, arrlen);
+      if (i < arrlen) {
+        b = (size_t)(i * (sizeof(size_t) * 8)) + first_bit_in_block(array[i]);
+        return true;
       }
       return false;
     }
@@ -351,16 +352,58 @@ namespace graphlab {
       }
       else {
         // we have to loop through the rest of the array
-        for (size_t i = arrpos + 1; i < arrlen; ++i) {
-          if (array[i]) {
-            b = (size_t)(i * (sizeof(size_t) * 8)) + first_bit_in_block(array[i]);
-            return true;
-          }
+        size_t i = bitset_kernels::next_nonzero_word(array, arrpos + 1, arrlen);
+        if (i < arrlen) {
+          b = (size_t)(i * (sizeof(size_t) * 8)) + first_bit_in_block(array[i]);
+          return true;
         }
       }
       return false;
     }
 
+    /** Where begin is a bit index, this function returns in [begin, end)
+        the first run of consecutive bits set to true at or after begin,
+        and returns true. If all bits from begin on are false, this
+        function returns false. Whole words of zeros and of ones are
+        skipped word parallel, so iterating over the runs of a bitset
+        with long dense or empty ranges is much cheaper than iterating
+        over its bits:
+        \code
+        size_t b = 0, e = 0;
+        while (bitset.next_run(b, e)) {
+          // bits [b, e) are set
+          b = e;
+        }
+        \endcode
+    */
+    inline bool next_run(size_t &begin, size_t &end) const {
+      const size_t wordbits = 8 * sizeof(size_t);
+      if (begin >= len) return false;
+      size_t arrpos, bitpos;
+      bit_to_pos(begin, arrpos, bitpos);
+      // find the start of the run
+      size_t word = array[arrpos] & (size_t(-1) << bitpos);
+      if (word == 0) {
+        arrpos = bitset_kernels::next_nonzero_word(array, arrpos + 1, arrlen);
+        if (arrpos == arrlen) return false;
+        word = array[arrpos];
+      }
+      bitpos = __builtin_ctzl(word);
+      begin = arrpos * wordbits + bitpos;
+      // find the end of the run: the first zero bit after begin
+      size_t inv = ~array[arrpos] & (size_t(-1) << bitpos);
+      if (inv == 0) {
+        arrpos = bitset_kernels::next_nonfull_word(array, arrpos + 1, arrlen);
+        if (arrpos == arrlen) {
+          end = len;
+          return true;
+        }
+        inv = ~array[arrpos];
+      }
+      end = std::min(len, arrpos * wordbits + __builtin_ctzl(inv));
+      return true;
+    }
+
     ///  Returns the number of bits in this bitset
     inline size_t size() const {
       return len;
@@ -384,68 +427,115 @@ namespace graphlab {
     }
 
 
+    /// Returns the number of bits set to true
     size_t popcount() const {
-      size_t ret = 0;
-      for (size_t i = 0;i < arrlen; ++i) {
-        ret +=  __builtin_popcountl(array[i]);
-      }
-      return ret;
+      return bitset_kernels::popcount(array, arrlen);
     }
 
     dense_bitset operator&(const dense_bitset& other) const {
       ASSERT_EQ(size(), other.size());
-      dense_bitset ret(size());
-      for (size_t i = 0; i < arrlen; ++i) {
-        ret.array[i] = array[i] & other.array[i];
-      }
+      dense_bitset ret;
+      ret.resize(size());
+      bitset_kernels::binary_op<bitset_kernels::and_op>(ret.array, array,
+                                                        other.array, arrlen);
       return ret;
     }
 
 
     dense_bitset operator|(const dense_bitset& other) const {
       ASSERT_EQ(size(), other.size());
-      dense_bitset ret(size());
-      for (size_t i = 0; i < arrlen; ++i) {
-        ret.array[i] = array[i] | other.array[i];
-      }
+      dense_bitset ret;
+      ret.resize(size());
+      bitset_kernels::binary_op<bitset_kernels::or_op>(ret.array, array,
+                                                       other.array, arrlen);
       return ret;
     }
 
     dense_bitset operator-(const dense_bitset& other) const {
       ASSERT_EQ(size(), other.size());
-      dense_bitset ret(size());
-      for (size_t i = 0; i < arrlen; ++i) {
-        ret.array[i] = array[i] - (array[i] & other.array[i]);
-      }
+      dense_bitset ret;
+      ret.resize(size());
+      bitset_kernels::binary_op<bitset_kernels::andnot_op>(ret.array, array,
+                                                           other.array, arrlen);
       return ret;
     }
 
 
     dense_bitset& operator&=(const dense_bitset& other) {
       ASSERT_EQ(size(), other.size());
-      for (size_t i = 0; i < arrlen; ++i) {
-        array[i] &= other.array[i];
-      }
+      bitset_kernels::binary_op<bitset_kernels::and_op>(array, array,
+                                                        other.array, arrlen);
       return *this;
     }
 
 
     dense_bitset& operator|=(const dense_bitset& other) {
       ASSERT_EQ(size(), other.size());
-      for (size_t i = 0; i < arrlen; ++i) {
-        array[i] |= other.array[i];
-      }
+      bitset_kernels::binary_op<bitset_kernels::or_op>(array, array,
+                                                       other.array, arrlen);
       return *this;
     }
 
     dense_bitset& operator-=(const dense_bitset& other) {
       ASSERT_EQ(size(), other.size());
-      for (size_t i = 0; i < arrlen; ++i) {
-        array[i] = array[i] - (array[i] & other.array[i]);
-      }
+      bitset_kernels::binary_op<bitset_kernels::andnot_op>(array, array,
+                                                           other.array, arrlen);
       return *this;
     }
 
+    /**
+     * Hands out the non-zero words of a bitset to a group of threads
+     * sharing an atomic bit counter (which must start at 0). Each call to
+     * next_word() claims a block of WORDS_PER_CLAIM words from the counter
+     * and skips the empty words of the block word parallel, so sparse
+     * bitsets are scanned without one atomic operation per word.
+     *
+     * Typical use by every thread:
+     * \code
+     * dense_bitset::word_scanner scanner(bitset, shared_counter);
+     * size_t block_start, word;
+     * while (scanner.next_word(block_start, word)) {
+     *   // bit i of word is bit block_start + i of the bitset
+     * }
+     * \endcode
+     * Words are read when they are handed out. Bits set in a block
+     * after it was claimed may be missed, as with containing_word().
+     */
+    class word_scanner {
+     public:
+      static const size_t WORDS_PER_CLAIM = 8;
+
+      word_scanner(const dense_bitset& bitset, atomic<size_t>& counter) :
+        bitset(bitset), counter(counter), pos(0), end(0) { }
+
+      /**
+       * Returns in block_start the index of the first bit of the next
+       * non-zero word and in word its value, and returns true. Returns
+       * false when the bitset is exhausted.
+       */
+      inline bool next_word(size_t& block_start, size_t& word) {
+        const size_t wordbits = 8 * sizeof(size_t);
+        while (1) {
+          pos = bitset_kernels::next_nonzero_word(bitset.array, pos, end);
+          if (pos < end) {
+            block_start = pos * wordbits;
+            word = bitset.array[pos];
+            ++pos;
+            return true;
+          }
+          size_t b = counter.inc_ret_last(WORDS_PER_CLAIM * wordbits);
+          if (b >= bitset.size()) return false;
+          pos = b / wordbits;
+          end = std::min(pos + WORDS_PER_CLAIM, bitset.arrlen);
+        }
+      }
+
+     private:
+      const dense_bitset& bitset;
+      atomic<size_t>& counter;
+      size_t pos, end;
+    };
+
     void invert() {
       for (size_t i = 0; i < arrlen; ++i) {
         array[i] = ~array[i];
@@ -0,0 +1,184 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#ifndef GRAPHLAB_SORTED_INTERSECTION_HPP
+#define GRAPHLAB_SORTED_INTERSECTION_HPP
+
+#include <cstddef>
+#include <stdint.h>
+#if defined(__SSE4_1__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace graphlab {
+
+  /**
+   * \ingroup util
+   * Intersections of sorted arrays without duplicates, as used for
+   * triangle counting over adjacency lists.
+   *
+   * intersection_size() merges the two arrays, comparing blocks of 4
+   * (SSE4.1) or 8 (AVX2) 32 bit keys of each array at once (Schlegel
+   * et al., Lemire et al.), and switches to galloping (exponential
+   * search of the larger array) when the sizes are very different.
+   * for_each_intersection() calls a function on every common element
+   * using the same merge/gallop choice without SIMD.
+   */
+  namespace sorted_intersection {
+
+    /// Use galloping when the larger array is this many times larger
+    static const size_t GALLOP_RATIO = 32;
+
+    /**
+     * Returns the first position in [begin, end) of b with
+     * b[pos] >= key, searching exponentially from begin.
+     */
+    template <typename T>
+    inline size_t gallop(const T* b, size_t begin, size_t end, T key) {
+      size_t step = 1;
+      size_t lo = begin, hi = begin;
+      while (hi < end && b[hi] < key) {
+        lo = hi + 1;
+        hi += step;
+        step *= 2;
+      }
+      if (hi > end) hi = end;
+      // binary search in [lo, hi)
+      while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (b[mid] < key) lo = mid + 1;
+        else hi = mid;
+      }
+      return lo;
+    }
+
+    /// Calls f(x) for every x in both a[0, na) and b[0, nb)
+    template <typename T, typename F>
+    inline void for_each_intersection(const T* a, size_t na,
+                                      const T* b, size_t nb, F& f) {
+      if (na > nb) {
+        const T* t = a; a = b; b = t;
+        size_t tn = na; na = nb; nb = tn;
+      }
+      if (na == 0) return;
+      if (nb / na >= GALLOP_RATIO) {
+        size_t j = 0;
+        for (size_t i = 0; i < na && j < nb; ++i) {
+          j = gallop(b, j, nb, a[i]);
+          if (j < nb && b[j] == a[i]) { f(a[i]); ++j; }
+        }
+        return;
+      }
+      size_t i = 0, j = 0;
+      while (i < na && j < nb) {
+        if (a[i] < b[j]) ++i;
+        else if (b[j] < a[i]) ++j;
+        else { f(a[i]); ++i; ++j; }
+      }
+    }
+
+    /// The scalar merge of intersection_size()
+    template <typename T>
+    inline size_t merge_count(const T* a, size_t na, const T* b, size_t nb,
+                              size_t i = 0, size_t j = 0) {
+      size_t count = 0;
+      while (i < na && j < nb) {
+        if (a[i] < b[j]) ++i;
+        else if (b[j] < a[i]) ++j;
+        else { ++count; ++i; ++j; }
+      }
+      return count;
+    }
+
+    /// Size of the intersection of a[0, na) and b[0, nb)
+    template <typename T>
+    inline size_t intersection_size(const T* a, size_t na,
+                                    const T* b, size_t nb) {
+      struct counter {
+        size_t count;
+        void operator()(const T&) { ++count; }
+      } c;
+      c.count = 0;
+      if (na == 0 || nb == 0) return 0;
+      if (na / nb >= GALLOP_RATIO || nb / na >= GALLOP_RATIO) {
+        for_each_intersection(a, na, b, nb, c);
+        return c.count;
+      }
+      return merge_count(a, na, b, nb);
+    }
+
+    /// 32 bit keys use the SIMD block merge when available
+    inline size_t intersection_size(const uint32_t* a, size_t na,
+                                    const uint32_t* b, size_t nb) {
+      if (na == 0 || nb == 0) return 0;
+      if (na / nb >= GALLOP_RATIO || nb / na >= GALLOP_RATIO) {
+        struct counter {
+          size_t count;
+          void operator()(const uint32_t&) { ++count; }
+        } c;
+        c.count = 0;
+        for_each_intersection(a, na, b, nb, c);
+        return c.count;
+      }
+      size_t count = 0;
+      size_t i = 0, j = 0;
+#if defined(__AVX2__)
+      // compare 8 keys of a with all 8 rotations of 8 keys of b. The
+      // keys are unique so each lane of a matches at most once.
+      const __m256i rotate = _mm256_setr_epi32(1, 2, 3, 4, 5, 6, 7, 0);
+      while (i + 8 <= na && j + 8 <= nb) {
+        __m256i va = _mm256_loadu_si256((const __m256i*)(a + i));
+        __m256i vb = _mm256_loadu_si256((const __m256i*)(b + j));
+        __m256i match = _mm256_cmpeq_epi32(va, vb);
+        for (int r = 1; r < 8; ++r) {
+          vb = _mm256_permutevar8x32_epi32(vb, rotate);
+          match = _mm256_or_si256(match, _mm256_cmpeq_epi32(va, vb));
+        }
+        count += __builtin_popcount(
+            _mm256_movemask_ps(_mm256_castsi256_ps(match)));
+        const uint32_t amax = a[i + 7], bmax = b[j + 7];
+        if (amax <= bmax) i += 8;
+        if (bmax <= amax) j += 8;
+      }
+#endif
+#if defined(__SSE4_1__)
+      while (i + 4 <= na && j + 4 <= nb) {
+        __m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+        __m128i vb = _mm_loadu_si128((const __m128i*)(b + j));
+        __m128i match = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi32(va, vb),
+                         _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, 0x39))),
+            _mm_or_si128(_mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, 0x4e)),
+                         _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, 0x93))));
+        count += __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(match)));
+        const uint32_t amax = a[i + 3], bmax = b[j + 3];
+        if (amax <= bmax) i += 4;
+        if (bmax <= amax) j += 4;
+      }
+#endif
+      return count + merge_count(a, na, b, nb, i, j);
+    }
+
+  } // namespace sorted_intersection
+} // namespace graphlab
+#endif
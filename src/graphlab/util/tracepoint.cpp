@@ -21,13 +21,23 @@
  */
 
 
+#include <cstdlib>
+#include <cstring>
 #include <limits>
 #include <string>
+#include <map>
+#include <new>
+#include <vector>
+#include <boost/bind.hpp>
 #include <graphlab/logger/assertions.hpp>
 #include <graphlab/util/tracepoint.hpp>
 #include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/rpc/dc.hpp>
+#include <graphlab/rpc/distributed_event_log.hpp>
 #include <boost/unordered_map.hpp>
 
+#include <graphlab/macros_def.hpp>
+
 
 namespace graphlab {
 
@@ -67,5 +77,258 @@ trace_count::~trace_count() {
 #endif
 }
 
-} // namespace graphlab
 
+
+volatile bool sampled_tracepoints_enabled = false;
+size_t sampled_tracepoint_interval = 64;
+__thread size_t sampled_tracer_thread_slot = size_t(-1);
+
+static atomic<size_t> next_sampled_tracer_thread_slot;
+
+size_t assign_sampled_tracer_thread_slot() {
+  sampled_tracer_thread_slot = next_sampled_tracer_thread_slot.inc_ret_last() %
+                               sampled_tracer::MAX_THREADS;
+  return sampled_tracer_thread_slot;
+}
+
+static mutex& sampled_tracer_lock() {
+  static mutex lock;
+  return lock;
+}
+
+static std::map<std::string, sampled_tracer*>& sampled_tracers() {
+  static std::map<std::string, sampled_tracer*> tracers;
+  return tracers;
+}
+
+sampled_tracer::sampled_tracer(const char* name, const char* description):
+    name(name), description(description), event_log_registered(false) {
+  // new[] does not honor the cache line alignment of thread_counts,
+  // which keeps threads from sharing a line
+  void* mem = NULL;
+  if (posix_memalign(&mem, __alignof__(thread_counts),
+                     sizeof(thread_counts) * MAX_THREADS) != 0) {
+    throw std::bad_alloc();
+  }
+  counts = static_cast<thread_counts*>(mem);
+  memset(counts, 0, sizeof(thread_counts) * MAX_THREADS);
+}
+
+sampled_tracer::~sampled_tracer() {
+  free(counts);
+}
+
+size_t sampled_tracer::events() const {
+  size_t ret = 0;
+  for (size_t i = 0; i < MAX_THREADS; ++i) ret += counts[i].events;
+  return ret;
+}
+
+size_t sampled_tracer::sampled() const {
+  size_t ret = 0;
+  for (size_t i = 0; i < MAX_THREADS; ++i) ret += counts[i].sampled;
+  return ret;
+}
+
+double sampled_tracer::sampled_ticks() const {
+  double ret = 0;
+  for (size_t i = 0; i < MAX_THREADS; ++i) ret += counts[i].ticks;
+  return ret;
+}
+
+void sampled_tracer::histogram(size_t* hist) const {
+  for (size_t b = 0; b < NUM_BUCKETS; ++b) hist[b] = 0;
+  for (size_t i = 0; i < MAX_THREADS; ++i) {
+    for (size_t b = 0; b < NUM_BUCKETS; ++b) hist[b] += counts[i].histogram[b];
+  }
+}
+
+namespace {
+
+/// The counts of a sampled tracer, which can be summed over machines
+struct tracer_summary {
+  std::string description;
+  size_t events;
+  size_t sampled;
+  double ticks;
+  std::vector<size_t> histogram;
+
+  tracer_summary(): events(0), sampled(0), ticks(0),
+                    histogram(sampled_tracer::NUM_BUCKETS, 0) { }
+
+  explicit tracer_summary(const sampled_tracer& tracer):
+      description(tracer.get_description()), events(tracer.events()),
+      sampled(tracer.sampled()), ticks(tracer.sampled_ticks()),
+      histogram(sampled_tracer::NUM_BUCKETS) {
+    tracer.histogram(&histogram[0]);
+  }
+
+  tracer_summary& operator+=(const tracer_summary& other) {
+    description = other.description;
+    events += other.events;
+    sampled += other.sampled;
+    ticks += other.ticks;
+    for (size_t b = 0; b < histogram.size(); ++b) {
+      histogram[b] += other.histogram[b];
+    }
+    return *this;
+  }
+
+  void save(oarchive& oarc) const {
+    oarc << description << events << sampled << ticks << histogram;
+  }
+  void load(iarchive& iarc) {
+    iarc >> description >> events >> sampled >> ticks >> histogram;
+  }
+
+  double estimated_total_ms() const {
+    if (sampled == 0) return 0;
+    double tperms = (double)estimate_ticks_per_second() / 1000;
+    return ticks / tperms * events / sampled;
+  }
+
+  double quantile_ms(double q) const {
+    size_t total = 0;
+    for (size_t b = 0; b < histogram.size(); ++b) total += histogram[b];
+    if (total == 0) return 0;
+    double tperms = (double)estimate_ticks_per_second() / 1000;
+    double rank = q * total;
+    size_t cumulative = 0;
+    for (size_t b = 0; b < histogram.size(); ++b) {
+      if (histogram[b] > 0 && cumulative + histogram[b] >= rank) {
+        // bucket b holds [2^(b-1), 2^b) ticks
+        double lower = b == 0 ? 0 : double(1ULL << (b - 1));
+        double upper = double(1ULL << b);
+        return (lower + (upper - lower) * (rank - cumulative) / histogram[b])
+               / tperms;
+      }
+      cumulative += histogram[b];
+    }
+    return double(1ULL << (histogram.size() - 1)) / tperms;
+  }
+
+  void print(std::ostream& out, const std::string& name) const {
+    out << name << ": " << description << "\n";
+    out << "Events:\t" << events << "\n";
+    out << "Sampled:\t" << sampled << "\n";
+    if (sampled > 0) {
+      out << "Total:\t" << estimated_total_ms() << " ms (estimated)\n";
+      out << "Mean:\t" << estimated_total_ms() / events << " ms \n";
+      out << "p50:\t" << quantile_ms(0.5) << " ms \n";
+      out << "p99:\t" << quantile_ms(0.99) << " ms \n";
+      out << "p999:\t" << quantile_ms(0.999) << " ms \n";
+    }
+  }
+};
+
+} // anonymous namespace
+
+double sampled_tracer::estimated_total_ms() const {
+  return tracer_summary(*this).estimated_total_ms();
+}
+
+double sampled_tracer::quantile_ms(double q) const {
+  return tracer_summary(*this).quantile_ms(q);
+}
+
+void sampled_tracer::clear() {
+  memset(counts, 0, sizeof(thread_counts) * MAX_THREADS);
+}
+
+void sampled_tracer::print(std::ostream& out) const {
+  tracer_summary(*this).print(out, name);
+}
+
+static double sampled_tracer_events(sampled_tracer* tracer) {
+  return tracer->events();
+}
+
+static double sampled_tracer_total_ms(sampled_tracer* tracer) {
+  return tracer->estimated_total_ms();
+}
+
+void sampled_tracer::register_event_log() {
+  if (event_log_registered) return;
+  event_log_registered = true;
+  get_event_log().create_callback_entry(description + " Events", "events",
+                              boost::bind(sampled_tracer_events, this),
+                              log_type::CUMULATIVE);
+  get_event_log().create_callback_entry(description + " Time", "ms",
+                              boost::bind(sampled_tracer_total_ms, this),
+                              log_type::CUMULATIVE);
+}
+
+sampled_tracer& get_sampled_tracer(const char* name, const char* description) {
+  sampled_tracer_lock().lock();
+  sampled_tracer*& tracer = sampled_tracers()[name];
+  if (tracer == NULL) {
+    tracer = new sampled_tracer(name, description);
+    if (sampled_tracepoints_enabled) tracer->register_event_log();
+  }
+  sampled_tracer& ret = *tracer;
+  sampled_tracer_lock().unlock();
+  return ret;
+}
+
+void enable_sampled_tracepoints(size_t sample_interval) {
+  ASSERT_GT(sample_interval, 0);
+  sampled_tracer_lock().lock();
+  typedef std::map<std::string, sampled_tracer*>::value_type pair_type;
+  foreach(const pair_type& p, sampled_tracers()) {
+    p.second->register_event_log();
+  }
+  sampled_tracepoint_interval = sample_interval;
+  sampled_tracepoints_enabled = true;
+  sampled_tracer_lock().unlock();
+}
+
+void disable_sampled_tracepoints() {
+  sampled_tracepoints_enabled = false;
+}
+
+void print_sampled_tracepoints(std::ostream& out) {
+  sampled_tracer_lock().lock();
+  typedef std::map<std::string, sampled_tracer*>::value_type pair_type;
+  foreach(const pair_type& p, sampled_tracers()) {
+    if (p.second->events() > 0) p.second->print(out);
+  }
+  sampled_tracer_lock().unlock();
+}
+
+void print_sampled_tracepoints(distributed_control& dc, std::ostream& out) {
+  typedef std::map<std::string, tracer_summary> summary_map;
+  std::vector<summary_map> all_summaries(dc.numprocs());
+  sampled_tracer_lock().lock();
+  typedef std::map<std::string, sampled_tracer*>::value_type pair_type;
+  foreach(const pair_type& p, sampled_tracers()) {
+    all_summaries[dc.procid()][p.first] = tracer_summary(*p.second);
+  }
+  sampled_tracer_lock().unlock();
+  dc.gather(all_summaries, 0);
+  if (dc.procid() != 0) return;
+  summary_map total;
+  for (size_t i = 0; i < all_summaries.size(); ++i) {
+    typedef summary_map::value_type summary_pair;
+    foreach(const summary_pair& p, all_summaries[i]) total[p.first] += p.second;
+  }
+  typedef summary_map::value_type summary_pair;
+  foreach(const summary_pair& p, total) {
+    if (p.second.events > 0) p.second.print(out, p.first);
+  }
+}
+
+/**
+ * Enables the sampled tracers at startup if GRAPHLAB_SAMPLED_TRACEPOINTS
+ * is set to the sampling interval
+ */
+static struct sampled_tracepoints_from_env {
+  sampled_tracepoints_from_env() {
+    const char* interval = getenv("GRAPHLAB_SAMPLED_TRACEPOINTS");
+    if (interval != NULL && atol(interval) > 0) {
+      enable_sampled_tracepoints(atol(interval));
+    }
+  }
+} sampled_tracepoints_from_env_instance;
+
+} // namespace graphlab
+#include <graphlab/macros_undef.hpp>
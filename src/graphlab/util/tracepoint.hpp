@@ -33,6 +33,8 @@
 
 namespace graphlab{
 
+class distributed_control;
+
 struct trace_count{
   std::string name;
   std::string description;
@@ -116,6 +118,184 @@ struct trace_count{
   void print(std::ostream& out, unsigned long long tpersec = 0) const;
 };
 
+
+
+/**
+ * \internal
+ * Global switch and sampling interval of all sampled tracers.
+ * Use enable_sampled_tracepoints() and disable_sampled_tracepoints().
+ */
+extern volatile bool sampled_tracepoints_enabled;
+extern size_t sampled_tracepoint_interval;
+
+/**
+ * \internal
+ * The slot of the calling thread in the per-thread arrays of
+ * the sampled tracers. Assigned on first use.
+ */
+extern __thread size_t sampled_tracer_thread_slot;
+size_t assign_sampled_tracer_thread_slot();
+
+/**
+ * A tracer which unlike trace_count can be left in production hot
+ * paths: it is always compiled in, is switched on and off at runtime,
+ * and when on only times one in every sampled_tracepoint_interval
+ * events.
+ *
+ * While disabled a tracepoint costs one load and a branch. While
+ * enabled every event increments a thread local counter and only
+ * sampled events read the time stamp counter. The durations of the
+ * sampled events are recorded in a thread local histogram with
+ * power of two buckets (in ticks).
+ *
+ * Every sampled tracer is reported on the distributed event log as
+ * two cumulative entries, "<description> Events" and
+ * "<description> Time" (estimated total milliseconds), so that they
+ * are aggregated across machines and appear on the metrics server.
+ * The member functions and print() only cover this machine; use
+ * print_sampled_tracepoints(dc, out) for the histograms and quantiles
+ * of all machines.
+ *
+ * Sampled tracers are obtained by name from get_sampled_tracer() (see
+ * DECLARE_SAMPLED_TRACER) so that a tracer declared in a header is
+ * shared by all translation units, and are never destroyed. With more
+ * than MAX_THREADS threads some threads share a slot, and counts may
+ * be slightly low.
+ */
+class sampled_tracer {
+ public:
+  static const size_t MAX_THREADS = 256;
+  static const size_t NUM_BUCKETS = 48;
+
+  sampled_tracer(const char* name, const char* description);
+
+  ~sampled_tracer();
+
+  /**
+   * Starts an event. Returns the starting time stamp if this event
+   * is sampled, and 0 otherwise.
+   */
+  inline unsigned long long begin() __attribute__((always_inline)) {
+    if (__likely__(!sampled_tracepoints_enabled)) return 0;
+    thread_counts& c = local_counts();
+    ++c.events;
+    if (__likely__(c.countdown > 1)) {
+      --c.countdown;
+      return 0;
+    }
+    c.countdown = sampled_tracepoint_interval;
+    return rdtsc();
+  }
+
+  /**
+   * Ends an event started with begin()
+   */
+  inline void end(unsigned long long start) __attribute__((always_inline)) {
+    if (__likely__(start == 0)) return;
+    unsigned long long ticks = rdtsc() - start;
+    thread_counts& c = local_counts();
+    ++c.sampled;
+    c.ticks += ticks;
+    size_t bucket = ticks == 0 ? 0 : 64 - __builtin_clzll(ticks);
+    if (bucket >= NUM_BUCKETS) bucket = NUM_BUCKETS - 1;
+    ++c.histogram[bucket];
+  }
+
+  /// Total number of events on this machine
+  size_t events() const;
+
+  /// Number of timed (sampled) events on this machine
+  size_t sampled() const;
+
+  /// Total ticks of the sampled events on this machine
+  double sampled_ticks() const;
+
+  /// Estimated total time in milliseconds spent in the traced region
+  double estimated_total_ms() const;
+
+  /// Fills hist[NUM_BUCKETS] with the tick histogram of this machine
+  void histogram(size_t* hist) const;
+
+  /**
+   * Estimates the q-th quantile (0 < q < 1) of the duration of an
+   * event in milliseconds from the histogram of the sampled events
+   */
+  double quantile_ms(double q) const;
+
+  /// Forget all counts
+  void clear();
+
+  /// Print the counts and quantiles of this machine
+  void print(std::ostream& out) const;
+
+  /// Create the event log entries of this tracer if not yet created
+  void register_event_log();
+
+  inline const std::string& get_name() const { return name; }
+
+  inline const std::string& get_description() const { return description; }
+
+ private:
+  struct thread_counts {
+    size_t events;
+    size_t countdown;
+    size_t sampled;
+    unsigned long long ticks;
+    size_t histogram[NUM_BUCKETS];
+  } __attribute__((aligned(64)));
+
+  std::string name;
+  std::string description;
+  thread_counts* counts;
+  bool event_log_registered;
+
+  inline thread_counts& local_counts() __attribute__((always_inline)) {
+    size_t slot = sampled_tracer_thread_slot;
+    if (__unlikely__(slot == size_t(-1))) {
+      slot = assign_sampled_tracer_thread_slot();
+    }
+    return counts[slot];
+  }
+
+  // not copyable
+  sampled_tracer(const sampled_tracer&);
+  sampled_tracer& operator=(const sampled_tracer&);
+};
+
+
+/**
+ * Enables all sampled tracers. One out of every sample_interval events
+ * of each thread is timed.
+ * Sampled tracers can also be enabled at startup by setting the
+ * environment variable GRAPHLAB_SAMPLED_TRACEPOINTS to the interval.
+ */
+void enable_sampled_tracepoints(size_t sample_interval = 64);
+
+/**
+ * Returns the sampled tracer with the given name, creating it with the
+ * given description if it does not exist yet.
+ */
+sampled_tracer& get_sampled_tracer(const char* name, const char* description);
+
+/**
+ * Disables all sampled tracers. Counts are kept.
+ */
+void disable_sampled_tracepoints();
+
+/**
+ * Prints the local counts of all sampled tracers with at least one event
+ */
+void print_sampled_tracepoints(std::ostream& out);
+
+/**
+ * Prints the counts, histograms and quantiles of all sampled tracers
+ * with at least one event summed over all machines. Must be called on
+ * all machines simultaneously; only machine 0 prints. Tick counts of
+ * different machines are added up, so the quantiles assume the
+ * machines run at similar clock rates.
+ */
+void print_sampled_tracepoints(distributed_control& dc, std::ostream& out);
+
 } // namespace
 
 /**
@@ -160,6 +340,33 @@ Example Usage:
 */
 
 
+/**
+ * DECLARE_SAMPLED_TRACER(name, desc)
+ * creates a global sampled_tracer called "name". Unlike DECLARE_TRACER,
+ * sampled tracers are always compiled in and are switched on at runtime
+ * with graphlab::enable_sampled_tracepoints().
+ *
+ * BEGIN_SAMPLED_TRACEPOINT(name)
+ * END_SAMPLED_TRACEPOINT(name)
+ * Times a block of code with the sampled tracer "name". Every
+ * END_SAMPLED_TRACEPOINT must be matched with a BEGIN_SAMPLED_TRACEPOINT
+ * within the same scope.
+ *
+Example Usage:
+  DECLARE_SAMPLED_TRACER(engine_signal, "Engine Signal")
+  Then later on...
+  BEGIN_SAMPLED_TRACEPOINT(engine_signal)
+  ...
+  END_SAMPLED_TRACEPOINT(engine_signal)
+ */
+#define DECLARE_SAMPLED_TRACER(name, description) \
+    static graphlab::sampled_tracer& name = \
+        graphlab::get_sampled_tracer(#name, description);
+#define BEGIN_SAMPLED_TRACEPOINT(name) \
+    unsigned long long __ ## name ## _strace_ = name.begin();
+#define END_SAMPLED_TRACEPOINT(name) name.end(__ ## name ## _strace_);
+
+
 #ifdef USE_TRACEPOINT
 #define DECLARE_TRACER(name) graphlab::trace_count name;
 
@@ -95,6 +95,62 @@ public:
   }
 
 
+  void test_densebitset_bulk(void) {
+    // large enough to exercise the vector kernels and their tails
+    const size_t n = 1000;
+    dense_bitset a(n), b(n);
+    for (size_t i = 0; i < n; ++i) {
+      if (i % 3 == 0) a.set_bit(i);
+      if (i % 5 == 0) b.set_bit(i);
+    }
+    size_t nand = 0, nor = 0, nminus = 0;
+    for (size_t i = 0; i < n; ++i) {
+      nand += (i % 3 == 0 && i % 5 == 0);
+      nor += (i % 3 == 0 || i % 5 == 0);
+      nminus += (i % 3 == 0 && i % 5 != 0);
+    }
+    TS_ASSERT_EQUALS((a & b).popcount(), nand);
+    TS_ASSERT_EQUALS((a | b).popcount(), nor);
+    TS_ASSERT_EQUALS((a - b).popcount(), nminus);
+    dense_bitset c = a;
+    c -= b;
+    for (size_t i = 0; i < n; ++i) {
+      TS_ASSERT_EQUALS(c.get(i), i % 3 == 0 && i % 5 != 0);
+    }
+    c.clear();
+    TS_ASSERT(c.empty());
+
+    // runs: [0, 5), [64, 300), [999, 1000)
+    c.set_bit(999);
+    for (size_t i = 0; i < 5; ++i) c.set_bit(i);
+    for (size_t i = 64; i < 300; ++i) c.set_bit(i);
+    size_t runs[3][2] = {{0, 5}, {64, 300}, {999, 1000}};
+    size_t rb = 0, re = 0, nruns = 0;
+    while (c.next_run(rb, re)) {
+      TS_ASSERT(nruns < 3);
+      TS_ASSERT_EQUALS(rb, runs[nruns][0]);
+      TS_ASSERT_EQUALS(re, runs[nruns][1]);
+      ++nruns;
+      rb = re;
+    }
+    TS_ASSERT_EQUALS(nruns, 3);
+
+    // the word scanner visits every set bit once
+    atomic<size_t> counter(0);
+    dense_bitset::word_scanner scanner(c, counter);
+    size_t block_start = 0, word = 0, nbits = 0;
+    while (scanner.next_word(block_start, word)) {
+      for (size_t i = 0; i < 8 * sizeof(size_t); ++i) {
+        if (word & (size_t(1) << i)) {
+          TS_ASSERT(c.get(block_start + i));
+          ++nbits;
+        }
+      }
+    }
+    TS_ASSERT_EQUALS(nbits, c.popcount());
+  }
+
+
   void test_fixeddensebitset(void) {
     fixed_dense_bitset<100> d;
     size_t probelocations[7] = {0, 10, 12, 50, 66, 81, 99};
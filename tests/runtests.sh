@@ -247,6 +247,33 @@ else
 fi
 echo
 
+echo "GraphLab graph analytics toolkit"| tee -a $stdoutfname
+if [ -f ../toolkits/graph_analytics/sssp ]; then
+  pushd . > /dev/null
+  cd ../toolkits/graph_analytics
+  echo "---------SSSP-------------" >> $stdoutfname
+  echo "********************TEST1************************" >> $stdoutfname
+  ./sssp --powerlaw=5000 --delta_stepping=true --delta=3 --check=true >> $stdoutfname 2>& 1
+  if [ $? -eq 0 ]; then
+     echo "PASS TEST 1 (Delta-stepping, light edges)"| tee -a $stdoutfname
+  else
+     somefailed=1
+     echo "FAIL --delta=3 (Delta-stepping, light edges)"| tee -a $stdoutfname
+  fi
+  echo "********************TEST2************************" >> $stdoutfname
+  ./sssp --powerlaw=5000 --delta_stepping=true --delta=0.5 --check=true >> $stdoutfname 2>& 1
+  if [ $? -eq 0 ]; then
+     echo "PASS TEST 2 (Delta-stepping, heavy edges)"| tee -a $stdoutfname
+  else
+     somefailed=1
+     echo "FAIL --delta=0.5 (Delta-stepping, heavy edges)"| tee -a $stdoutfname
+  fi
+  popd > /dev/null
+else
+  echo "Graph analytics toolkit not found. "| tee -a $stdoutfname
+fi
+echo
+
 
   if [ $somefailed == 1 ]; then
      echo "**** FAILURE LOG **************" >> $stdoutfname
@@ -26,6 +26,7 @@
 #include <map>
 #include <string>
 #include <cstring>
+#include <sstream>
 
 #include <cxxtest/TestSuite.h>
 
@@ -36,6 +37,7 @@
 
 #include <graphlab/util/generics/any.hpp>
 #include <graphlab/serialization/serialization_includes.hpp>
+#include <graphlab/graph/mirror_data.hpp>
 
 
 using namespace graphlab;
@@ -76,6 +78,17 @@ struct pod_class_2 {
 }; 
 SERIALIZABLE_POD(pod_class_2);
 
+// only "small" is sent to mirrors
+struct split_vertex_data: public graphlab::HAS_MIRROR_DATA {
+  int small;
+  std::vector<int> large;
+  split_vertex_data() : small(0) { }
+  void save(oarchive& oarc) const { oarc << small << large; }
+  void load(iarchive& iarc) { iarc >> small >> large; }
+  void save_mirror(oarchive& oarc) const { oarc << small; }
+  void load_mirror(iarchive& iarc) { iarc >> small; }
+};
+
 
 class SerializeTestSuite : public CxxTest::TestSuite {
 public:
@@ -414,5 +427,26 @@ public:
         TS_ASSERT_EQUALS(p1[i].x, p2[i].x);
     }
   }
-};
 
+  void test_mirror_data(void) {
+    split_vertex_data master;
+    master.small = 42;
+    master.large.resize(1000, 1);
+    std::vector<graphlab::mirror_data_record<split_vertex_data> > sent, recv;
+    sent.push_back(graphlab::mirror_data_record<split_vertex_data>(7, master));
+    std::stringstream strm;
+    oarchive oarc(strm);
+    oarc << sent;
+    iarchive iarc(strm);
+    iarc >> recv;
+    TS_ASSERT_EQUALS(recv.size(), 1);
+    TS_ASSERT_EQUALS(recv[0].vid, 7);
+    // the large part is neither sent nor overwritten
+    TS_ASSERT(strm.str().size() < 100);
+    split_vertex_data mirror;
+    mirror.large.push_back(3);
+    recv[0].apply(mirror);
+    TS_ASSERT_EQUALS(mirror.small, 42);
+    TS_ASSERT_EQUALS(mirror.large.size(), 1);
+  }
+};
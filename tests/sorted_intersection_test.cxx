@@ -0,0 +1,66 @@
+/*  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#include <vector>
+#include <set>
+#include <algorithm>
+#include <iterator>
+#include <cstdlib>
+#include <cxxtest/TestSuite.h>
+#include <graphlab/util/sorted_intersection.hpp>
+using namespace graphlab;
+
+struct collect_intersection {
+  std::vector<uint32_t> values;
+  void operator()(uint32_t x) { values.push_back(x); }
+};
+
+class SortedIntersectionTestSuite : public CxxTest::TestSuite {
+public:
+  void test_random_intersections() {
+    srand(1);
+    for (size_t t = 0; t < 2000; ++t) {
+      std::set<uint32_t> sa, sb;
+      size_t na = rand() % 100;
+      // every seventh pair is skewed to exercise galloping
+      size_t nb = rand() % (t % 7 == 0 ? 5000 : 100);
+      uint32_t range = 1 + rand() % 400;
+      for (size_t i = 0; i < na; ++i) sa.insert(rand() % range);
+      for (size_t i = 0; i < nb; ++i) sb.insert(rand() % range);
+      std::vector<uint32_t> a(sa.begin(), sa.end()), b(sb.begin(), sb.end());
+      std::vector<uint32_t> expected;
+      std::set_intersection(a.begin(), a.end(), b.begin(), b.end(),
+                            std::back_inserter(expected));
+
+      TS_ASSERT_EQUALS(sorted_intersection::intersection_size(
+          a.data(), a.size(), b.data(), b.size()), expected.size());
+      std::vector<uint64_t> a64(a.begin(), a.end()), b64(b.begin(), b.end());
+      TS_ASSERT_EQUALS(sorted_intersection::intersection_size(
+          a64.data(), a64.size(), b64.data(), b64.size()), expected.size());
+      collect_intersection c;
+      sorted_intersection::for_each_intersection(a.data(), a.size(),
+                                                 b.data(), b.size(), c);
+      TS_ASSERT(c.values == expected);
+    }
+  }
+};
@@ -27,6 +27,8 @@
 
 // #include <cxxtest/TestSuite.h>
 
+#include <boost/filesystem.hpp>
+
 #include <graphlab.hpp>
 
 typedef graphlab::distributed_graph<int,int> graph_type;
@@ -318,6 +320,155 @@ void test_count_aggregators(graphlab::distributed_control& dc,
 
 
 
+class checkpointed_sum :
+  public graphlab::ivertex_program<graph_type, int, int>,
+  public graphlab::IS_POD_TYPE {
+  int message_value;
+public:
+  void init(icontext_type& context, const vertex_type& vertex,
+            const message_type& msg) {
+    message_value = msg;
+  }
+  edge_dir_type
+  gather_edges(icontext_type& context, const vertex_type& vertex) const {
+    return graphlab::NO_EDGES;
+  }
+  void apply(icontext_type& context, vertex_type& vertex,
+             const gather_type& total) {
+    vertex.data() += message_value;
+    context.signal(vertex, 0);
+  }
+  edge_dir_type
+  scatter_edges(icontext_type& context, const vertex_type& vertex) const {
+    return graphlab::OUT_EDGES;
+  }
+  void scatter(icontext_type& context, const vertex_type& vertex,
+               edge_type& edge) const {
+    edge.data() += message_value;
+    context.signal(edge.target(), 1);
+  }
+}; // end of checkpointed_sum
+
+void set_vertex_data(graph_type::vertex_type& vertex, int value) {
+  vertex.data() = value;
+}
+
+size_t sum_vertex_data(const graph_type::vertex_type& vertex) {
+  return vertex.data();
+}
+
+void set_edge_data(graph_type::edge_type& edge, int value) {
+  edge.data() = value;
+}
+
+size_t sum_edge_data(const graph_type::edge_type& edge) {
+  return edge.data();
+}
+
+void test_checkpoint(graphlab::distributed_control& dc,
+                     graphlab::command_line_options& clopts,
+                     graph_type& graph) {
+  std::cout << "Testing checkpoints" << std::endl;
+  typedef graphlab::synchronous_engine<checkpointed_sum> engine_type;
+  using namespace boost::filesystem;
+  const path ph = temp_directory_path() / unique_path();
+  ASSERT_TRUE(create_directory(ph));
+  const std::string prefix = (ph / "checkpoint_test").string();
+  // reference run without interruption
+  graph.transform_vertices(boost::bind(set_vertex_data, _1, 0));
+  graph.transform_edges(boost::bind(set_edge_data, _1, 0));
+  graphlab::graphlab_options opts = clopts;
+  opts.engine_args.set_option("max_iterations", 6);
+  {
+    engine_type engine(dc, graph, opts);
+    engine.signal_all();
+    engine.start();
+  }
+  size_t expected = graph.map_reduce_vertices<size_t>(sum_vertex_data);
+  size_t expected_edges = graph.map_reduce_edges<size_t>(sum_edge_data);
+
+  // interrupted run checkpointing every 2 iterations
+  graph.transform_vertices(boost::bind(set_vertex_data, _1, 0));
+  graph.transform_edges(boost::bind(set_edge_data, _1, 0));
+  opts.engine_args.set_option("max_iterations", 4);
+  opts.engine_args.set_option("checkpoint_interval", 2);
+  opts.engine_args.set_option("checkpoint_path", prefix);
+  {
+    engine_type engine(dc, graph, opts);
+    engine.signal_all();
+    engine.start();
+    ASSERT_EQ(engine.iteration(), 4);
+  }
+
+  // wipe the graph and resume
+  graph.transform_vertices(boost::bind(set_vertex_data, _1, -100));
+  graph.transform_edges(boost::bind(set_edge_data, _1, -100));
+  opts.engine_args.set_option("max_iterations", 6);
+  opts.engine_args.set_option("resume_from", prefix);
+  {
+    engine_type engine(dc, graph, opts);
+    engine.start();
+    ASSERT_EQ(engine.iteration(), 6);
+  }
+  ASSERT_EQ(graph.map_reduce_vertices<size_t>(sum_vertex_data), expected);
+  ASSERT_EQ(graph.map_reduce_edges<size_t>(sum_edge_data), expected_edges);
+  dc.barrier();
+  remove_all(ph);
+  std::cout << "Finished" << std::endl;
+}
+
+
+
+
+class mark_signaled :
+  public graphlab::ivertex_program<graph_type, graphlab::empty>,
+  public graphlab::IS_POD_TYPE {
+public:
+  edge_dir_type
+  gather_edges(icontext_type& context, const vertex_type& vertex) const {
+    return graphlab::NO_EDGES;
+  }
+  void apply(icontext_type& context, vertex_type& vertex,
+             const gather_type& total) {
+    vertex.data() += 1;
+  }
+  edge_dir_type
+  scatter_edges(icontext_type& context, const vertex_type& vertex) const {
+    return graphlab::NO_EDGES;
+  }
+}; // end of mark_signaled
+
+void test_signal_vids(graphlab::distributed_control& dc,
+                      graphlab::command_line_options& clopts,
+                      graph_type& graph) {
+  std::cout << "Testing signal_vids" << std::endl;
+  typedef graphlab::synchronous_engine<mark_signaled> engine_type;
+  std::vector<graphlab::vertex_id_type> vids;
+  vids.push_back(1); vids.push_back(5); vids.push_back(17);
+  vids.push_back(4242);
+  graph.transform_vertices(boost::bind(set_vertex_data, _1, 0));
+  {
+    // the list is only known to machine 0 and must be routed
+    engine_type engine(dc, graph, clopts);
+    if (dc.procid() == 0) engine.signal_vids(vids);
+    else engine.signal_vids(std::vector<graphlab::vertex_id_type>());
+    engine.start();
+  }
+  ASSERT_EQ(graph.map_reduce_vertices<size_t>(sum_vertex_data), vids.size());
+  {
+    // every machine has the list
+    engine_type engine(dc, graph, clopts);
+    engine.signal_vids(vids, graphlab::empty(), true);
+    engine.start();
+  }
+  ASSERT_EQ(graph.map_reduce_vertices<size_t>(sum_vertex_data),
+            2 * vids.size());
+  std::cout << "Finished" << std::endl;
+}
+
+
+
+
 int main(int argc, char** argv) {
   ///! Initialize control plain using mpi
   graphlab::mpi_tools::init(argc, argv);
@@ -336,6 +487,8 @@ int main(int argc, char** argv) {
   test_all_neighbors(dc, clopts, graph);
   test_messages(dc, clopts, graph);
   test_count_aggregators(dc, clopts, graph);
+  test_checkpoint(dc, clopts, graph);
+  test_signal_vids(dc, clopts, graph);
 
   graphlab::mpi_tools::finalize();
 } // end of main
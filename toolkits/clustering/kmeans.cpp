@@ -47,7 +47,11 @@
 #include <vector>
 #include <map>
 #include <iostream>
+#include <cmath>
 #include <stdlib.h>
+#if defined(__AVX__) || defined(__SSE__)
+#include <immintrin.h>
+#endif
 
 #include <graphlab.hpp>
 
@@ -55,6 +59,29 @@
 size_t NUM_CLUSTERS = 0;
 bool IS_SPARSE = false;
 
+/*
+ * Dense data only: the centers as a contiguous NUM_CLUSTERS x DIMENSION
+ * matrix of floats for the distance kernels, whether each center is in
+ * use, and for Hamerly's bounds how far each center moved in the last
+ * update and half the distance to its closest other center.
+ */
+size_t DIMENSION = 0;
+std::vector<float> CENTER_MATRIX;
+std::vector<unsigned char> CENTER_VALID;
+std::vector<float> CENTER_SHIFT;
+std::vector<float> CENTER_HALF_GAP;
+// the largest shift, its cluster, and the largest shift of any other cluster
+float MAX_SHIFT = 0;
+size_t MAX_SHIFT_CLUSTER = 0;
+float SECOND_MAX_SHIFT = 0;
+
+// Mini-batch mode: the probability that a point is in a batch
+double BATCH_PROB = 1;
+
+// k-means|| seeding: points are sampled with probability
+// min(1, SAMPLE_SCALE * best_distance)
+double SAMPLE_SCALE = 0;
+
 struct cluster {
   cluster(): count(0), changed(false) { }
   std::vector<double> center;
@@ -82,12 +109,22 @@ struct vertex_data{
   size_t best_cluster;
   double best_distance;
   bool changed;
+  // a lower bound on the (not squared) distance to the second closest center
+  float lower_bound;
+  // whether the point is in the current mini-batch
+  bool in_batch;
+
+  vertex_data() : best_cluster(-1),
+                  best_distance(std::numeric_limits<double>::infinity()),
+                  changed(false), lower_bound(0), in_batch(false) { }
 
   void save(graphlab::oarchive& oarc) const {
-    oarc << point << best_cluster << best_distance << changed << point_sparse;
+    oarc << point << best_cluster << best_distance << changed << point_sparse
+         << lower_bound << in_batch;
   }
   void load(graphlab::iarchive& iarc) {
-    iarc >> point >> best_cluster >> best_distance >> changed >> point_sparse;
+    iarc >> point >> best_cluster >> best_distance >> changed >> point_sparse
+         >> lower_bound >> in_batch;
   }
 };
 
@@ -224,6 +261,109 @@ std::map<size_t, double>& scale_vector(std::map<size_t, double>& a, double d) {
 }
 
 
+// squared distance between two float vectors of length n
+inline float sqr_distance_float(const float* a, const float* b, size_t n) {
+  size_t i = 0;
+  float total = 0;
+#if defined(__AVX__)
+  __m256 acc = _mm256_setzero_ps();
+  for (; i + 8 <= n; i += 8) {
+    const __m256 d = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+    acc = _mm256_add_ps(acc, _mm256_mul_ps(d, d));
+  }
+  float lanes[8];
+  _mm256_storeu_ps(lanes, acc);
+  for (size_t j = 0; j < 8; ++j) total += lanes[j];
+#elif defined(__SSE__)
+  __m128 acc = _mm_setzero_ps();
+  for (; i + 4 <= n; i += 4) {
+    const __m128 d = _mm_sub_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i));
+    acc = _mm_add_ps(acc, _mm_mul_ps(d, d));
+  }
+  float lanes[4];
+  _mm_storeu_ps(lanes, acc);
+  for (size_t j = 0; j < 4; ++j) total += lanes[j];
+#endif
+  for (; i < n; ++i) {
+    const float d = a[i] - b[i];
+    total += d * d;
+  }
+  return total;
+}
+
+// helper function to convert a point for the float kernels
+inline void to_float(const std::vector<double>& a, std::vector<float>& out) {
+  out.resize(a.size());
+  for (size_t i = 0;i < a.size(); ++i) out[i] = a[i];
+}
+
+// finds the closest and second closest rows of a matrix to x,
+// returning squared distances
+inline void nearest_rows(const float* x, const float* matrix,
+                         const unsigned char* valid, size_t nrows,
+                         size_t& best, float& best_d, float& second_d) {
+  best = (size_t)(-1);
+  best_d = second_d = std::numeric_limits<float>::infinity();
+  for (size_t i = 0;i < nrows; ++i) {
+    if (valid != NULL && !valid[i]) continue;
+    const float d = sqr_distance_float(x, matrix + i * DIMENSION, DIMENSION);
+    if (d < best_d) {
+      second_d = best_d;
+      best_d = d;
+      best = i;
+    } else if (d < second_d) {
+      second_d = d;
+    }
+  }
+}
+
+/*
+ * Copies CLUSTERS into CENTER_MATRIX and computes the center shifts and
+ * half gaps used by the bounds. Must be called on every machine after
+ * CLUSTERS is modified.
+ */
+void update_center_matrix() {
+  std::vector<float> old_matrix;
+  std::vector<unsigned char> old_valid;
+  old_matrix.swap(CENTER_MATRIX);
+  old_valid.swap(CENTER_VALID);
+  CENTER_MATRIX.assign(NUM_CLUSTERS * DIMENSION, 0);
+  CENTER_VALID.assign(NUM_CLUSTERS, 0);
+  CENTER_SHIFT.assign(NUM_CLUSTERS, 0);
+  CENTER_HALF_GAP.assign(NUM_CLUSTERS, std::numeric_limits<float>::infinity());
+  MAX_SHIFT = SECOND_MAX_SHIFT = 0;
+  MAX_SHIFT_CLUSTER = 0;
+  for (size_t i = 0;i < NUM_CLUSTERS; ++i) {
+    if (CLUSTERS[i].center.size() != DIMENSION) continue;
+    CENTER_VALID[i] = 1;
+    float* row = &CENTER_MATRIX[i * DIMENSION];
+    for (size_t j = 0;j < DIMENSION; ++j) row[j] = CLUSTERS[i].center[j];
+    if (!old_valid.empty() && old_valid[i]) {
+      CENTER_SHIFT[i] = std::sqrt(sqr_distance_float(row, &old_matrix[i * DIMENSION],
+                                                     DIMENSION));
+    }
+    if (CENTER_SHIFT[i] > MAX_SHIFT) {
+      SECOND_MAX_SHIFT = MAX_SHIFT;
+      MAX_SHIFT = CENTER_SHIFT[i];
+      MAX_SHIFT_CLUSTER = i;
+    } else if (CENTER_SHIFT[i] > SECOND_MAX_SHIFT) {
+      SECOND_MAX_SHIFT = CENTER_SHIFT[i];
+    }
+  }
+  for (size_t i = 0;i < NUM_CLUSTERS; ++i) {
+    if (!CENTER_VALID[i]) continue;
+    for (size_t j = i + 1;j < NUM_CLUSTERS; ++j) {
+      if (!CENTER_VALID[j]) continue;
+      const float half_gap = std::sqrt(sqr_distance_float(&CENTER_MATRIX[i * DIMENSION],
+                                                          &CENTER_MATRIX[j * DIMENSION],
+                                                          DIMENSION)) / 2;
+      CENTER_HALF_GAP[i] = std::min(CENTER_HALF_GAP[i], half_gap);
+      CENTER_HALF_GAP[j] = std::min(CENTER_HALF_GAP[j], half_gap);
+    }
+  }
+}
+
+
 typedef graphlab::distributed_graph<vertex_data, edge_data> graph_type;
 
 graphlab::atomic<graphlab::vertex_id_type> NEXT_VID;
@@ -559,6 +699,191 @@ void kmeans_iteration(graph_type::vertex_type& v) {
   v.data().changed = (prev_asg != v.data().best_cluster);
 }
 
+
+/*
+ * Assigns a dense point to its closest center using CENTER_MATRIX and
+ * resets its lower bound.
+ */
+void assign_nearest(graph_type::vertex_type& v) {
+  vertex_data& vd = v.data();
+  const size_t prev_asg = vd.best_cluster;
+  std::vector<float> x;
+  to_float(vd.point, x);
+  size_t best;
+  float best_d, second_d;
+  nearest_rows(&x[0], &CENTER_MATRIX[0], &CENTER_VALID[0], NUM_CLUSTERS,
+               best, best_d, second_d);
+  vd.best_cluster = best;
+  vd.best_distance = best_d;
+  vd.lower_bound = std::sqrt(second_d);
+  vd.changed = (prev_asg != best);
+}
+
+/*
+ * The k-means iteration for dense points with Hamerly's bounds.
+ *
+ * The distance to the assigned center is always recomputed. The
+ * lower bound on the distance to every other center is decreased by
+ * how far the centers moved; if the assigned center is closer than
+ * the bound, or closer than half the distance to its nearest other
+ * center, it is still the closest and the other centers are skipped.
+ */
+void kmeans_iteration_bounded(graph_type::vertex_type& v) {
+  vertex_data& vd = v.data();
+  const size_t a = vd.best_cluster;
+  if (a == (size_t)(-1) || !CENTER_VALID[a]) {
+    assign_nearest(v);
+    return;
+  }
+  const float shift = (a == MAX_SHIFT_CLUSTER) ? SECOND_MAX_SHIFT : MAX_SHIFT;
+  vd.lower_bound = std::max(vd.lower_bound - shift, 0.0f);
+  std::vector<float> x;
+  to_float(vd.point, x);
+  const float d = sqr_distance_float(&x[0], &CENTER_MATRIX[a * DIMENSION],
+                                     DIMENSION);
+  if (std::sqrt(d) <= std::max(vd.lower_bound, CENTER_HALF_GAP[a])) {
+    vd.best_distance = d;
+    vd.changed = false;
+  } else {
+    assign_nearest(v);
+  }
+}
+
+/*
+ * Mini-batch k-means: draws the point into the batch with probability
+ * BATCH_PROB and assigns it to its closest center if it is.
+ */
+void minibatch_assignment(graph_type::vertex_type& v) {
+  v.data().in_batch = graphlab::random::rand01() < BATCH_PROB;
+  if (v.data().in_batch) assign_nearest(v);
+}
+
+
+/*
+ * The candidate centers of k-means|| seeding (Bahmani et al. 2012)
+ * as a contiguous matrix. CANDIDATE_BEGIN is the first candidate added
+ * in the last round.
+ */
+std::vector<float> CANDIDATE_MATRIX;
+size_t CANDIDATE_BEGIN = 0;
+
+/*
+ * Updates the distance of a point to its closest candidate with the
+ * candidates of the last round. best_cluster holds the candidate.
+ */
+void candidate_distance(graph_type::vertex_type& v) {
+  vertex_data& vd = v.data();
+  std::vector<float> x;
+  to_float(vd.point, x);
+  const size_t ncandidates = CANDIDATE_MATRIX.size() / DIMENSION;
+  for (size_t i = CANDIDATE_BEGIN;i < ncandidates; ++i) {
+    const double d = sqr_distance_float(&x[0], &CANDIDATE_MATRIX[i * DIMENSION],
+                                        DIMENSION);
+    if (d < vd.best_distance) {
+      vd.best_distance = d;
+      vd.best_cluster = i;
+    }
+  }
+}
+
+double get_best_distance(const graph_type::vertex_type& v) {
+  return v.data().best_distance;
+}
+
+/*
+ * Samples each point independently with probability proportional to
+ * its distance to the closest candidate (one round of k-means||).
+ */
+struct candidate_sample_reducer {
+  std::vector<std::vector<double> > points;
+
+  static candidate_sample_reducer sample(const graph_type::vertex_type& v) {
+    candidate_sample_reducer r;
+    if (graphlab::random::rand01() < SAMPLE_SCALE * v.data().best_distance) {
+      r.points.push_back(v.data().point);
+    }
+    return r;
+  }
+
+  candidate_sample_reducer& operator+=(const candidate_sample_reducer& other) {
+    points.insert(points.end(), other.points.begin(), other.points.end());
+    return *this;
+  }
+
+  void save(graphlab::oarchive& oarc) const { oarc << points; }
+  void load(graphlab::iarchive& iarc) { iarc >> points; }
+};
+
+/*
+ * Counts the points closest to each candidate. A value made from one
+ * point only stores its candidate so that mapping does not allocate
+ * a vector of all the candidates.
+ */
+struct candidate_weight_reducer {
+  std::vector<double> weights;
+  size_t single;
+
+  candidate_weight_reducer() : single(-1) { }
+
+  static candidate_weight_reducer get_weight(const graph_type::vertex_type& v) {
+    candidate_weight_reducer r;
+    r.single = v.data().best_cluster;
+    return r;
+  }
+
+  void expand() {
+    if (weights.empty()) weights.resize(CANDIDATE_MATRIX.size() / DIMENSION, 0);
+    if (single != (size_t)(-1)) weights[single] += 1;
+    single = -1;
+  }
+
+  candidate_weight_reducer& operator+=(const candidate_weight_reducer& other) {
+    expand();
+    if (other.single != (size_t)(-1)) weights[other.single] += 1;
+    for (size_t i = 0;i < other.weights.size(); ++i) weights[i] += other.weights[i];
+    return *this;
+  }
+
+  void save(graphlab::oarchive& oarc) const { oarc << weights << single; }
+  void load(graphlab::iarchive& iarc) { iarc >> weights >> single; }
+};
+
+/*
+ * Weighted k-means++ over the candidates: returns the indices of the
+ * NUM_CLUSTERS chosen candidates.
+ */
+std::vector<size_t> recluster_candidates(const std::vector<double>& weights) {
+  const size_t ncandidates = weights.size();
+  std::vector<double> dist(ncandidates, std::numeric_limits<double>::infinity());
+  std::vector<size_t> chosen;
+  while (chosen.size() < NUM_CLUSTERS) {
+    double total = 0;
+    for (size_t i = 0;i < ncandidates; ++i) {
+      total += weights[i] * (chosen.empty() ? 1 : dist[i]);
+    }
+    // with no weight left (fewer distinct candidates than clusters)
+    // a uniform candidate is repeated
+    size_t pick = graphlab::random::fast_uniform<size_t>(0, ncandidates - 1);
+    if (total > 0) {
+      double r = graphlab::random::rand01() * total;
+      for (size_t i = 0;i < ncandidates; ++i) {
+        const double p = weights[i] * (chosen.empty() ? 1 : dist[i]);
+        if (p <= 0) continue;
+        pick = i;
+        r -= p;
+        if (r <= 0) break;
+      }
+    }
+    chosen.push_back(pick);
+    const float* c = &CANDIDATE_MATRIX[pick * DIMENSION];
+    for (size_t i = 0;i < ncandidates; ++i) {
+      dist[i] = std::min(dist[i], (double)sqr_distance_float
+                         (&CANDIDATE_MATRIX[i * DIMENSION], c, DIMENSION));
+    }
+  }
+  return chosen;
+}
+
 //gathered information
 //used when edge weight file is given
 struct neighbor_info {
@@ -666,50 +991,80 @@ public:
  * computes new cluster centers
  * Also accumulates a counter counting the number of vertices which
  * assignments changed.
+ *
+ * A value made from a single point only stores the cluster of that
+ * point (in single) so that mapping a point does not allocate all
+ * NUM_CLUSTERS clusters; expand() turns it into the full vector.
  */
 struct cluster_center_reducer {
   std::vector<cluster> new_clusters;
+  size_t single;
   size_t num_changed;
   double cost;
 
-  cluster_center_reducer():new_clusters(NUM_CLUSTERS), num_changed(0), cost(0) { }
+  cluster_center_reducer():single(-1), num_changed(0), cost(0) { }
 
   static cluster_center_reducer get_center(const graph_type::vertex_type& v) {
     cluster_center_reducer cc;
     ASSERT_NE(v.data().best_cluster, (size_t)(-1));
 
+    cc.single = v.data().best_cluster;
+    cc.new_clusters.resize(1);
     if(IS_SPARSE == true)
-      cc.new_clusters[v.data().best_cluster].center_sparse = v.data().point_sparse;
+      cc.new_clusters[0].center_sparse = v.data().point_sparse;
     else
-      cc.new_clusters[v.data().best_cluster].center = v.data().point;
-    cc.new_clusters[v.data().best_cluster].count = 1;
+      cc.new_clusters[0].center = v.data().point;
+    cc.new_clusters[0].count = 1;
     cc.num_changed = v.data().changed;
     cc.cost = v.data().best_distance;
     return cc;
   }
 
-  cluster_center_reducer& operator+=(const cluster_center_reducer& other) {
-    for (size_t i = 0;i < NUM_CLUSTERS; ++i) {
-      if (new_clusters[i].count == 0) new_clusters[i] = other.new_clusters[i];
-      else if (other.new_clusters[i].count > 0) {
-        if(IS_SPARSE == true)
-          plus_equal_vector(new_clusters[i].center_sparse, other.new_clusters[i].center_sparse);
-        else
-          plus_equal_vector(new_clusters[i].center, other.new_clusters[i].center);
-        new_clusters[i].count += other.new_clusters[i].count;
-      }
+  // the points of the current mini-batch only
+  static cluster_center_reducer get_batch_center(const graph_type::vertex_type& v) {
+    if (!v.data().in_batch) return cluster_center_reducer();
+    return get_center(v);
+  }
+
+  // make new_clusters hold all NUM_CLUSTERS clusters
+  void expand() {
+    if (single == (size_t)(-1) && new_clusters.size() == NUM_CLUSTERS) return;
+    std::vector<cluster> all(NUM_CLUSTERS);
+    if (single != (size_t)(-1)) all[single] = new_clusters[0];
+    new_clusters.swap(all);
+    single = -1;
+  }
+
+  void add(size_t i, const cluster& other) {
+    if (other.count == 0) return;
+    if (new_clusters[i].count == 0) new_clusters[i] = other;
+    else {
+      if(IS_SPARSE == true)
+        plus_equal_vector(new_clusters[i].center_sparse, other.center_sparse);
+      else
+        plus_equal_vector(new_clusters[i].center, other.center);
+      new_clusters[i].count += other.count;
     }
+  }
+
+  cluster_center_reducer& operator+=(const cluster_center_reducer& other) {
     num_changed += other.num_changed;
     cost += other.cost;
+    if (other.new_clusters.empty()) return *this;
+    expand();
+    if (other.single != (size_t)(-1)) add(other.single, other.new_clusters[0]);
+    else {
+      for (size_t i = 0;i < NUM_CLUSTERS; ++i) add(i, other.new_clusters[i]);
+    }
     return *this;
   }
 
   void save(graphlab::oarchive& oarc) const {
-    oarc << new_clusters << num_changed <<cost;
+    oarc << new_clusters << single << num_changed <<cost;
   }
 
   void load(graphlab::iarchive& iarc) {
-    iarc >> new_clusters >> num_changed >> cost;
+    iarc >> new_clusters >> single >> num_changed >> cost;
   }
 };
 
@@ -773,6 +1128,9 @@ int main(int argc, char** argv) {
   std::string outdata_file;
   std::string edgedata_file;
   size_t MAX_ITERATION = 0;
+  size_t BATCH_SIZE = 0;
+  size_t INIT_ROUNDS = 5;
+  double OVERSAMPLING = 2;
   bool use_id = false;
   clopts.attach_option("data", datafile,
                        "Input file. Each line holds a white-space or comma separated numeric vector");
@@ -803,6 +1161,16 @@ int main(int argc, char** argv) {
                        "[reward]. This mode must be used with --id option.");
   clopts.attach_option("max-iteration", MAX_ITERATION,
                        "The max number of iterations");
+  clopts.attach_option("minibatch", BATCH_SIZE,
+                       "If set, runs mini-batch k-means on random batches of "
+                       "about this many points for --max-iteration iterations "
+                       "(default 100). Dense data without pairwise rewards only.");
+  clopts.attach_option("init-rounds", INIT_ROUNDS,
+                       "The number of k-means|| sampling rounds used to seed "
+                       "dense data.");
+  clopts.attach_option("oversampling", OVERSAMPLING,
+                       "The expected number of candidates sampled per k-means|| "
+                       "round, as a multiple of the number of clusters.");
 
   if(!clopts.parse(argc, argv)) return EXIT_FAILURE;
   if (datafile == "") {
@@ -864,92 +1232,161 @@ int main(int argc, char** argv) {
                 << "! K-means cannot proceed!" << std::endl;
       return EXIT_FAILURE;
     }
-    // allocate clusters
-    for (size_t i = 0;i < NUM_CLUSTERS; ++i) {
-      CLUSTERS[i].center.resize(max_p_size);
-    }
+    DIMENSION = max_p_size;
   }
 
-  dc.cout() << "Initializing using Kmeans++\n";
-  // ok. perform kmeans++ initialization
-  for (KMEANS_INITIALIZATION = 0;
-       KMEANS_INITIALIZATION < NUM_CLUSTERS;
-       ++KMEANS_INITIALIZATION) {
-
-    if(IS_SPARSE == true){
+  if(IS_SPARSE == true){
+    dc.cout() << "Initializing using Kmeans++\n";
+    // ok. perform kmeans++ initialization
+    for (KMEANS_INITIALIZATION = 0;
+         KMEANS_INITIALIZATION < NUM_CLUSTERS;
+         ++KMEANS_INITIALIZATION) {
       random_sample_reducer_sparse rs = graph.map_reduce_vertices<random_sample_reducer_sparse>
                                         (random_sample_reducer_sparse::get_weight);
       CLUSTERS[KMEANS_INITIALIZATION].center_sparse = rs.vtx;
       graph.transform_vertices(kmeans_pp_initialization_sparse);
-    }else{
-      random_sample_reducer rs = graph.map_reduce_vertices<random_sample_reducer>
-                                        (random_sample_reducer::get_weight);
-      CLUSTERS[KMEANS_INITIALIZATION].center = rs.vtx;
-      graph.transform_vertices(kmeans_pp_initialization);
-    }
-  }
-
-  // "reset" all clusters
-  for (size_t i = 0; i < NUM_CLUSTERS; ++i) CLUSTERS[i].changed = true;
-  // perform Kmeans iteration
-
-  dc.cout() << "Running Kmeans...\n";
-  bool clusters_changed = true;
-  size_t iteration_count = 0;
-  while(clusters_changed) {
-		if(MAX_ITERATION > 0 && iteration_count >= MAX_ITERATION)
-			break;
-
-    cluster_center_reducer cc = graph.map_reduce_vertices<cluster_center_reducer>
-                                    (cluster_center_reducer::get_center);
-    // the first round (iteration_count == 0) is not so meaningful
-    // since I am just recomputing the centers from the output of the KMeans++
-    // initialization
-    if (iteration_count > 0) {
-      dc.cout() << "Kmeans iteration " << iteration_count << ": " <<
-                 "# points with changed assignments = " << cc.num_changed << 
-		 " total cost: " << cc.cost << std::endl;
     }
+  }else{
+    // k-means||: a few rounds each sampling about OVERSAMPLING * NUM_CLUSTERS
+    // candidates with probability proportional to their distance to the
+    // closest candidate, then weighted k-means++ over the candidates.
+    dc.cout() << "Initializing using Kmeans||\n";
+    std::vector<std::vector<double> > candidates;
+    random_sample_reducer rs = graph.map_reduce_vertices<random_sample_reducer>
+                                      (random_sample_reducer::get_weight);
+    candidates.push_back(rs.vtx);
+    CANDIDATE_MATRIX.assign(rs.vtx.begin(), rs.vtx.end());
+    CANDIDATE_BEGIN = 0;
+    graph.transform_vertices(candidate_distance);
+    for (size_t round = 0;
+         round < INIT_ROUNDS || candidates.size() < NUM_CLUSTERS; ++round) {
+      const double cost = graph.map_reduce_vertices<double>(get_best_distance);
+      if (cost <= 0 || round >= 10 * (INIT_ROUNDS + 1)) break;
+      SAMPLE_SCALE = OVERSAMPLING * NUM_CLUSTERS / cost;
+      candidate_sample_reducer cs = graph.map_reduce_vertices<candidate_sample_reducer>
+                                          (candidate_sample_reducer::sample);
+      CANDIDATE_BEGIN = candidates.size();
+      for (size_t i = 0;i < cs.points.size(); ++i) {
+        candidates.push_back(cs.points[i]);
+        CANDIDATE_MATRIX.insert(CANDIDATE_MATRIX.end(),
+                                cs.points[i].begin(), cs.points[i].end());
+      }
+      graph.transform_vertices(candidate_distance);
+      dc.cout() << "Kmeans|| round " << round << ": " << candidates.size()
+                << " candidates, cost " << cost << std::endl;
+    }
+    candidate_weight_reducer cw = graph.map_reduce_vertices<candidate_weight_reducer>
+                                        (candidate_weight_reducer::get_weight);
+    cw.expand();
+    std::vector<size_t> chosen;
+    if (dc.procid() == 0) chosen = recluster_candidates(cw.weights);
+    dc.broadcast(chosen, dc.procid() == 0);
     for (size_t i = 0;i < NUM_CLUSTERS; ++i) {
-      double d = cc.new_clusters[i].count;
-      if(IS_SPARSE){
-        if (d > 0) scale_vector(cc.new_clusters[i].center_sparse, 1.0 / d);
-        if (cc.new_clusters[i].count == 0 && CLUSTERS[i].count > 0) {
-          dc.cout() << "Cluster " << i << " lost" << std::endl;
-          CLUSTERS[i].center_sparse.clear();
-          CLUSTERS[i].count = 0;
-          CLUSTERS[i].changed = false;
+      CLUSTERS[i].center = candidates[chosen[i]];
+    }
+    std::vector<float>().swap(CANDIDATE_MATRIX);
+    update_center_matrix();
+    graph.transform_vertices(assign_nearest);
+  }
+
+  if (BATCH_SIZE > 0 && IS_SPARSE == false && edgedata_file.empty()) {
+    // Mini-batch k-means (Sculley 2010): each center moves to the mean
+    // of all the batch points ever assigned to it, so its learning rate
+    // decreases as 1 / count.
+    BATCH_PROB = std::min(1.0, double(BATCH_SIZE) / graph.num_vertices());
+    if (MAX_ITERATION == 0) MAX_ITERATION = 100;
+    dc.cout() << "Running mini-batch Kmeans...\n";
+    for (size_t iteration = 0;iteration < MAX_ITERATION; ++iteration) {
+      graph.transform_vertices(minibatch_assignment);
+      cluster_center_reducer cc = graph.map_reduce_vertices<cluster_center_reducer>
+                                      (cluster_center_reducer::get_batch_center);
+      cc.expand();
+      size_t batch = 0;
+      for (size_t i = 0;i < NUM_CLUSTERS; ++i) {
+        const cluster& update = cc.new_clusters[i];
+        if (update.count == 0) continue;
+        batch += update.count;
+        const double total = CLUSTERS[i].count + update.count;
+        for (size_t j = 0;j < DIMENSION; ++j) {
+          CLUSTERS[i].center[j] =
+            (CLUSTERS[i].count * CLUSTERS[i].center[j] + update.center[j]) / total;
         }
-        else {
-          CLUSTERS[i] = cc.new_clusters[i];
-          CLUSTERS[i].changed = true;
+        CLUSTERS[i].count += update.count;
+      }
+      update_center_matrix();
+      dc.cout() << "Mini-batch iteration " << iteration << ": batch size " << batch
+                << " mean batch cost: " << (batch > 0 ? cc.cost / batch : 0) << std::endl;
+    }
+    graph.transform_vertices(assign_nearest);
+    const double cost = graph.map_reduce_vertices<double>(get_best_distance);
+    dc.cout() << "Final total cost: " << cost << std::endl;
+  } else {
+    // "reset" all clusters
+    for (size_t i = 0; i < NUM_CLUSTERS; ++i) CLUSTERS[i].changed = true;
+    // perform Kmeans iteration
+
+    dc.cout() << "Running Kmeans...\n";
+    bool clusters_changed = true;
+    size_t iteration_count = 0;
+    while(clusters_changed) {
+  		if(MAX_ITERATION > 0 && iteration_count >= MAX_ITERATION)
+  			break;
+
+      cluster_center_reducer cc = graph.map_reduce_vertices<cluster_center_reducer>
+                                      (cluster_center_reducer::get_center);
+      cc.expand();
+      // the first round (iteration_count == 0) is not so meaningful
+      // since I am just recomputing the centers from the output of the KMeans++
+      // initialization
+      if (iteration_count > 0) {
+        dc.cout() << "Kmeans iteration " << iteration_count << ": " <<
+                   "# points with changed assignments = " << cc.num_changed << 
+  		 " total cost: " << cc.cost << std::endl;
+      }
+      for (size_t i = 0;i < NUM_CLUSTERS; ++i) {
+        double d = cc.new_clusters[i].count;
+        if(IS_SPARSE){
+          if (d > 0) scale_vector(cc.new_clusters[i].center_sparse, 1.0 / d);
+          if (cc.new_clusters[i].count == 0 && CLUSTERS[i].count > 0) {
+            dc.cout() << "Cluster " << i << " lost" << std::endl;
+            CLUSTERS[i].center_sparse.clear();
+            CLUSTERS[i].count = 0;
+            CLUSTERS[i].changed = false;
+          }
+          else {
+            CLUSTERS[i] = cc.new_clusters[i];
+            CLUSTERS[i].changed = true;
+          }
+        }else{
+          if (d > 0) scale_vector(cc.new_clusters[i].center, 1.0 / d);
+          if (cc.new_clusters[i].count == 0 && CLUSTERS[i].count > 0) {
+            dc.cout() << "Cluster " << i << " lost" << std::endl;
+            CLUSTERS[i].center.clear();
+            CLUSTERS[i].count = 0;
+            CLUSTERS[i].changed = false;
+          }
+          else {
+            CLUSTERS[i] = cc.new_clusters[i];
+            CLUSTERS[i].changed = true;
+          }
         }
+      }
+      clusters_changed = iteration_count == 0 || cc.num_changed > 0;
+      if(IS_SPARSE == false) update_center_matrix();
+
+      if(edgedata_file.size() > 0){
+        clopts.engine_args.set_option("factorized", true);
+        graphlab::omni_engine<cluster_assignment> engine(dc, graph, "async", clopts);
+        engine.signal_all();
+        engine.start();
+      }else if(IS_SPARSE == true){
+        graph.transform_vertices(kmeans_iteration);
       }else{
-        if (d > 0) scale_vector(cc.new_clusters[i].center, 1.0 / d);
-        if (cc.new_clusters[i].count == 0 && CLUSTERS[i].count > 0) {
-          dc.cout() << "Cluster " << i << " lost" << std::endl;
-          CLUSTERS[i].center.clear();
-          CLUSTERS[i].count = 0;
-          CLUSTERS[i].changed = false;
-        }
-        else {
-          CLUSTERS[i] = cc.new_clusters[i];
-          CLUSTERS[i].changed = true;
-        }
+        graph.transform_vertices(kmeans_iteration_bounded);
       }
-    }
-    clusters_changed = iteration_count == 0 || cc.num_changed > 0;
 
-    if(edgedata_file.size() > 0){
-      clopts.engine_args.set_option("factorized", true);
-      graphlab::omni_engine<cluster_assignment> engine(dc, graph, "async", clopts);
-      engine.signal_all();
-      engine.start();
-    }else{
-      graph.transform_vertices(kmeans_iteration);
+      ++iteration_count;
     }
-
-    ++iteration_count;
   }
 
 
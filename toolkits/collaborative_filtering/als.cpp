@@ -176,7 +176,7 @@ get_other_vertex(graph_type::edge_type& edge,
 
 
 /**
- * \brief The gather type used to construct XtX and Xty needed for the ALS
+ * \brief The gather type used to construct XtX and Xy needed for the ALS
  * update
  *
  * To compute the ALS update we need to compute the sum of 
@@ -186,53 +186,100 @@ get_other_vertex(graph_type::edge_type& edge,
  * \endcode
  * For each of the neighbors of a vertex. 
  *
- * To do this in the Gather-Apply-Scatter model the gather function
- * computes and returns a pair consisting of XtX and Xy which are then
- * added. The gather type represents that tuple and provides the
- * necessary gather_type::operator+= operation.
+ * Rather than adding a rank-1 update of XtX for every edge, the
+ * gather type collects the neighbor factors as the columns of a
+ * contiguous block X (and the observations in y) and only adds the
+ * block to XtX with a single rank-k (SYRK) update once BLOCK_SIZE
+ * columns are collected.  The blocked update runs at close to matrix
+ * multiply speed while the rank-1 updates are memory bound, and no
+ * d x d matrix is built per edge.
  *
+ * A vertex with fewer neighbors than latent dimensions never builds
+ * XtX at all: apply() solves the smaller dual system instead (see
+ * als_vertex_program::apply).
  */
 class gather_type {
 public:
+  /**
+   * \brief The number of neighbor factors collected before they are
+   * added to XtX.
+   */
+  static size_t BLOCK_SIZE;
+
   /**
    * \brief Stores the current sum of nbr.factor.transpose() *
-   * nbr.factor
+   * nbr.factor (upper triangle) for the flushed neighbors
    */
   mat_type XtX;
 
   /**
-   * \brief Stores the current sum of nbr.factor * edge.obs
+   * \brief Stores the current sum of nbr.factor * edge.obs for the
+   * flushed neighbors
    */
   vec_type Xy;
 
+  /** \brief The neighbor factors not yet added, in the first ncols columns */
+  mat_type X;
+
+  /** \brief The observations of the neighbors in X */
+  vec_type y;
+
+  /** \brief The number of columns of X in use */
+  size_t ncols;
+
   /** \brief basic default constructor */
-  gather_type() { }
+  gather_type() : ncols(0) { }
 
   /**
-   * \brief This constructor computes XtX and Xy and stores the result
-   * in XtX and Xy
+   * \brief This constructor stores the factor X as the first column of
+   * the block
    */
-  gather_type(const vec_type& X, const double y) :
-    XtX(X.size(), X.size()), Xy(X.size()) {
-    XtX.triangularView<Eigen::Upper>() = X * X.transpose();
-    Xy = X * y;
+  gather_type(const vec_type& factor, const double obs) :
+    X(factor), y(1), ncols(1) {
+    y(0) = obs;
   } // end of constructor for gather type
 
+  /** \brief True if no neighbor was added */
+  bool empty() const { return Xy.size() == 0 && ncols == 0; }
+
+  /** \brief Adds the collected columns to XtX and Xy */
+  void flush() {
+    if(ncols == 0) return;
+    add_block(XtX, Xy, X.leftCols(ncols), y.head(ncols));
+    ncols = 0;
+  }
+
+  /**
+   * \brief Computes the sums XtX and Xy of all the neighbors without
+   * changing the gather type.
+   */
+  void normal_equations(mat_type& XtX_out, vec_type& Xy_out) const {
+    XtX_out = XtX; Xy_out = Xy;
+    if(ncols > 0) add_block(XtX_out, Xy_out, X.leftCols(ncols), y.head(ncols));
+  }
+
   /** \brief Save the values to a binary archive */
-  void save(graphlab::oarchive& arc) const { arc << XtX << Xy; }
+  void save(graphlab::oarchive& arc) const {
+    arc << XtX << Xy << ncols;
+    if(ncols > 0) {
+      const mat_type used = X.leftCols(ncols);
+      const vec_type used_y = y.head(ncols);
+      arc << used << used_y;
+    }
+  }
 
   /** \brief Read the values from a binary archive */
-  void load(graphlab::iarchive& arc) { arc >> XtX >> Xy; }  
+  void load(graphlab::iarchive& arc) {
+    arc >> XtX >> Xy >> ncols;
+    if(ncols > 0) arc >> X >> y;
+  }
 
   /** 
-   * \brief Computes XtX += other.XtX and Xy += other.Xy updating this
-   * tuples value
+   * \brief Computes XtX += other.XtX and Xy += other.Xy and appends
+   * the columns collected by other, updating this tuples value
    */
   gather_type& operator+=(const gather_type& other) {
-    if(other.Xy.size() == 0) {
-      ASSERT_EQ(other.XtX.rows(), 0);
-      ASSERT_EQ(other.XtX.cols(), 0);
-    } else {
+    if(other.Xy.size() != 0) {
       if(Xy.size() == 0) {
         ASSERT_EQ(XtX.rows(), 0); 
         ASSERT_EQ(XtX.cols(), 0);
@@ -242,11 +289,43 @@ public:
         Xy += other.Xy;
       }
     }
+    if(other.ncols == 0) return *this;
+    if(ncols + other.ncols > BLOCK_SIZE) flush();
+    if(other.ncols >= BLOCK_SIZE) {
+      add_block(XtX, Xy, other.X.leftCols(other.ncols),
+                other.y.head(other.ncols));
+      return *this;
+    }
+    if(size_t(X.cols()) < ncols + other.ncols) {
+      // grow the block geometrically up to BLOCK_SIZE columns
+      const size_t capacity = std::min(BLOCK_SIZE,
+                                       std::max(2 * size_t(X.cols()),
+                                                ncols + other.ncols));
+      X.conservativeResize(other.X.rows(), capacity);
+      y.conservativeResize(capacity);
+    }
+    X.middleCols(ncols, other.ncols) = other.X.leftCols(other.ncols);
+    y.segment(ncols, other.ncols) = other.y.head(other.ncols);
+    ncols += other.ncols;
     return *this;
   } // end of operator+=
 
+private:
+  /** \brief XtX += X * X' (upper triangle) and Xy += X * y */
+  template <typename Block, typename Segment>
+  static void add_block(mat_type& XtX, vec_type& Xy,
+                        const Block& X, const Segment& y) {
+    if(Xy.size() == 0) {
+      XtX = mat_type::Zero(X.rows(), X.rows());
+      Xy = vec_type::Zero(X.rows());
+    }
+    XtX.selfadjointView<Eigen::Upper>().rankUpdate(X);
+    Xy.noalias() += X * y;
+  }
 }; // end of gather type
 
+size_t gather_type::BLOCK_SIZE = 64;
+
 
 
 /**
@@ -306,27 +385,54 @@ public:
     } else return gather_type();
   } // end of gather function
 
-  /** apply collects the sum of XtX and Xy */
+  /**
+   * \brief Once the local gather is done the block is added to XtX
+   * unless the dual solve may still be used, so that at most a d x d
+   * matrix is sent to the master.
+   */
+  void post_local_gather(gather_type& sum) const {
+    if(sum.ncols >= vertex_data::NLATENT) sum.flush();
+  } // end of post_local_gather
+
+  /**
+   * \brief apply collects the sum of XtX and Xy and solves for the
+   * new factor.
+   *
+   * With k < d neighbors the d x d system (X X' + reg I) w = X y is
+   * solved through the k x k system (X' X + reg I) a = y as w = X a,
+   * which costs O(k^2 d + k^3) instead of O(k d^2 + d^3).
+   */
   void apply(icontext_type& context, vertex_type& vertex,
              const gather_type& sum) {
     // Get and reset the vertex data
     vertex_data& vdata = vertex.data(); 
     // Determine the number of neighbors.  Each vertex has only in or
     // out edges depending on which side of the graph it is located
-    if(sum.Xy.size() == 0) { vdata.residual = 0; ++vdata.nupdates; return; }
-    mat_type XtX = sum.XtX;
-    vec_type Xy = sum.Xy;
+    if(sum.empty()) { vdata.residual = 0; ++vdata.nupdates; return; }
     // Add regularization
     double regularization = LAMBDA;
     if (REGNORMAL)
       regularization = LAMBDA*vertex.num_out_edges();
-    for(int i = 0; i < XtX.rows(); ++i) 
-      XtX(i,i) += regularization; 
-    // Solve the least squares problem using eigen ----------------------------
     const vec_type old_factor = vdata.factor;
-    vdata.factor = XtX.selfadjointView<Eigen::Upper>().ldlt().solve(Xy);
+    if(sum.Xy.size() == 0 && sum.ncols < vertex_data::NLATENT) {
+      // Solve the dual problem --------------------------------------------
+      const size_t k = sum.ncols;
+      mat_type G = mat_type::Zero(k, k);
+      G.selfadjointView<Eigen::Upper>().rankUpdate(sum.X.leftCols(k).transpose());
+      for(size_t i = 0; i < k; ++i) G(i,i) += regularization;
+      const vec_type a = 
+        G.selfadjointView<Eigen::Upper>().ldlt().solve(sum.y.head(k));
+      vdata.factor = sum.X.leftCols(k) * a;
+    } else {
+      mat_type XtX; vec_type Xy;
+      sum.normal_equations(XtX, Xy);
+      for(int i = 0; i < XtX.rows(); ++i) 
+        XtX(i,i) += regularization; 
+      // Solve the least squares problem using eigen --------------------------
+      vdata.factor = XtX.selfadjointView<Eigen::Upper>().ldlt().solve(Xy);
+    }
     // Compute the residual change in the factor factor -----------------------
-    vdata.residual = (vdata.factor - old_factor).cwiseAbs().sum() / XtX.rows();
+    vdata.residual = (vdata.factor - old_factor).cwiseAbs().sum() / vdata.factor.size();
     ++vdata.nupdates;
   } // end of apply
   
@@ -596,6 +702,8 @@ int main(int argc, char** argv) {
                        "The prefix (folder and filename) to save predictions.");
   clopts.attach_option("engine", exec_type, 
                        "The engine type synchronous or asynchronous");
+  clopts.attach_option("gather_block", gather_type::BLOCK_SIZE,
+                       "The number of neighbor factors added to XtX at once");
   clopts.attach_option("regnormal", als_vertex_program::REGNORMAL, 
                        "regularization type. 1 = weighted according to neighbors num. 0 = no weighting - just lambda");
   
@@ -608,6 +716,11 @@ int main(int argc, char** argv) {
   }
 
 
+  if(gather_type::BLOCK_SIZE == 0) {
+    std::cout << "gather_block must be positive." << std::endl;
+    return EXIT_FAILURE;
+  }
+
   ///! Initialize control plain using mpi
   graphlab::mpi_tools::init(argc, argv);
   graphlab::distributed_control dc;
@@ -338,6 +338,9 @@ struct error_aggregator : public graphlab::IS_POD_TYPE {
     return *this;
   }
   static error_aggregator map(icontext_type& context, const graph_type::edge_type& edge) {
+    return map_edge(edge);
+  }
+  static error_aggregator map_edge(const graph_type::edge_type& edge) {
     error_aggregator agg;
     if (edge.data().role == edge_data::TRAIN){
       agg.train_error = extract_l2_error(edge); agg.ntrain = 1;
@@ -354,17 +357,21 @@ struct error_aggregator : public graphlab::IS_POD_TYPE {
     iter++;
     if (iter%2 == 0)
       return; 
+    print(context.cout(), context.elapsed_seconds(), agg);
+    biassgd_vertex_program::GAMMA *= biassgd_vertex_program::STEP_DEC;
+  }
+
+  static void print(std::ostream& out, double elapsed, const error_aggregator& agg) {
     ASSERT_GT(agg.ntrain, 0);
     const double train_error = std::sqrt(agg.train_error / agg.ntrain);
     assert(!std::isnan(train_error));
-    context.cout() << std::setw(8) << context.elapsed_seconds() << "  " << std::setw(8) << train_error;
+    out << std::setw(8) << elapsed << "  " << std::setw(8) << train_error;
     if(agg.nvalidation > 0) {
       const double validation_error = 
         std::sqrt(agg.validation_error / agg.nvalidation);
-      context.cout() << "   " << std::setw(8) << validation_error; 
+      out << "   " << std::setw(8) << validation_error; 
     }
-    context.cout() << std::endl;
-    biassgd_vertex_program::GAMMA *= biassgd_vertex_program::STEP_DEC;
+    out << std::endl;
   }
 }; // end of error aggregator
 
@@ -540,6 +547,43 @@ bool biassgd_vertex_program::debug = false;
 double biassgd_vertex_program::GLOBAL_MEAN = 0;
 size_t biassgd_vertex_program::NUM_TRAINING_EDGES = 0;
 
+
+#include "hogwild.hpp"
+
+/**
+ * \brief A single lock free bias-SGD step, used by the Hogwild mode.
+ * Applies the same update as biassgd_vertex_program::gather() directly
+ * to both sides of the edge.
+ */
+struct biassgd_hogwild_updater {
+  void operator()(vertex_data& user, vertex_data& item, const edge_data& edge) const {
+    double pred = biassgd_vertex_program::GLOBAL_MEAN + 
+      user.bias + item.bias + user.pvec.dot(item.pvec);
+    pred = std::min(pred, biassgd_vertex_program::MAXVAL);
+    pred = std::max(pred, biassgd_vertex_program::MINVAL); 
+    const double err = pred - edge.obs;
+    const double gamma = biassgd_vertex_program::GAMMA;
+    const double lambda = biassgd_vertex_program::LAMBDA;
+    user.bias -= gamma*(err + lambda*user.bias);
+    item.bias -= gamma*(err + lambda*item.bias);
+    for (int k=0; k< user.pvec.size(); k++){
+      const double u = user.pvec[k], v = item.pvec[k];
+      user.pvec[k] -= gamma*(err*v + lambda*u);
+      item.pvec[k] -= gamma*(err*u + lambda*v);
+    }
+  }
+  /* the latent vector followed by the bias */
+  static vec_type params(const vertex_data& vdata) {
+    vec_type ret(vdata.pvec.size() + 1);
+    ret << vdata.pvec, vdata.bias;
+    return ret;
+  }
+  static void add_params(vertex_data& vdata, const vec_type& delta) {
+    vdata.pvec += delta.head(vdata.pvec.size());
+    vdata.bias += delta[vdata.pvec.size()];
+  }
+};
+
 /**
  * \brief The engine type used by the ALS matrix factorization
  * algorithm.
@@ -575,6 +619,8 @@ int main(int argc, char** argv) {
   std::string predictions;
   size_t interval = 0;
   std::string exec_type = "synchronous";
+  bool hogwild = false;
+  size_t hogwild_syncs = 1;
   clopts.attach_option("matrix", input_dir,
                        "The directory containing the matrix file");
   clopts.add_positional("matrix");
@@ -599,6 +645,10 @@ int main(int argc, char** argv) {
                        "The time in seconds between error reports");
   clopts.attach_option("predictions", predictions,
                        "The prefix (folder and filename) to save predictions.");
+  clopts.attach_option("hogwild", hogwild,
+                       "If true, run lock free Hogwild SGD over the local edges instead of the engine. --max_iter is then the number of epochs");
+  clopts.attach_option("hogwild_syncs", hogwild_syncs,
+                       "Hogwild mode: number of replica synchronizations per epoch");
 
   parse_implicit_command_line(clopts);
 
@@ -651,45 +701,68 @@ dc.cout() << "Finalizing graph." << std::endl;
       << float(graph.num_local_edges())/graph.num_edges()
       << std::endl;
  
-  dc.cout() << "Creating engine" << std::endl;
-  engine_type engine(dc, graph, exec_type, clopts);
-
-  // Add error reporting to the engine
-  const bool success = engine.add_edge_aggregator<error_aggregator>
-    ("error", error_aggregator::map, error_aggregator::finalize) &&
-    engine.aggregate_periodic("error", interval);
-  ASSERT_TRUE(success);
-  
-
   biassgd_vertex_program::GLOBAL_MEAN = graph.map_reduce_edges<double>(calc_global_mean);
   biassgd_vertex_program::NUM_TRAINING_EDGES = graph.map_reduce_edges<size_t>(count_edges);
   biassgd_vertex_program::GLOBAL_MEAN /= biassgd_vertex_program::NUM_TRAINING_EDGES;
   dc.cout() << "Global mean is: " <<biassgd_vertex_program::GLOBAL_MEAN << std::endl;
 
-  // Signal all vertices on the vertices on the left (libersgd) 
-  engine.map_reduce_vertices<graphlab::empty>(biassgd_vertex_program::signal_left);
+  if (hogwild){
+    hogwild_sgd<biassgd_hogwild_updater> hogwild_runner(graph, dc, clopts.get_ncpus());
+    const size_t epochs = biassgd_vertex_program::MAX_UPDATES == size_t(-1) ? 10 : biassgd_vertex_program::MAX_UPDATES;
+
+    dc.cout() << "Running Bias-SGD (Hogwild)" << std::endl;
+    dc.cout() << "Time   Training    Validation" <<std::endl;
+    dc.cout() << "       RMSE        RMSE " <<std::endl;
+    timer.start();
+    for (size_t epoch = 0; epoch < epochs; epoch++){
+      hogwild_runner.run_epoch(hogwild_syncs);
+      error_aggregator::print(dc.cout(), timer.current_time(),
+          graph.map_reduce_edges<error_aggregator>(error_aggregator::map_edge));
+      biassgd_vertex_program::GAMMA *= biassgd_vertex_program::STEP_DEC;
+    }
+    const double runtime = timer.current_time();
+    dc.cout() << "----------------------------------------------------------"
+              << std::endl
+              << "Final Runtime (seconds):   " << runtime << std::endl
+              << "Epochs executed: " << epochs << std::endl
+              << "Epoch Rate (epochs/hour): " << epochs * 3600 / runtime << std::endl;
+  }
+  else {
+    dc.cout() << "Creating engine" << std::endl;
+    engine_type engine(dc, graph, exec_type, clopts);
+
+    // Add error reporting to the engine
+    const bool success = engine.add_edge_aggregator<error_aggregator>
+      ("error", error_aggregator::map, error_aggregator::finalize) &&
+      engine.aggregate_periodic("error", interval);
+    ASSERT_TRUE(success);
+  
+
+    // Signal all vertices on the vertices on the left (libersgd) 
+    engine.map_reduce_vertices<graphlab::empty>(biassgd_vertex_program::signal_left);
  
 
-  dc.cout() << "Running Bias-SGD" << std::endl;
-  dc.cout() << "(C) Code by Danny Bickson, CMU " << std::endl;
-  dc.cout() << "Please send bug reports to danny.bickson@gmail.com" << std::endl;
-  dc.cout() << "Time   Training    Validation" <<std::endl;
-  dc.cout() << "       RMSE        RMSE " <<std::endl;
-  timer.start();
-  engine.start();  
-
-  const double runtime = timer.current_time();
-  dc.cout() << "----------------------------------------------------------"
-            << std::endl
-            << "Final Runtime (seconds):   " << runtime 
-            << std::endl
-            << "Updates executed: " << engine.num_updates() << std::endl
-            << "Update Rate (updates/second): " 
-            << engine.num_updates() / runtime << std::endl;
-
-  // Compute the final training error -----------------------------------------
-  dc.cout() << "Final error: " << std::endl;
-  engine.aggregate_now("error");
+    dc.cout() << "Running Bias-SGD" << std::endl;
+    dc.cout() << "(C) Code by Danny Bickson, CMU " << std::endl;
+    dc.cout() << "Please send bug reports to danny.bickson@gmail.com" << std::endl;
+    dc.cout() << "Time   Training    Validation" <<std::endl;
+    dc.cout() << "       RMSE        RMSE " <<std::endl;
+    timer.start();
+    engine.start();  
+
+    const double runtime = timer.current_time();
+    dc.cout() << "----------------------------------------------------------"
+              << std::endl
+              << "Final Runtime (seconds):   " << runtime 
+              << std::endl
+              << "Updates executed: " << engine.num_updates() << std::endl
+              << "Update Rate (updates/second): " 
+              << engine.num_updates() / runtime << std::endl;
+
+    // Compute the final training error -----------------------------------------
+    dc.cout() << "Final error: " << std::endl;
+    engine.aggregate_now("error");
+  }
 
   // Make predictions ---------------------------------------------------------
   if(!predictions.empty()) {
@@ -0,0 +1,159 @@
+#ifndef _HOGWILD_HPP__
+#define _HOGWILD_HPP__
+/**
+ * @file
+ *
+ * @section LICENSE
+ *
+ * Copyright [2012] [Carnegie Mellon University]
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * header file for running SGD in Hogwild mode: every machine streams over
+ * its own training edges with several threads, updating the user and item
+ * vertex data in place without any locking. Replicas of the same vertex on
+ * different machines drift apart and are reconciled by periodically
+ * sending their deltas to the master copy, which sums them and pushes
+ * the result back to all mirrors.
+ *
+ * Has to be included after graph_type and vec_type are defined.
+ *
+ * The Updater type has to provide:
+ *
+ *   // a single SGD step on a training edge, updating both sides in place
+ *   void operator()(vertex_data& user, vertex_data& item, const edge_data& edge) const;
+ *   // the parameters exchanged between replicas, flattened into a vector
+ *   static vec_type params(const vertex_data& vdata);
+ *   // adds a parameter delta to the vertex data
+ *   static void add_params(vertex_data& vdata, const vec_type& delta);
+ */
+
+#include <graphlab/rpc/buffered_exchange.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/util/random.hpp>
+
+template <typename Updater>
+class hogwild_sgd {
+  typedef graph_type::local_vertex_type local_vertex_type;
+  typedef graph_type::local_edge_type local_edge_type;
+  typedef graph_type::local_graph_type local_graph_type;
+  typedef std::pair<graphlab::vertex_id_type, vec_type> delta_type;
+  typedef graphlab::buffered_exchange<delta_type> delta_exchange_type;
+
+  struct train_edge {
+    graphlab::lvid_type user, item;
+    const edge_data* data;
+  };
+
+  graph_type& graph;
+  Updater updater;
+  size_t ncpus;
+  /** all local training edges, split into ncpus contiguous ranges */
+  std::vector<train_edge> edges;
+  /** params at the last synchronization, empty for unreplicated vertices */
+  std::vector<vec_type> snapshot;
+  delta_exchange_type delta_exchange;
+
+ public:
+  hogwild_sgd(graph_type& graph, graphlab::distributed_control& dc,
+              size_t ncpus, const Updater& updater = Updater()) :
+    graph(graph), updater(updater), ncpus(std::max<size_t>(ncpus, 1)),
+    delta_exchange(dc) {
+    for (graphlab::lvid_type lvid = 0; lvid < graph.num_local_vertices(); ++lvid) {
+      local_vertex_type lvertex = graph.l_vertex(lvid);
+      foreach(local_edge_type edge, lvertex.out_edges()) {
+        if (edge.data().role != edge_data::TRAIN)
+          continue;
+        train_edge e;
+        e.user = edge.source().id();
+        e.item = edge.target().id();
+        e.data = &edge.data();
+        edges.push_back(e);
+      }
+    }
+    // vertex data is initialized randomly on every machine, start from
+    // the master copy
+    graph.synchronize();
+    snapshot.resize(graph.num_local_vertices());
+    take_snapshot();
+  }
+
+  size_t num_edges() const { return edges.size(); }
+
+  /**
+   * \brief Runs one pass over all local training edges. The pass is cut
+   * into nsyncs rounds with a delta exchange after each, so a replica
+   * never lags the others by more than 1/nsyncs of an epoch.
+   * Must be called simultaneously by all machines.
+   */
+  void run_epoch(size_t nsyncs) {
+    nsyncs = std::max<size_t>(nsyncs, 1);
+    for (size_t round = 0; round < nsyncs; ++round) {
+      graphlab::thread_group threads;
+      for (size_t t = 0; t < ncpus; ++t)
+        threads.launch(boost::bind(&hogwild_sgd::process, this, t, round, nsyncs));
+      threads.join();
+      synchronize();
+    }
+  }
+
+ private:
+  void process(size_t thread_id, size_t round, size_t nsyncs) {
+    const size_t begin = edges.size() * thread_id / ncpus;
+    const size_t end = edges.size() * (thread_id + 1) / ncpus;
+    // every thread reshuffles its own range at the start of an epoch
+    if (round == 0)
+      graphlab::random::shuffle(edges.begin() + begin, edges.begin() + end);
+    const size_t round_begin = begin + (end - begin) * round / nsyncs;
+    const size_t round_end = begin + (end - begin) * (round + 1) / nsyncs;
+    local_graph_type& lgraph = graph.get_local_graph();
+    for (size_t i = round_begin; i < round_end; ++i) {
+      const train_edge& e = edges[i];
+      updater(lgraph.vertex_data(e.user), lgraph.vertex_data(e.item), *e.data);
+    }
+  }
+
+  void take_snapshot() {
+    for (graphlab::lvid_type lvid = 0; lvid < snapshot.size(); ++lvid) {
+      local_vertex_type lvertex = graph.l_vertex(lvid);
+      if (!lvertex.owned() || lvertex.num_mirrors() > 0)
+        snapshot[lvid] = Updater::params(lvertex.data());
+    }
+  }
+
+  /** sums the deltas of all replicas into the master and broadcasts it */
+  void synchronize() {
+    for (graphlab::lvid_type lvid = 0; lvid < snapshot.size(); ++lvid) {
+      local_vertex_type lvertex = graph.l_vertex(lvid);
+      if (lvertex.owned() || snapshot[lvid].size() == 0)
+        continue;
+      delta_exchange.send(lvertex.owner(),
+                          delta_type(lvertex.global_id(),
+                                     Updater::params(lvertex.data()) - snapshot[lvid]));
+    }
+    delta_exchange.flush();
+    graphlab::procid_t sending_proc;
+    typename delta_exchange_type::buffer_type recv_buffer;
+    while(delta_exchange.recv(sending_proc, recv_buffer)) {
+      foreach(const delta_type& delta, recv_buffer) {
+        Updater::add_params(graph.l_vertex(graph.local_vid(delta.first)).data(),
+                            delta.second);
+      }
+      recv_buffer.clear();
+    }
+    graph.synchronize();
+    take_snapshot();
+  }
+};
+
+#endif //_HOGWILD_HPP__
@@ -353,6 +353,9 @@ struct error_aggregator : public graphlab::IS_POD_TYPE {
 		return *this;
 	}
 	static error_aggregator map(icontext_type& context, const graph_type::edge_type& edge) {
+		return map_edge(edge);
+	}
+	static error_aggregator map_edge(const graph_type::edge_type& edge) {
 		error_aggregator agg;
 		if (edge.data().role == edge_data::TRAIN){
 			if (isuser_node(edge.source())) 
@@ -371,16 +374,20 @@ struct error_aggregator : public graphlab::IS_POD_TYPE {
 		iter++;
 		if (iter%2 == 0)
 			return; 
+		print(context.cout(), context.elapsed_seconds(), agg);
+		sgd_vertex_program::GAMMA *= sgd_vertex_program::STEP_DEC;
+	}
+
+	static void print(std::ostream& out, double elapsed, const error_aggregator& agg) {
 		const double train_error = std::sqrt(agg.train_error / info.training_edges);
 		assert(!std::isnan(train_error));
-		context.cout() << std::setw(8) << context.elapsed_seconds()  << "  " << std::setw(8) << train_error;
+		out << std::setw(8) << elapsed  << "  " << std::setw(8) << train_error;
 		if(info.validation_edges > 0) {
 			const double validation_error = 
 				std::sqrt(agg.validation_error / info.validation_edges);
-			context.cout() << "   " << std::setw(8) << validation_error; 
+			out << "   " << std::setw(8) << validation_error; 
 		}
-		context.cout() << std::endl;
-		sgd_vertex_program::GAMMA *= sgd_vertex_program::STEP_DEC;
+		out << std::endl;
 	}
 }; // end of error aggregator
 
@@ -520,6 +527,36 @@ double sgd_vertex_program::STEP_DEC = 0.9;
 bool sgd_vertex_program::debug = false;
 
 
+#include "hogwild.hpp"
+
+/**
+ * \brief A single lock free SGD step, used by the Hogwild mode. Applies
+ * the same update as sgd_vertex_program::gather() directly to both
+ * sides of the edge.
+ */
+struct sgd_hogwild_updater {
+	void operator()(vertex_data& user, vertex_data& item, const edge_data& edge) const {
+		double pred = user.pvec.dot(item.pvec);
+		pred = std::min(pred, sgd_vertex_program::MAXVAL);
+		pred = std::max(pred, sgd_vertex_program::MINVAL);
+		const double err = edge.obs - pred;
+		const double gamma = sgd_vertex_program::GAMMA;
+		const double lambda = sgd_vertex_program::LAMBDA;
+		for (int k=0; k< user.pvec.size(); k++){
+			const double u = user.pvec[k], v = item.pvec[k];
+			user.pvec[k] += gamma*(err*v - lambda*u);
+			item.pvec[k] += gamma*(err*u - lambda*v);
+		}
+	}
+	static vec_type params(const vertex_data& vdata) {
+		return vdata.pvec;
+	}
+	static void add_params(vertex_data& vdata, const vec_type& delta) {
+		vdata.pvec += delta;
+	}
+};
+
+
 /**
  * \brief The engine type used by the SGD matrix factorization
  * algorithm.
@@ -542,6 +579,8 @@ int main(int argc, char** argv) {
 	std::string predictions;
 	size_t interval = 0;
 	std::string exec_type = "synchronous";
+	bool hogwild = false;
+	size_t hogwild_syncs = 1;
 	clopts.attach_option("matrix", input_dir,
 			"The directory containing the matrix file");
 	clopts.add_positional("matrix");
@@ -566,6 +605,10 @@ int main(int argc, char** argv) {
 			"The time in seconds between error reports");
 	clopts.attach_option("predictions", predictions,
 			"The prefix (folder and filename) to save predictions.");
+	clopts.attach_option("hogwild", hogwild,
+			"If true, run lock free Hogwild SGD over the local edges instead of the engine. --max_iter is then the number of epochs");
+	clopts.attach_option("hogwild_syncs", hogwild_syncs,
+			"Hogwild mode: number of replica synchronizations per epoch");
 
 	parse_implicit_command_line(clopts);
 
@@ -621,43 +664,68 @@ int main(int argc, char** argv) {
 		<< float(graph.num_local_edges())/graph.num_edges()
 		<< std::endl;
 
-	dc.cout() << "Creating engine" << std::endl;
-	engine_type engine(dc, graph, exec_type, clopts);
-
-	// Add error reporting to the engine
-	const bool success = engine.add_edge_aggregator<error_aggregator>
-		("error", error_aggregator::map, error_aggregator::finalize) &&
-		engine.aggregate_periodic("error", interval);
-	ASSERT_TRUE(success);
-
-
-	// Signal all vertices on the vertices on the left (libersgd) 
-	engine.map_reduce_vertices<graphlab::empty>(sgd_vertex_program::signal_left);
-	info = graph.map_reduce_edges<stats_info>(count_edges);
-	dc.cout()<<"Training edges: " << info.training_edges << " validation edges: " << info.validation_edges << std::endl;
-
-
-	// Run the PageRank ---------------------------------------------------------
-	dc.cout() << "Running SGD" << std::endl;
-	dc.cout() << "(C) Code by Danny Bickson, CMU " << std::endl;
-	dc.cout() << "Please send bug reports to danny.bickson@gmail.com" << std::endl;
-	dc.cout() << "Time   Training    Validation" <<std::endl;
-	dc.cout() << "       RMSE        RMSE " <<std::endl;
-	timer.start();
-	engine.start();  
-
-	const double runtime = timer.current_time();
-	dc.cout() << "----------------------------------------------------------"
-		<< std::endl
-		<< "Final Runtime (seconds):   " << runtime 
-						    << std::endl
-								<< "Updates executed: " << engine.num_updates() << std::endl
-											      << "Update Rate (updates/second): " 
-												      << engine.num_updates() / runtime << std::endl;
-
-	// Compute the final training error -----------------------------------------
-	dc.cout() << "Final error: " << std::endl;
-	engine.aggregate_now("error");
+	if (hogwild){
+		info = graph.map_reduce_edges<stats_info>(count_edges);
+		dc.cout()<<"Training edges: " << info.training_edges << " validation edges: " << info.validation_edges << std::endl;
+		hogwild_sgd<sgd_hogwild_updater> hogwild_runner(graph, dc, clopts.get_ncpus());
+		const size_t epochs = sgd_vertex_program::MAX_UPDATES == size_t(-1) ? 10 : sgd_vertex_program::MAX_UPDATES;
+
+		dc.cout() << "Running SGD (Hogwild)" << std::endl;
+		dc.cout() << "Time   Training    Validation" <<std::endl;
+		dc.cout() << "       RMSE        RMSE " <<std::endl;
+		timer.start();
+		for (size_t epoch = 0; epoch < epochs; epoch++){
+			hogwild_runner.run_epoch(hogwild_syncs);
+			error_aggregator::print(dc.cout(), timer.current_time(),
+					graph.map_reduce_edges<error_aggregator>(error_aggregator::map_edge));
+			sgd_vertex_program::GAMMA *= sgd_vertex_program::STEP_DEC;
+		}
+		const double runtime = timer.current_time();
+		dc.cout() << "----------------------------------------------------------"
+			<< std::endl
+			<< "Final Runtime (seconds):   " << runtime << std::endl
+			<< "Epochs executed: " << epochs << std::endl
+			<< "Epoch Rate (epochs/hour): " << epochs * 3600 / runtime << std::endl;
+	}
+	else {
+		dc.cout() << "Creating engine" << std::endl;
+		engine_type engine(dc, graph, exec_type, clopts);
+
+		// Add error reporting to the engine
+		const bool success = engine.add_edge_aggregator<error_aggregator>
+			("error", error_aggregator::map, error_aggregator::finalize) &&
+			engine.aggregate_periodic("error", interval);
+		ASSERT_TRUE(success);
+
+
+		// Signal all vertices on the vertices on the left (libersgd) 
+		engine.map_reduce_vertices<graphlab::empty>(sgd_vertex_program::signal_left);
+		info = graph.map_reduce_edges<stats_info>(count_edges);
+		dc.cout()<<"Training edges: " << info.training_edges << " validation edges: " << info.validation_edges << std::endl;
+
+
+		// Run the PageRank ---------------------------------------------------------
+		dc.cout() << "Running SGD" << std::endl;
+		dc.cout() << "(C) Code by Danny Bickson, CMU " << std::endl;
+		dc.cout() << "Please send bug reports to danny.bickson@gmail.com" << std::endl;
+		dc.cout() << "Time   Training    Validation" <<std::endl;
+		dc.cout() << "       RMSE        RMSE " <<std::endl;
+		timer.start();
+		engine.start();  
+
+		const double runtime = timer.current_time();
+		dc.cout() << "----------------------------------------------------------"
+			<< std::endl
+			<< "Final Runtime (seconds):   " << runtime 
+							    << std::endl
+									<< "Updates executed: " << engine.num_updates() << std::endl
+												      << "Update Rate (updates/second): " 
+													      << engine.num_updates() / runtime << std::endl;
+
+		// Compute the final training error -----------------------------------------
+		dc.cout() << "Final error: " << std::endl;
+		engine.aggregate_now("error");
+	}
 
 	// Make predictions ---------------------------------------------------------
 	if(!predictions.empty()) {
@@ -351,6 +351,45 @@ void compute_ritz(graph_type::vertex_type & vertex){
 
 
 
+/**
+ * \brief Saves the converged singular vectors and the predictions.
+ * Expects the first nconv entries of pvec to hold U on the rows and V
+ * on the columns, and singular_values to hold the singular values.
+ */
+void save_results(){
+  if (save_vectors){
+    if (nconv == 0)
+      logstream(LOG_FATAL)<<"No converged vectors. Aborting the save operation" << std::endl;
+    if (predictions == "")
+      logstream(LOG_FATAL)<<"Please specify prediction output fie name using the --predictions=filename command"<<std::endl;
+
+    BEGIN_TRACEPOINT(svd_vectors);
+    std::cout << "Saving singular value triplets to files: " << predictions << ".U.* and "<< predictions << ".V.*" <<std::endl;
+    const bool gzip_output = false;
+    const bool save_vertices = false;
+    const bool save_edges = true;
+    const size_t threads_per_machine = 1;
+    pgraph->save(predictions + ".U", linear_model_saver_U(),
+          gzip_output, save_edges, save_vertices, threads_per_machine);
+      pgraph->save(predictions + ".V", linear_model_saver_V(),
+          gzip_output, save_edges, save_vertices, threads_per_machine);
+    END_TRACEPOINT(svd_vectors);
+  }
+
+  if(!predictions.empty()) {
+    std::cout << "Saving predictions" << std::endl;
+    const bool gzip_output = false;
+    const bool save_vertices = false;
+    const bool save_edges = true;
+    const size_t threads_per_machine = 1;
+
+    //save the predictions
+    pgraph->save(predictions, prediction_saver(),
+               gzip_output, save_vertices, 
+               save_edges, threads_per_machine);
+  }
+}
+
 void lanczos(bipartite_graph_descriptor & info, timer & mytimer, vec & errest, 
     const std::string & vecfile){
 
@@ -542,42 +581,218 @@ void lanczos(bipartite_graph_descriptor & info, timer & mytimer, vec & errest,
   }
   END_TRACEPOINT(svd_error2);
 
-  if (save_vectors){
-    if (nconv == 0)
-      logstream(LOG_FATAL)<<"No converged vectors. Aborting the save operation" << std::endl;
-    if (predictions == "")
-      logstream(LOG_FATAL)<<"Please specify prediction output fie name using the --predictions=filename command"<<std::endl;
+  sigma.conservativeResize(nconv);
+  singular_values = sigma;
+  save_results();
+}
 
-    BEGIN_TRACEPOINT(svd_vectors);
-    std::cout << "Saving singular value triplets to files: " << predictions << ".U.* and "<< predictions << ".V.*" <<std::endl;
-    const bool gzip_output = false;
-    const bool save_vertices = false;
-    const bool save_edges = true;
-    const size_t threads_per_machine = 1;
-    pgraph->save(predictions + ".U", linear_model_saver_U(),
-          gzip_output, save_edges, save_vertices, threads_per_machine);
-      pgraph->save(predictions + ".V", linear_model_saver_V(),
-          gzip_output, save_edges, save_vertices, threads_per_machine);
-    END_TRACEPOINT(svd_vectors);
+
+/**
+ * \brief A sum of dense blocks. Used as the gather type of block_Axb and
+ * for the small block_width x block_width matrices reduced over the graph.
+ */
+class block_sum {
+  public:
+    mat value;
+    block_sum() { }
+    explicit block_sum(const mat & value) : value(value) { }
+    void save(graphlab::oarchive& arc) const { arc << value; }
+    void load(graphlab::iarchive& arc) { arc >> value; }
+    block_sum& operator+=(const block_sum& other) {
+      if (other.value.size() == 0)
+        return *this;
+      if (value.size() == 0)
+        value = other.value;
+      else value += other.value;
+      return *this;
+    }
+};
+
+//RANDOMIZED BLOCK VARIABLES
+bool randomized = false;
+int oversampling = 10;
+int power_iters = 2;
+int block_width = 0; //number of vectors in the block (nsv + oversampling)
+int block_target = 0; //offset in pvec written by block_Axb
+bool block_rows = true; //if true, block operations act on the row vertices, else on the columns
+mat block_transform; //right multiplied into the block of each vertex by transform_block
+vec block_sigma;
+
+inline bool is_block_side(const graph_type::vertex_type & vertex){
+  return (vertex.id() < (uint)rows) == block_rows;
+}
+
+/**
+ * \brief Multiplies the matrix by a whole block of vectors in one pass.
+ * Every vertex stores its block contiguously in pvec[0..block_width), and
+ * the rows (A*x) or the columns (A'*x) write the product into
+ * pvec[block_target..block_target+block_width).
+ */
+class block_Axb :
+  public graphlab::ivertex_program<graph_type, block_sum>,
+  public graphlab::IS_POD_TYPE {
+  public:
+    edge_dir_type gather_edges(icontext_type& context,
+        const vertex_type& vertex) const {
+      if (vertex.id() < (uint)rows)
+        return OUT_EDGES;
+      else return IN_EDGES;
+    }
+
+    block_sum gather(icontext_type& context, const vertex_type& vertex,
+        edge_type& edge) const {
+      block_sum ret;
+      if (edge.data().role == edge_data::PREDICT)
+        return ret;
+      const vertex_type other = get_other_vertex(edge, vertex);
+      ret.value = edge.data().obs * other.data().pvec.head(block_width);
+      return ret;
+    }
+
+    void apply(icontext_type& context, vertex_type& vertex,
+        const block_sum& total) {
+      if (total.value.size() == 0)
+        vertex.data().pvec.segment(block_target, block_width).setZero();
+      else vertex.data().pvec.segment(block_target, block_width) = total.value.col(0);
+    }
+
+    edge_dir_type scatter_edges(icontext_type& context,
+        const vertex_type& vertex) const {
+      return NO_EDGES;
+    }
+};
+
+typedef graphlab::omni_engine<block_Axb> block_engine_type;
+block_engine_type * pblock_engine = NULL;
+
+void init_block(graph_type::vertex_type & vertex){
+  vertex.data().pvec = zeros(2*block_width);
+  if (vertex.id() >= (uint)rows){
+    for (int i=0; i< block_width; i++)
+      vertex.data().pvec[i] = graphlab::random::gaussian();
   }
+}
 
-  sigma.conservativeResize(nconv);
-  singular_values = sigma;
-  if(!predictions.empty()) {
-    std::cout << "Saving predictions" << std::endl;
-    const bool gzip_output = false;
-    const bool save_vertices = false;
-    const bool save_edges = true;
-    const size_t threads_per_machine = 1;
+void transform_block(graph_type::vertex_type & vertex){
+  vertex.data().pvec.head(block_width) = block_transform.transpose() * vertex.data().pvec.head(block_width);
+}
 
-    //save the predictions
-    pgraph->save(predictions, prediction_saver(),
-               gzip_output, save_vertices, 
-               save_edges, threads_per_machine);
+block_sum block_gram(const graph_type::vertex_type & vertex){
+  const vec b = vertex.data().pvec.head(block_width);
+  return block_sum(b * b.transpose());
+}
+
+/* squared norms of the columns of (A x)_i - sigma_i y_i, where the
+   product was written by block_multiply(.., block_width) */
+block_sum block_residual(const graph_type::vertex_type & vertex){
+  const vec & pvec = vertex.data().pvec;
+  const vec r = pvec.segment(block_width, nsv) - block_sigma.cwiseProduct(pvec.head(nsv));
+  return block_sum(r.cwiseAbs2());
+}
+
+/**
+ * \brief Computes pvec[target..] = A*pvec[0..] on the rows (rows_side = true)
+ * or A'*pvec[0..] on the columns, for the whole block in one engine run.
+ */
+void block_multiply(bool rows_side, int target){
+  block_rows = rows_side;
+  block_target = target;
+  vertex_set nodes = pgraph->select(is_block_side);
+  pblock_engine->signal_vset(nodes);
+  pblock_engine->start();
+}
+
+/**
+ * \brief Orthonormalizes the block on one side using CholeskyQR2: the
+ * Gram matrix is reduced in a single map_reduce pass and the block is
+ * right multiplied by the inverse Cholesky factor, twice for stability.
+ * Returns the triangular factor R with (old block) = (new block) * R.
+ */
+mat block_orthonormalize(bool rows_side){
+  block_rows = rows_side;
+  vertex_set nodes = pgraph->select(is_block_side);
+  mat R = eye(block_width);
+  for (int pass=0; pass < 2; pass++){
+    mat G = pgraph->map_reduce_vertices<block_sum>(block_gram, nodes).value;
+    Eigen::LLT<mat> llt(G);
+    if (llt.info() != Eigen::Success){
+      //rank deficient block, shift the Gram matrix so the factorization exists
+      G.diagonal().array() += 1e-12 * std::max(G.trace(), 1.0);
+      llt.compute(G);
+      if (llt.info() != Eigen::Success)
+        logstream(LOG_FATAL)<<"Failed to orthonormalize the block. Try a smaller --oversampling" << std::endl;
+    }
+    const mat Rp = llt.matrixU();
+    block_transform = Rp.triangularView<Eigen::Upper>().solve(eye(block_width));
+    pgraph->transform_vertices(transform_block, nodes);
+    R = Rp * R;
   }
- 
+  return R;
 }
 
+/**
+ * \brief Randomized block SVD (Halko, Martinsson and Tropp, 2011).
+ *
+ * The range of A is found by multiplying a random block of nsv+oversampling
+ * vectors by (A A')^power_iters A, orthonormalizing the block after every
+ * product. Each product is a single engine run over the whole block and
+ * each orthonormalization a single reduction of a small Gram matrix,
+ * instead of one pass per vector and per previous vector as in lanczos().
+ */
+void randomized_svd(bipartite_graph_descriptor & info, timer & mytimer, vec & errest){
+  block_width = std::min(nsv + oversampling, std::min(rows, cols));
+  if (nsv > block_width)
+    logstream(LOG_FATAL)<<"Number of requested singular values --nsv=XX can not exceed the matrix dimensions" << std::endl;
+  data_size = actual_vector_len = 2*block_width;
+  pgraph->transform_vertices(init_block);
+  logstream(LOG_INFO)<<"Allocated a total of: " << ((double)actual_vector_len * pgraph->num_vertices() * sizeof(double)/ 1e6) << " MB for storing vectors." << std::endl;
+
+  //Q = orth(A*Omega)
+  block_multiply(true, 0);
+  block_orthonormalize(true);
+  for (int i=0; i< power_iters; i++){
+    logstream(LOG_EMPH)<<"Starting power iteration: " << i << " at time: " << mytimer.current_time() << std::endl;
+    block_multiply(false, 0);
+    block_orthonormalize(false);
+    block_multiply(true, 0);
+    block_orthonormalize(true);
+  }
+
+  //B' = A'*Q = Qz*R, hence B = R'*Qz' and the svd of the small matrix R'
+  //gives U = Q*Ur, V = Qz*Vr
+  block_multiply(false, 0);
+  mat R = block_orthonormalize(false);
+  mat Ur, Vr;
+  vec sigma;
+  svd(R.transpose(), Ur, Vr, sigma);
+  block_transform = Vr;
+  block_rows = false;
+  pgraph->transform_vertices(transform_block, pgraph->select(is_block_side));
+  block_transform = Ur;
+  block_rows = true;
+  pgraph->transform_vertices(transform_block, pgraph->select(is_block_side));
+
+  //error estimate, as in lanczos()
+  block_sigma = sigma.head(nsv);
+  block_multiply(true, block_width);
+  vec err_u = pgraph->map_reduce_vertices<block_sum>(block_residual, pgraph->select(is_block_side)).value.col(0);
+  block_multiply(false, block_width);
+  vec err_v = pgraph->map_reduce_vertices<block_sum>(block_residual, pgraph->select(is_block_side)).value.col(0);
+  errest = zeros(nsv);
+  for (int i=0; i < nsv; i++){
+    double err = sqrt(err_u[i] + err_v[i]);
+    if (sigma(i) > tol)
+      err = err/sigma(i);
+    errest[i] = err;
+    printf("Singular value %d \t%13.6g\tError estimate: %13.6g\n", i, sigma(i), err);
+  }
+
+  nconv = nsv;
+  singular_values = sigma.head(nsv);
+  save_results();
+}
+
+
 void start_engine(){
   vertex_set nodes = pgraph->select(selected_node);
   pengine->signal_vset(nodes);
@@ -635,6 +850,9 @@ int main(int argc, char** argv) {
   clopts.attach_option("predictions", predictions, "predictions file prefix");
   clopts.attach_option("binary", binary, "If true, all edges are weighted as one");
   clopts.attach_option("input_file_offset", input_file_offset, "input file node id offset (default 0)");
+  clopts.attach_option("randomized", randomized, "If true, compute a randomized block SVD instead of restarted lanczos");
+  clopts.attach_option("oversampling", oversampling, "randomized mode: number of extra vectors in the block (block size is nsv + oversampling)");
+  clopts.attach_option("power_iters", power_iters, "randomized mode: number of power iterations. More iterations give more accurate singular values");
   if(!clopts.parse(argc, argv) || input_dir == "") {
     std::cout << "Error in parsing command line arguments." << std::endl;
     clopts.print_description();
@@ -689,7 +907,10 @@ int main(int argc, char** argv) {
   info.rows = rows;
   info.cols = cols;
 
-  if (nv < nsv){
+  if (randomized && (oversampling < 0 || power_iters < 0))
+    logstream(LOG_FATAL)<<"--oversampling and --power_iters must be non negative" << std::endl;
+
+  if (!randomized && nv < nsv){
     logstream(LOG_FATAL)<<"Please set the number of vectors --nv=XX, to be at least the number of support vectors --nsv=XX or larger" << std::endl;
   }
 
@@ -732,36 +953,49 @@ int main(int argc, char** argv) {
     << std::endl;
 
   dc.cout() << "Creating engine" << std::endl;
-  engine_type engine(dc, graph, exec_type, clopts);
-  pengine = &engine;
-
-  dc.cout() << "Running SVD (gklanczos)" << std::endl;
-  dc.cout() << "(C) Code by Danny Bickson, CMU " << std::endl;
-  dc.cout() << "Please send bug reports to danny.bickson@gmail.com" << std::endl;
-  timer.start();
-
-  init_lanczos(&graph, info);
-  init_math(&graph, info, ortho_repeats, update_function);
-  if (vecfile.size() > 0){
-    std::cout << "Load inital vector from file" << vecfile << std::endl;
-    FILE * file = fopen((vecfile).c_str(), "r");
-    if (file == NULL)
-      logstream(LOG_FATAL)<<"Failed to open initial vector"<< std::endl;
-    vec input = vec::Zero(rows);
-    double val = 0;
-    for (int i=0; i< rows; i++){
-      int rc = fscanf(file, "%lg\n", &val);
-      if (rc != 1)
-        logstream(LOG_FATAL)<<"Failed to read initial vector (on line: "<< i << " ) " << std::endl;
-      input[i] = val;
-    }
-    fclose(file);
-    DistVec v0(info, 0, false, "v0");
-    v0 = input;
-  }  
-
   vec errest;
-  lanczos( info, timer, errest, vecfile);
+  size_t num_updates = 0;
+  if (randomized){
+    block_engine_type engine(dc, graph, exec_type, clopts);
+    pblock_engine = &engine;
+
+    dc.cout() << "Running SVD (randomized block)" << std::endl;
+    timer.start();
+    randomized_svd(info, timer, errest);
+    num_updates = engine.num_updates();
+  }
+  else {
+    engine_type engine(dc, graph, exec_type, clopts);
+    pengine = &engine;
+
+    dc.cout() << "Running SVD (gklanczos)" << std::endl;
+    dc.cout() << "(C) Code by Danny Bickson, CMU " << std::endl;
+    dc.cout() << "Please send bug reports to danny.bickson@gmail.com" << std::endl;
+    timer.start();
+
+    init_lanczos(&graph, info);
+    init_math(&graph, info, ortho_repeats, update_function);
+    if (vecfile.size() > 0){
+      std::cout << "Load inital vector from file" << vecfile << std::endl;
+      FILE * file = fopen((vecfile).c_str(), "r");
+      if (file == NULL)
+        logstream(LOG_FATAL)<<"Failed to open initial vector"<< std::endl;
+      vec input = vec::Zero(rows);
+      double val = 0;
+      for (int i=0; i< rows; i++){
+        int rc = fscanf(file, "%lg\n", &val);
+        if (rc != 1)
+          logstream(LOG_FATAL)<<"Failed to read initial vector (on line: "<< i << " ) " << std::endl;
+        input[i] = val;
+      }
+      fclose(file);
+      DistVec v0(info, 0, false, "v0");
+      v0 = input;
+    }  
+
+    lanczos( info, timer, errest, vecfile);
+    num_updates = engine.num_updates();
+  }
 
   if (graphlab::mpi_tools::rank()==0)
     write_output_vector(predictions + ".singular_values", singular_values, false, "%GraphLab SVD Solver library. This file contains the singular values.");
@@ -771,9 +1005,9 @@ int main(int argc, char** argv) {
     << std::endl
     << "Final Runtime (seconds):   " << runtime 
                                         << std::endl
-                                        << "Updates executed: " << engine.num_updates() << std::endl
+                                        << "Updates executed: " << num_updates << std::endl
                                         << "Update Rate (updates/second): " 
-                                          << engine.num_updates() / runtime << std::endl;
+                                          << num_updates / runtime << std::endl;
 
   // Compute the final training error -----------------------------------------
   if (unittest == 1){
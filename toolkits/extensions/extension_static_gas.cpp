@@ -0,0 +1,72 @@
+#include <graphlab.hpp>
+#include "extensions.hpp"
+#include "extension_static_gas.hpp"
+
+namespace graphlab {
+namespace extension {
+
+// pre-instantiate the common operations so that the extension library
+// carries the compiled kernels
+template struct static_gas_program<neighbor_sum_ops>;
+template struct static_gas_program<neighbor_min_ops>;
+template struct static_gas_program<neighbor_max_ops>;
+template struct static_gas_program<pagerank_ops>;
+
+
+template <typename Combine>
+static void neighbor_reduce(extension_graph& graph,
+                            const std::string& source,
+                            const std::string& target,
+                            edge_dir_type dir,
+                            double empty_value) {
+  neighbor_reduce_ops<Combine> ops;
+  ops.source = get_id_from_name(source);
+  ops.target = get_id_from_name(target);
+  ops.dir = dir;
+  ops.empty_value = empty_value;
+  run_static_gas(graph, ops);
+}
+
+void neighbor_sum(extension_graph& graph,
+                  const std::string source,
+                  const std::string target,
+                  edge_dir_type dir) {
+  neighbor_reduce<sum_combine>(graph, source, target, dir, 0.0);
+}
+
+void neighbor_min(extension_graph& graph,
+                  const std::string source,
+                  const std::string target,
+                  edge_dir_type dir) {
+  neighbor_reduce<min_combine>(graph, source, target, dir,
+                               std::numeric_limits<double>::infinity());
+}
+
+void neighbor_max(extension_graph& graph,
+                  const std::string source,
+                  const std::string target,
+                  edge_dir_type dir) {
+  neighbor_reduce<max_combine>(graph, source, target, dir,
+                               -std::numeric_limits<double>::infinity());
+}
+
+
+void static_pagerank(extension_graph& graph,
+                     const std::string PR_FIELD_NAME,
+                     double tolerance) {
+  pagerank_ops ops;
+  ops.pr = get_id_from_name(PR_FIELD_NAME);
+  ops.pr_change = get_id_from_name(PR_FIELD_NAME + "_change");
+  ops.out_degree = get_id_from_name("out_degree");
+  ops.tolerance = tolerance;
+
+  graph.transform_field(ops.pr, [](var v){ return 0.15; });
+  timer ti;
+  run_static_gas(graph, ops);
+  std::cout << "Static PageRank complete in " << ti.current_time() 
+            << "s" << std::endl;
+}
+
+
+} // namespace extension
+} // namespace graphlab
@@ -0,0 +1,232 @@
+#ifndef GRAPHLAB_EXTENSION_STATIC_GAS_HPP
+#define GRAPHLAB_EXTENSION_STATIC_GAS_HPP
+
+#include <limits>
+#include <graphlab/vertex_program/ivertex_program.hpp>
+#include <graphlab/engine/synchronous_engine.hpp>
+#include "extension_graph.hpp"
+
+/*
+  Statically dispatched GAS operations.
+
+  The lambda based GAS() in extension_graph drives every gather, combine,
+  apply and scatter through a virtual functor looked up from the
+  descriptor table, and boxes every partial gather into a var.
+  Here the operations are instead supplied as a single "Ops" struct
+  which is compiled directly into the vertex program, so every call is
+  inlined and the gather is accumulated in its native type.
+
+  An Ops struct must provide:
+
+    typedef ... gather_type;   // default constructible, supports +=,
+                               // and is serializable
+    edge_dir_type gather_edges(const vars& center) const;
+    gather_type gather(const vars& center, const vars& edge,
+                       const vars& other, edge_direction dir) const;
+    bool apply(vars& center, const gather_type& total) const;
+    edge_dir_type scatter_edges(const vars& center) const;
+    bool scatter(const vars& center, const vars& edge,
+                 const vars& other, edge_direction dir) const;
+
+  apply() returning true signals the vertex again, and scatter()
+  returning true signals the neighbor, as with GAS().
+
+  The common cases (neighbor sum, min and max, and PageRank) are provided
+  below and instantiated in extension_static_gas.cpp.
+*/
+
+namespace graphlab {
+namespace extension {
+
+/**
+ * The vertex program which runs an Ops struct. The Ops instance is
+ * shared by all vertex programs of the same type and is set by
+ * run_static_gas() before the engine starts.
+ */
+template <typename Ops>
+struct static_gas_program:
+    public graphlab::ivertex_program<internal_graph_type,
+                                     typename Ops::gather_type>,
+    public graphlab::IS_POD_TYPE {
+  typedef graphlab::ivertex_program<internal_graph_type,
+                                    typename Ops::gather_type> parent_type;
+  typedef typename parent_type::icontext_type icontext_type;
+  typedef typename parent_type::vertex_type vertex_type;
+  typedef typename parent_type::edge_type edge_type;
+  typedef typename parent_type::gather_type gather_type;
+
+  static Ops ops;
+
+  edge_dir_type gather_edges(icontext_type& context,
+                             const vertex_type& vertex) const {
+    return ops.gather_edges(vertex.data());
+  }
+
+  inline gather_type gather(icontext_type& context,
+                            const vertex_type& vertex,
+                            edge_type& edge) const {
+    const bool is_out = edge.source().id() == vertex.id();
+    const vertex_type other_vertex = is_out ? edge.target() : edge.source();
+    return ops.gather(vertex.data(), edge.data(), other_vertex.data(),
+                      is_out ? OUT_EDGE : IN_EDGE);
+  }
+
+  inline void apply(icontext_type& context, vertex_type& vertex,
+                    const gather_type& total) {
+    if (ops.apply(vertex.data(), total)) context.signal(vertex);
+  }
+
+  edge_dir_type scatter_edges(icontext_type& context,
+                              const vertex_type& vertex) const {
+    return ops.scatter_edges(vertex.data());
+  }
+
+  inline void scatter(icontext_type& context, const vertex_type& vertex,
+                      edge_type& edge) const {
+    const bool is_out = edge.source().id() == vertex.id();
+    const vertex_type other_vertex = is_out ? edge.target() : edge.source();
+    if (ops.scatter(vertex.data(), edge.data(), other_vertex.data(),
+                    is_out ? OUT_EDGE : IN_EDGE)) {
+      context.signal(other_vertex);
+    }
+  }
+};
+
+template <typename Ops>
+Ops static_gas_program<Ops>::ops;
+
+
+/**
+ * Runs the Ops struct over the graph with the synchronous engine,
+ * starting with every vertex active.
+ */
+template <typename Ops>
+void run_static_gas(extension_graph& graph, const Ops& ops) {
+  typedef static_gas_program<Ops> program_type;
+  graph.finalize();
+  graph.lock.lock();
+  program_type::ops = ops;
+  synchronous_engine<program_type> sync_engine(graph.rmi.dc(),
+                                               graph.internal_graph,
+                                               __glopts);
+  sync_engine.signal_all();
+  sync_engine.start();
+  graph.lock.unlock();
+}
+
+
+
+//////////////////////////////////////////////////////////////
+// Combiners for the pre-instantiated operations            //
+//////////////////////////////////////////////////////////////
+
+struct sum_combine {
+  static void combine(double& a, double b) { a += b; }
+};
+
+struct min_combine {
+  static void combine(double& a, double b) { if (b < a) a = b; }
+};
+
+struct max_combine {
+  static void combine(double& a, double b) { if (b > a) a = b; }
+};
+
+/**
+ * A double gather accumulated with Combine. "empty" is set for a vertex
+ * with no edges in the gathered direction so that min and max do not
+ * have to invent an identity.
+ */
+template <typename Combine>
+struct combined_double: public graphlab::IS_POD_TYPE {
+  double value;
+  bool empty;
+  combined_double(): value(0), empty(true) { }
+  explicit combined_double(double value): value(value), empty(false) { }
+  combined_double& operator+=(const combined_double& other) {
+    if (other.empty) return *this;
+    if (empty) *this = other;
+    else Combine::combine(value, other.value);
+    return *this;
+  }
+};
+
+
+/**
+ * Reduces the double field "source" over the neighbors in direction
+ * "dir" into the field "target" of every vertex. Vertices with no
+ * neighbors in that direction get "empty_value". Runs for one
+ * iteration.
+ */
+template <typename Combine>
+struct neighbor_reduce_ops {
+  typedef combined_double<Combine> gather_type;
+  key_id_type source;
+  key_id_type target;
+  edge_dir_type dir;
+  double empty_value;
+
+  edge_dir_type gather_edges(const vars&) const {
+    return dir;
+  }
+  gather_type gather(const vars&, const vars&,
+                     const vars& other, edge_direction) const {
+    return gather_type(get<double>(other.field(source)));
+  }
+  bool apply(vars& center, const gather_type& total) const {
+    center.field(target) = total.empty ? empty_value : total.value;
+    return false;
+  }
+  edge_dir_type scatter_edges(const vars&) const {
+    return NO_EDGES;
+  }
+  bool scatter(const vars&, const vars&, const vars&, edge_direction) const {
+    return false;
+  }
+};
+
+typedef neighbor_reduce_ops<sum_combine> neighbor_sum_ops;
+typedef neighbor_reduce_ops<min_combine> neighbor_min_ops;
+typedef neighbor_reduce_ops<max_combine> neighbor_max_ops;
+
+
+/**
+ * PageRank over the field "pr", with the same update and termination
+ * rule as the lambda version in extension_pagerank.cpp.
+ */
+struct pagerank_ops {
+  typedef double gather_type;
+  key_id_type pr;
+  key_id_type pr_change;
+  key_id_type out_degree;
+  double tolerance;
+
+  edge_dir_type gather_edges(const vars&) const {
+    return IN_EDGES;
+  }
+  double gather(const vars&, const vars&,
+                const vars& other, edge_direction) const {
+    return get<double>(other.field(pr)) / get<double>(other.field(out_degree));
+  }
+  bool apply(vars& center, const double& total) const {
+    const double newpr = 0.15 + 0.85 * total;
+    var& prval = center.field(pr);
+    center.field(pr_change) =
+        std::fabs(newpr - get<double>(prval)) /
+        get<double>(center.field(out_degree));
+    prval = newpr;
+    return false;
+  }
+  edge_dir_type scatter_edges(const vars& center) const {
+    return get<double>(center.field(pr_change)) > tolerance ?
+                                      OUT_EDGES : NO_EDGES;
+  }
+  bool scatter(const vars&, const vars&, const vars&, edge_direction) const {
+    return true;
+  }
+};
+
+} // namespace extension
+} // namespace graphlab
+
+#endif
@@ -19,6 +19,28 @@ void pagerank(extension_graph& graph,
               const std::string PR_FIELD,
               double tolerance);
 
+// statically dispatched versions, see extension_static_gas.hpp
+void static_pagerank(extension_graph& graph,
+                     const std::string PR_FIELD,
+                     double tolerance);
+
+// reduces the double field "source" over the neighbors in direction dir
+// and stores the result in the field "target"
+void neighbor_sum(extension_graph& graph,
+                  const std::string source,
+                  const std::string target,
+                  edge_dir_type dir);
+
+void neighbor_min(extension_graph& graph,
+                  const std::string source,
+                  const std::string target,
+                  edge_dir_type dir);
+
+void neighbor_max(extension_graph& graph,
+                  const std::string source,
+                  const std::string target,
+                  edge_dir_type dir);
+
 } // namespace extension
 } // namespace graphlab
 
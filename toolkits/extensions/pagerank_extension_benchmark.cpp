@@ -0,0 +1,52 @@
+#include "extensions.hpp"
+#include <graphlab/util/timer.hpp>
+using namespace graphlab::extension;
+
+/*
+ * Runs the lambda based PageRank from extension_pagerank.cpp and the
+ * statically dispatched one from extension_static_gas.hpp on the same
+ * graph, and reports both runtimes and the largest difference between
+ * the two results.
+ */
+
+struct max_difference {
+  double value;
+  max_difference(double value = 0): value(value) { }
+  max_difference& operator+=(const max_difference& other) {
+    value = std::max(value, other.value);
+    return *this;
+  }
+  void save(graphlab::oarchive& oarc) const { oarc << value; }
+  void load(graphlab::iarchive& iarc) { iarc >> value; }
+};
+
+max_difference pr_difference(const internal_graph_type::vertex_type& v) {
+  return max_difference(std::fabs(get<double>(v.data().field("pr")) -
+                                  get<double>(v.data().field("static_pr"))));
+}
+
+int main(int argc, char** argv) {
+  extension_graph graph;
+  if (argc < 2) {
+    std::cout << argv[0] << " [input prefix] optional:[tolerance]\n"; 
+    return 0;
+  }
+  const double tolerance = argc > 2 ? atof(argv[2]) : 0.01;
+  graph.load_structure(argv[1], "snap");
+  graph.finalize();
+
+  graphlab::timer ti;
+  pagerank(graph, "pr", tolerance);
+  const double lambda_time = ti.current_time();
+
+  ti.start();
+  static_pagerank(graph, "static_pr", tolerance);
+  const double static_time = ti.current_time();
+
+  const double diff = graph.graph().map_reduce_vertices<max_difference>(
+                                                    pr_difference).value;
+  std::cout << "Lambda GAS:    " << lambda_time << "s\n"
+            << "Static GAS:    " << static_time << "s\n"
+            << "Speedup:       " << lambda_time / static_time << "\n"
+            << "Max |pr diff|: " << diff << std::endl;
+}
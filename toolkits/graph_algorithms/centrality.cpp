@@ -0,0 +1,824 @@
+/*
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ *
+ */
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
+#include <boost/cstdint.hpp>
+
+#include <graphlab.hpp>
+
+#include <graphlab/macros_def.hpp>
+
+/*
+ * Batched betweenness and closeness centrality.
+ *
+ * Unlike betweeness.cpp and closeness.cpp, which keep a std::map of
+ * spanning tree nodes per vertex, the shortest path searches from up to
+ * LANES sources run together in fixed size arrays: lane i of every
+ * vertex holds the state of the search from the i-th source of the
+ * batch. Unweighted graphs use a multi-source BFS in which a vertex
+ * keeps the set of searches that reached it as a bit mask, so expanding
+ * a frontier vertex for all of its searches is a few word operations
+ * per edge. Weighted graphs relax all lanes of an edge at once
+ * (Bellman-Ford) and then count shortest paths over the shortest path
+ * DAG.
+ *
+ * Only the lanes changed by the last apply are sent to the mirrors
+ * (HAS_MIRROR_DATA), so a vertex reached by few searches of a batch
+ * costs little to synchronize.
+ *
+ * Betweenness is accumulated with Brandes' dependency recursion.
+ * Sampling k sources and scaling by n/k gives an unbiased estimate of
+ * betweenness; the Hoeffding bound on the error is reported.
+ */
+
+
+/**
+ * \brief The number of sources searched simultaneously.
+ */
+static const size_t LANES = 64;
+
+typedef boost::uint64_t lane_mask;
+
+inline lane_mask lane_bit(size_t lane) { return lane_mask(1) << lane; }
+
+/**
+ * \brief Removes and returns the lowest lane in the mask.
+ */
+inline size_t pop_lane(lane_mask& mask) {
+  const size_t lane = __builtin_ctzll(mask);
+  mask &= mask - 1;
+  return lane;
+}
+
+
+/**
+ * \brief The search state of a vertex for every lane of the current
+ * batch, and the centrality accumulated over all batches.
+ *
+ * The mirrors only receive the lanes in dirty, which every apply sets
+ * to the lanes it changed. The totals are only kept on the master.
+ */
+struct vertex_data : graphlab::IS_POD_TYPE, graphlab::HAS_MIRROR_DATA {
+  /** the lanes whose source reaches this vertex */
+  lane_mask seen;
+  /** the lanes changed by the last apply */
+  lane_mask dirty;
+  double dist[LANES];
+  /** number of shortest paths from the source */
+  double sigma[LANES];
+  /** Brandes' dependency of the source on this vertex */
+  double delta[LANES];
+  double betweenness;
+  double dist_sum;
+  size_t reached;
+  vertex_data() : seen(0), dirty(0), betweenness(0), dist_sum(0), reached(0) { }
+
+  void save_mirror(graphlab::oarchive& oarc) const {
+    oarc << seen << dirty;
+    lane_mask m = dirty;
+    while (m) {
+      const size_t lane = pop_lane(m);
+      oarc << dist[lane] << sigma[lane] << delta[lane];
+    }
+  }
+
+  void load_mirror(graphlab::iarchive& iarc) {
+    iarc >> seen >> dirty;
+    lane_mask m = dirty;
+    while (m) {
+      const size_t lane = pop_lane(m);
+      iarc >> dist[lane] >> sigma[lane] >> delta[lane];
+    }
+  }
+}; // end of vertex data
+
+
+typedef graphlab::distributed_graph<vertex_data, double> graph_type;
+
+
+/**
+ * \brief Treat edges as directed.
+ */
+bool DIRECTED = true;
+
+/**
+ * \brief Use the edge values as lengths. Otherwise every edge has
+ * length one and the multi-source BFS is used.
+ */
+bool WEIGHTED = false;
+
+/**
+ * \brief The source of each lane in the current batch.
+ */
+std::vector<graphlab::vertex_id_type> BATCH_SOURCES;
+
+/**
+ * \brief The BFS level whose dependencies are being accumulated, or -1
+ * to accumulate all lanes until they stop changing (weighted graphs).
+ */
+double DEPENDENCY_LEVEL = -1;
+
+
+inline graph_type::vertex_type
+get_other_vertex(const graph_type::edge_type& edge,
+                 const graph_type::vertex_type& vertex) {
+  return vertex.id() == edge.source().id()? edge.target() : edge.source();
+}
+
+inline double edge_length(const graph_type::edge_type& edge) {
+  return WEIGHTED ? edge.data() : 1.0;
+}
+
+/**
+ * \brief Whether the edge from u to v lies on a shortest path of the lane.
+ */
+inline bool on_shortest_path(double dist_u, double length, double dist_v) {
+  return std::fabs(dist_u + length - dist_v) <= 1e-9 * std::max(1.0, dist_v);
+}
+
+inline graphlab::edge_dir_type forward_edges() {
+  return DIRECTED ? graphlab::OUT_EDGES : graphlab::ALL_EDGES;
+}
+
+inline graphlab::edge_dir_type backward_edges() {
+  return DIRECTED ? graphlab::IN_EDGES : graphlab::ALL_EDGES;
+}
+
+/**
+ * \brief The lanes of which the vertex is the source.
+ */
+inline lane_mask source_lanes(graphlab::vertex_id_type vid) {
+  lane_mask mask = 0;
+  for(size_t lane = 0; lane < BATCH_SOURCES.size(); ++lane) {
+    if (BATCH_SOURCES[lane] == vid) mask |= lane_bit(lane);
+  }
+  return mask;
+}
+
+
+struct sum_combine {
+  static void combine(double& a, double b) { a += b; }
+};
+
+struct min_combine {
+  static void combine(double& a, double b) { if (b < a) a = b; }
+};
+
+/**
+ * \brief A value per lane for a subset of the lanes, combined with
+ * Combine. Only the lanes in the mask are serialized.
+ */
+template <typename Combine>
+struct lane_values {
+  lane_mask mask;
+  double value[LANES];
+  lane_values() : mask(0) { }
+
+  void add(size_t lane, double val) {
+    if (mask & lane_bit(lane)) {
+      Combine::combine(value[lane], val);
+    } else {
+      value[lane] = val;
+      mask |= lane_bit(lane);
+    }
+  }
+
+  double get(size_t lane, double otherwise) const {
+    return (mask & lane_bit(lane)) ? value[lane] : otherwise;
+  }
+
+  lane_values& operator+=(const lane_values& other) {
+    lane_mask m = other.mask;
+    while (m) {
+      const size_t lane = pop_lane(m);
+      add(lane, other.value[lane]);
+    }
+    return *this;
+  }
+
+  void save(graphlab::oarchive& oarc) const {
+    oarc << mask;
+    lane_mask m = mask;
+    while (m) oarc << value[pop_lane(m)];
+  }
+
+  void load(graphlab::iarchive& iarc) {
+    iarc >> mask;
+    lane_mask m = mask;
+    while (m) iarc >> value[pop_lane(m)];
+  }
+}; // end of lane_values
+
+typedef lane_values<sum_combine> lane_sums;
+typedef lane_values<min_combine> lane_mins;
+
+
+/**
+ * \brief Multi-source BFS. The message carries, for every lane which
+ * reached the vertex in the previous level, the sum of the path counts
+ * of its predecessors. The sources are initialized before the engine
+ * starts and only expand their frontier in the first iteration.
+ */
+class multi_source_bfs :
+  public graphlab::ivertex_program<graph_type, graphlab::empty, lane_sums> {
+  lane_sums received;
+  lane_mask frontier;
+public:
+  multi_source_bfs() : frontier(0) { }
+
+  void init(icontext_type& context, const vertex_type& vertex,
+            const lane_sums& msg) {
+    received = msg;
+  }
+
+  edge_dir_type gather_edges(icontext_type& context,
+                             const vertex_type& vertex) const {
+    return graphlab::NO_EDGES;
+  }
+
+  /**
+   * \brief The lanes reaching the vertex for the first time join the
+   * frontier.
+   */
+  void apply(icontext_type& context, vertex_type& vertex,
+             const graphlab::empty& empty) {
+    vertex_data& vdata = vertex.data();
+    const double level = context.iteration();
+    if (context.iteration() == 0) {
+      frontier = vdata.seen;
+      vdata.dirty = 0;
+    } else {
+      frontier = received.mask & ~vdata.seen;
+      vdata.dirty = frontier;
+      lane_mask m = frontier;
+      while (m) {
+        const size_t lane = pop_lane(m);
+        vdata.sigma[lane] = received.value[lane];
+        vdata.dist[lane] = level;
+      }
+      vdata.seen |= frontier;
+    }
+    received = lane_sums();
+  }
+
+  edge_dir_type scatter_edges(icontext_type& context,
+                              const vertex_type& vertex) const {
+    return frontier ? forward_edges() : graphlab::NO_EDGES;
+  }
+
+  void scatter(icontext_type& context, const vertex_type& vertex,
+               edge_type& edge) const {
+    const vertex_type other = get_other_vertex(edge, vertex);
+    lane_mask m = frontier & ~other.data().seen;
+    if (m == 0) return;
+    lane_sums msg;
+    while (m) {
+      const size_t lane = pop_lane(m);
+      msg.add(lane, vertex.data().sigma[lane]);
+    }
+    context.signal(other, msg);
+  }
+
+  void save(graphlab::oarchive& oarc) const { oarc << received << frontier; }
+  void load(graphlab::iarchive& iarc) { iarc >> received >> frontier; }
+}; // end of multi_source_bfs
+
+
+/**
+ * \brief Multi-source Bellman-Ford for weighted graphs. The message
+ * carries the shortest candidate distance of every lane.
+ */
+class multi_source_relax :
+  public graphlab::ivertex_program<graph_type, graphlab::empty, lane_mins> {
+  lane_mins received;
+  lane_mask changed;
+public:
+  multi_source_relax() : changed(0) { }
+
+  void init(icontext_type& context, const vertex_type& vertex,
+            const lane_mins& msg) {
+    received = msg;
+  }
+
+  edge_dir_type gather_edges(icontext_type& context,
+                             const vertex_type& vertex) const {
+    return graphlab::NO_EDGES;
+  }
+
+  void apply(icontext_type& context, vertex_type& vertex,
+             const graphlab::empty& empty) {
+    vertex_data& vdata = vertex.data();
+    if (context.iteration() == 0) {
+      changed = vdata.seen;
+    } else {
+      changed = 0;
+      lane_mask m = received.mask;
+      while (m) {
+        const size_t lane = pop_lane(m);
+        if (!(vdata.seen & lane_bit(lane)) ||
+            received.value[lane] < vdata.dist[lane]) {
+          vdata.dist[lane] = received.value[lane];
+          changed |= lane_bit(lane);
+        }
+      }
+      vdata.seen |= changed;
+    }
+    vdata.dirty = changed;
+    received = lane_mins();
+  }
+
+  edge_dir_type scatter_edges(icontext_type& context,
+                              const vertex_type& vertex) const {
+    return changed ? forward_edges() : graphlab::NO_EDGES;
+  }
+
+  void scatter(icontext_type& context, const vertex_type& vertex,
+               edge_type& edge) const {
+    const vertex_type other = get_other_vertex(edge, vertex);
+    const vertex_data& odata = other.data();
+    lane_mins msg;
+    lane_mask m = changed;
+    while (m) {
+      const size_t lane = pop_lane(m);
+      const double newd = vertex.data().dist[lane] + edge.data();
+      if (!(odata.seen & lane_bit(lane)) || newd < odata.dist[lane])
+        msg.add(lane, newd);
+    }
+    if (msg.mask) context.signal(other, msg);
+  }
+
+  void save(graphlab::oarchive& oarc) const { oarc << received << changed; }
+  void load(graphlab::iarchive& iarc) { iarc >> received >> changed; }
+}; // end of multi_source_relax
+
+
+/**
+ * \brief Counts the shortest paths of every lane over the shortest path
+ * DAG once the weighted distances are final. A vertex recomputes its
+ * counts from its predecessors and signals its successors when they
+ * change, so this converges in as many iterations as the DAG is deep.
+ */
+class path_count :
+  public graphlab::ivertex_program<graph_type, lane_sums>,
+  public graphlab::IS_POD_TYPE {
+  lane_mask changed;
+public:
+  edge_dir_type gather_edges(icontext_type& context,
+                             const vertex_type& vertex) const {
+    return backward_edges();
+  }
+
+  lane_sums gather(icontext_type& context, const vertex_type& vertex,
+                   edge_type& edge) const {
+    const vertex_data& vdata = vertex.data();
+    const vertex_data& odata = get_other_vertex(edge, vertex).data();
+    lane_sums sums;
+    lane_mask m = vdata.seen & odata.seen;
+    while (m) {
+      const size_t lane = pop_lane(m);
+      if (on_shortest_path(odata.dist[lane], edge.data(), vdata.dist[lane]))
+        sums.add(lane, odata.sigma[lane]);
+    }
+    return sums;
+  }
+
+  void apply(icontext_type& context, vertex_type& vertex,
+             const lane_sums& total) {
+    vertex_data& vdata = vertex.data();
+    const lane_mask own = source_lanes(vertex.id());
+    changed = 0;
+    lane_mask m = vdata.seen;
+    while (m) {
+      const size_t lane = pop_lane(m);
+      const double sigma = (own & lane_bit(lane)) ? 1 : total.get(lane, 0);
+      if (sigma != vdata.sigma[lane]) {
+        vdata.sigma[lane] = sigma;
+        changed |= lane_bit(lane);
+      }
+    }
+    vdata.dirty = changed;
+  }
+
+  edge_dir_type scatter_edges(icontext_type& context,
+                              const vertex_type& vertex) const {
+    return changed ? forward_edges() : graphlab::NO_EDGES;
+  }
+
+  void scatter(icontext_type& context, const vertex_type& vertex,
+               edge_type& edge) const {
+    const vertex_type other = get_other_vertex(edge, vertex);
+    lane_mask m = changed & other.data().seen;
+    while (m) {
+      const size_t lane = pop_lane(m);
+      if (on_shortest_path(vertex.data().dist[lane], edge.data(),
+                           other.data().dist[lane])) {
+        context.signal(other);
+        return;
+      }
+    }
+  }
+}; // end of path_count
+
+
+/**
+ * \brief The lanes which reached the vertex at the current
+ * DEPENDENCY_LEVEL, or all lanes which reached it if it is negative.
+ */
+inline lane_mask dependency_lanes(const vertex_data& vdata) {
+  if (DEPENDENCY_LEVEL < 0) return vdata.seen;
+  lane_mask mask = 0;
+  lane_mask m = vdata.seen;
+  while (m) {
+    const size_t lane = pop_lane(m);
+    if (vdata.dist[lane] == DEPENDENCY_LEVEL) mask |= lane_bit(lane);
+  }
+  return mask;
+}
+
+/**
+ * \brief Brandes' dependency accumulation
+ *
+ *   delta(v) = sum over successors w of sigma(v) / sigma(w) * (1 + delta(w))
+ *
+ * Unweighted graphs run it once per BFS level, deepest level first, so
+ * every successor is final when it is read. Weighted graphs run it until
+ * no dependency changes, signaling the predecessors of changed vertices.
+ */
+class dependency :
+  public graphlab::ivertex_program<graph_type, lane_sums>,
+  public graphlab::IS_POD_TYPE {
+  lane_mask changed;
+public:
+  edge_dir_type gather_edges(icontext_type& context,
+                             const vertex_type& vertex) const {
+    return forward_edges();
+  }
+
+  lane_sums gather(icontext_type& context, const vertex_type& vertex,
+                   edge_type& edge) const {
+    const vertex_data& vdata = vertex.data();
+    const vertex_data& odata = get_other_vertex(edge, vertex).data();
+    const double length = edge_length(edge);
+    lane_sums sums;
+    lane_mask m = dependency_lanes(vdata) & odata.seen;
+    while (m) {
+      const size_t lane = pop_lane(m);
+      if (on_shortest_path(vdata.dist[lane], length, odata.dist[lane]))
+        sums.add(lane, (1 + odata.delta[lane]) / odata.sigma[lane]);
+    }
+    return sums;
+  }
+
+  void apply(icontext_type& context, vertex_type& vertex,
+             const lane_sums& total) {
+    vertex_data& vdata = vertex.data();
+    changed = 0;
+    lane_mask m = dependency_lanes(vdata);
+    while (m) {
+      const size_t lane = pop_lane(m);
+      const double delta = vdata.sigma[lane] * total.get(lane, 0);
+      if (delta != vdata.delta[lane]) {
+        vdata.delta[lane] = delta;
+        changed |= lane_bit(lane);
+      }
+    }
+    vdata.dirty = changed;
+  }
+
+  edge_dir_type scatter_edges(icontext_type& context,
+                              const vertex_type& vertex) const {
+    return (changed && DEPENDENCY_LEVEL < 0) ?
+        backward_edges() : graphlab::NO_EDGES;
+  }
+
+  void scatter(icontext_type& context, const vertex_type& vertex,
+               edge_type& edge) const {
+    const vertex_type other = get_other_vertex(edge, vertex);
+    lane_mask m = changed & other.data().seen;
+    while (m) {
+      const size_t lane = pop_lane(m);
+      if (on_shortest_path(other.data().dist[lane], edge_length(edge),
+                           vertex.data().dist[lane])) {
+        context.signal(other);
+        return;
+      }
+    }
+  }
+}; // end of dependency
+
+
+/**
+ * \brief Clears the lanes and starts the searches of the batch. Every
+ * replica computes the same values, so unlike transform_vertices this
+ * sends nothing to the mirrors.
+ */
+void start_batch(graph_type& graph) {
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+  for (int i = 0; i < (int)graph.num_local_vertices(); ++i) {
+    vertex_data& vdata = graph.l_vertex(i).data();
+    vdata.seen = source_lanes(graph.global_vid(i));
+    vdata.dirty = 0;
+    for (size_t lane = 0; lane < LANES; ++lane) {
+      vdata.dist[lane] = std::numeric_limits<double>::infinity();
+      vdata.sigma[lane] = 0;
+      vdata.delta[lane] = 0;
+    }
+    lane_mask m = vdata.seen;
+    while (m) {
+      const size_t lane = pop_lane(m);
+      vdata.dist[lane] = 0;
+      vdata.sigma[lane] = 1;
+    }
+  }
+}
+
+/**
+ * \brief Adds the dependencies and distances of the batch to the
+ * totals of the masters. A source does not count itself.
+ */
+void finish_batch(graph_type& graph) {
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+  for (int i = 0; i < (int)graph.num_local_vertices(); ++i) {
+    if (!graph.l_is_master(i)) continue;
+    vertex_data& vdata = graph.l_vertex(i).data();
+    lane_mask m = vdata.seen & ~source_lanes(graph.global_vid(i));
+    while (m) {
+      const size_t lane = pop_lane(m);
+      vdata.betweenness += vdata.delta[lane];
+      vdata.dist_sum += vdata.dist[lane];
+      ++vdata.reached;
+    }
+  }
+}
+
+struct max_distance_type : graphlab::IS_POD_TYPE {
+  double dist;
+  max_distance_type(double dist = 0) : dist(dist) { }
+  max_distance_type& operator+=(const max_distance_type& other) {
+    dist = std::max(dist, other.dist);
+    return *this;
+  }
+};
+
+max_distance_type max_distance(const graph_type::vertex_type& vertex) {
+  max_distance_type ret;
+  lane_mask m = vertex.data().seen;
+  while (m) ret += max_distance_type(vertex.data().dist[pop_lane(m)]);
+  return ret;
+}
+
+bool has_dependency_lanes(const graph_type::vertex_type& vertex) {
+  return dependency_lanes(vertex.data()) != 0;
+}
+
+
+/**
+ * \brief Picks the sources, the same on every machine. If num_samples
+ * is at least the number of vertices every vertex is a source.
+ * Otherwise every master draws a random key, each machine keeps the
+ * num_samples smallest keys of its masters in a bounded max-heap, and
+ * the num_samples smallest keys of their union form a uniform sample.
+ */
+std::vector<graphlab::vertex_id_type>
+sample_sources(graphlab::distributed_control& dc, graph_type& graph,
+               size_t num_samples) {
+  typedef std::pair<double, graphlab::vertex_id_type> key_type;
+  const bool all = num_samples >= graph.num_vertices();
+  std::vector<std::vector<key_type> > keys(dc.numprocs());
+  std::vector<key_type>& heap = keys[dc.procid()];
+  for (size_t i = 0; i < graph.num_local_vertices(); ++i) {
+    if (!graph.l_is_master(i)) continue;
+    if (all) {
+      heap.push_back(key_type(0, graph.global_vid(i)));
+      continue;
+    }
+    const key_type key(graphlab::random::rand01(), graph.global_vid(i));
+    if (heap.size() < num_samples) {
+      heap.push_back(key);
+      std::push_heap(heap.begin(), heap.end());
+    } else if (key < heap.front()) {
+      std::pop_heap(heap.begin(), heap.end());
+      heap.back() = key;
+      std::push_heap(heap.begin(), heap.end());
+    }
+  }
+  dc.all_gather(keys);
+  std::vector<key_type> merged;
+  for (size_t p = 0; p < keys.size(); ++p)
+    merged.insert(merged.end(), keys[p].begin(), keys[p].end());
+  if (!all && merged.size() > num_samples) {
+    std::nth_element(merged.begin(), merged.begin() + num_samples, merged.end());
+    merged.resize(num_samples);
+  }
+  std::vector<graphlab::vertex_id_type> sources(merged.size());
+  for (size_t i = 0; i < merged.size(); ++i) sources[i] = merged[i].second;
+  return sources;
+}
+
+
+/**
+ * \brief Loads graphs in the form 'id (id edge_length)*', like the other
+ * tools of this toolkit.
+ */
+bool line_parser(graph_type& graph, const std::string& filename,
+                 const std::string& textline) {
+  std::stringstream strm(textline);
+  graphlab::vertex_id_type vid;
+  strm >> vid;
+  graph.add_vertex(vid, vertex_data());
+  while(1) {
+    graphlab::vertex_id_type other_vid;
+    double length = 1.0;
+    strm >> other_vid;
+    strm >> length;
+    if (strm.fail()) break;
+    graph.add_edge(vid, other_vid, length);
+  }
+  return true;
+}
+
+
+/**
+ * \brief The scale turning the summed dependencies into betweenness.
+ */
+double BETWEENNESS_SCALE = 1;
+
+struct centrality_writer {
+  std::string save_vertex(const graph_type::vertex_type& vtx) {
+    std::stringstream strm;
+    const vertex_data& vdata = vtx.data();
+    const double closeness = vdata.dist_sum > 0 ? vdata.reached / vdata.dist_sum : 0;
+    strm << vtx.id() << "\t" << BETWEENNESS_SCALE * vdata.betweenness
+         << "\t" << closeness << "\n";
+    return strm.str();
+  }
+  std::string save_edge(graph_type::edge_type e) { return ""; }
+}; // end of centrality_writer
+
+
+int main(int argc, char** argv) {
+  // Initialize control plain using mpi
+  graphlab::mpi_tools::init(argc, argv);
+  graphlab::distributed_control dc;
+  global_logger().set_log_level(LOG_INFO);
+
+  // Parse command line options -----------------------------------------------
+  graphlab::command_line_options
+    clopts("Batched betweenness and closeness centrality.");
+  std::string graph_dir;
+  std::string format;
+  size_t samples = 0;
+  double epsilon = 0;
+  double failure_probability = 0.1;
+  clopts.attach_option("graph", graph_dir, "The graph file. Required ");
+  clopts.add_positional("graph");
+  clopts.attach_option("format", format,
+                       "The graph format. If not set, lines of the form "
+                       "'id (id edge_length)*' are read.");
+  clopts.attach_option("directed", DIRECTED, "Treat edges as directed.");
+  clopts.attach_option("weighted", WEIGHTED,
+                       "Use the edge values as (positive) lengths. "
+                       "Otherwise every edge has length one.");
+  clopts.attach_option("samples", samples,
+                       "The number of sampled sources. If neither samples "
+                       "nor epsilon is set every vertex is a source.");
+  clopts.attach_option("epsilon", epsilon,
+                       "If set, sample enough sources for the normalized "
+                       "betweenness to be within epsilon of the exact value.");
+  clopts.attach_option("delta", failure_probability,
+                       "The probability with which the epsilon bound may fail.");
+  std::string saveprefix;
+  clopts.attach_option("saveprefix", saveprefix,
+                       "If set, will save the betweenness and closeness to a "
+                       "sequence of files with prefix saveprefix");
+
+  if(!clopts.parse(argc, argv)) {
+    dc.cout() << "Error in parsing command line arguments." << std::endl;
+    return EXIT_FAILURE;
+  }
+  if (graph_dir == "") {
+    dc.cout() << "Graph not specified. Cannot continue";
+    return EXIT_FAILURE;
+  }
+
+  // Build the graph ----------------------------------------------------------
+  graph_type graph(dc, clopts);
+  if (format == "") {
+    graph.load(graph_dir, line_parser);
+  } else {
+    if (WEIGHTED) {
+      dc.cout() << "Standard formats carry no edge lengths, ignoring --weighted."
+                << std::endl;
+      WEIGHTED = false;
+    }
+    graph.load_format(graph_dir, format);
+  }
+  graph.finalize();
+  const size_t nverts = graph.num_vertices();
+  dc.cout() << "#vertices: " << nverts << " #edges:" << graph.num_edges()
+            << std::endl;
+
+  // Sample the sources -------------------------------------------------------
+  if (epsilon > 0) {
+    samples = std::ceil(std::log(2.0 * nverts / failure_probability) /
+                        (2 * epsilon * epsilon));
+  }
+  const std::vector<graphlab::vertex_id_type> sources =
+    sample_sources(dc, graph, samples == 0 ? nverts : samples);
+  dc.cout() << "Using " << sources.size() << " sources in batches of "
+            << LANES << std::endl;
+
+  // Run the batches ----------------------------------------------------------
+  graphlab::synchronous_engine<multi_source_bfs> bfs_engine(dc, graph, clopts);
+  graphlab::synchronous_engine<multi_source_relax> relax_engine(dc, graph, clopts);
+  graphlab::synchronous_engine<path_count> path_count_engine(dc, graph, clopts);
+  graphlab::synchronous_engine<dependency> dependency_engine(dc, graph, clopts);
+  graphlab::timer timer;
+  double diameter = 0;
+  for (size_t begin = 0; begin < sources.size(); begin += LANES) {
+    const size_t end = std::min(begin + LANES, sources.size());
+    BATCH_SOURCES.assign(sources.begin() + begin, sources.begin() + end);
+    start_batch(graph);
+
+    if (!WEIGHTED) {
+      bfs_engine.signal_vids(BATCH_SOURCES, lane_sums(), true);
+      bfs_engine.start();
+    } else {
+      relax_engine.signal_vids(BATCH_SOURCES, lane_mins(), true);
+      relax_engine.start();
+      path_count_engine.signal_all();
+      path_count_engine.start();
+    }
+    const double max_dist =
+      graph.map_reduce_vertices<max_distance_type>(max_distance).dist;
+    diameter = std::max(diameter, max_dist);
+
+    if (!WEIGHTED) {
+      // deepest level first; the last level has no successors
+      for (double level = max_dist - 1; level >= 1; --level) {
+        DEPENDENCY_LEVEL = level;
+        dependency_engine.signal_vset(graph.select(has_dependency_lanes));
+        dependency_engine.start();
+      }
+    } else {
+      DEPENDENCY_LEVEL = -1;
+      dependency_engine.signal_all();
+      dependency_engine.start();
+    }
+    finish_batch(graph);
+    dc.cout() << "Finished " << end << " sources in " << timer.current_time()
+              << " seconds." << std::endl;
+  }
+
+  // Report -------------------------------------------------------------------
+  const size_t k = sources.size();
+  BETWEENNESS_SCALE = double(nverts) / k;
+  // every undirected shortest path is found from both of its ends
+  if (!DIRECTED) BETWEENNESS_SCALE /= 2;
+  if (k < nverts) {
+    // Hoeffding and a union bound over all vertices: every dependency lies
+    // in [0, n-2], every distance in [0, diameter]
+    const double eps =
+      std::sqrt(std::log(2.0 * nverts / failure_probability) / (2.0 * k));
+    dc.cout() << "With probability " << 1 - failure_probability
+              << " every betweenness is within "
+              << BETWEENNESS_SCALE * k * (nverts - 2.0) * eps
+              << " (normalized: " << eps << ") and every average distance "
+              << "within " << diameter * eps << " of the exact value."
+              << std::endl;
+  }
+
+  if (saveprefix != "") {
+    graph.save(saveprefix, centrality_writer(),
+               false,  // do not gzip
+               true,   // save vertices
+               false); // do not save edges
+  }
+
+  graphlab::mpi_tools::finalize();
+  return EXIT_SUCCESS;
+}
+
+#include <graphlab/macros_undef.hpp>
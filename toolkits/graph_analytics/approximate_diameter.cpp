@@ -17,258 +17,311 @@
  * For more about this software visit:
  *
  *      http://www.graphlab.ml.cmu.edu
- *
  */
 
 #include <string>
 #include <iostream>
-#include <sstream>
 #include <fstream>
 #include <algorithm>
 #include <vector>
-#include <map>
+#include <cmath>
+#include <cstring>
 #include <time.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #include <graphlab.hpp>
 
-//helper function
-float myrand() {
-  return static_cast<float>(rand() / (RAND_MAX + 1.0));
-}
+/*
+ * HyperANF (Boldi, Rosa and Vigna, 2011). Every vertex keeps a
+ * HyperLogLog counter of the set of vertices it reaches within h hops.
+ * The counter of hop h + 1 is the register-wise maximum of the counter
+ * of the vertex and those of its out-neighbors at hop h, so a hop is a
+ * single gather over out edges. Only vertices with an out-neighbor whose
+ * counter changed in the previous hop are run again. With
+ * --use-sketch=false the counter is an exact bitmask of the reached
+ * vertex ids instead.
+ */
 
-//helper function to return a hash value for Flajolet & Martin bitmask
-size_t hash_value() {
-  size_t ret = 0;
-  while (myrand() < 0.5) {
-    ret++;
-  }
-  return ret;
+// hop currently being computed, the same on all machines
+size_t CURRENT_HOP = 0;
+// seed of the hash of the vertex ids
+size_t HASH_SEED = 0;
+
+// the 64 bit finalizer of MurmurHash3
+inline uint64_t mix(uint64_t k) {
+  k ^= k >> 33;
+  k *= 0xff51afd7ed558ccdULL;
+  k ^= k >> 33;
+  k *= 0xc4ceb9fe1a85ec53ULL;
+  k ^= k >> 33;
+  return k;
 }
 
-const size_t DUPULICATION_OF_BITMASKS = 10;
+/*
+ * A HyperLogLog counter with NREG (a power of two) 8 bit registers
+ * stored inline. A register holds at most 64 - log2(NREG) + 1 < 128,
+ * which merge() relies on.
+ */
+template <size_t NREG>
+struct hll_counter : public graphlab::IS_POD_TYPE {
+  uint8_t reg[NREG];
 
-struct vdata {
-  //use two bitmasks for consistency
-  std::vector<std::vector<bool> > bitmask1;
-  std::vector<std::vector<bool> > bitmask2;
-  //indicate which is the bitmask for reading (or writing)
-  bool odd_iteration;
-  vdata() :
-      bitmask1(), bitmask2(), odd_iteration(true) {
-  }
-  //for exact counting (but needs large memory)
-  void create_bitmask(size_t id) {
-    std::vector<bool> mask1(id + 2, 0);
-    mask1[id] = 1;
-    bitmask1.push_back(mask1);
-    std::vector<bool> mask2(id + 2, 0);
-    mask2[id] = 1;
-    bitmask2.push_back(mask2);
+  hll_counter() { std::memset(reg, 0, NREG); }
+
+  static size_t log2_registers() {
+    size_t b = 0;
+    while ((size_t(1) << b) < NREG) ++b;
+    return b;
   }
-  //for approximate Flajolet & Martin counting
-  void create_hashed_bitmask(size_t id) {
-    for (size_t i = 0; i < DUPULICATION_OF_BITMASKS; ++i) {
-      size_t hash_val = hash_value();
-      std::vector<bool> mask1(hash_val + 2, 0);
-      mask1[hash_val] = 1;
-      bitmask1.push_back(mask1);
-      std::vector<bool> mask2(hash_val + 2, 0);
-      mask2[hash_val] = 1;
-      bitmask2.push_back(mask2);
-    }
+
+  void insert(uint64_t key) {
+    const size_t b = log2_registers();
+    const uint64_t h = mix(key ^ mix(HASH_SEED + 0x9e3779b97f4a7c15ULL));
+    const size_t idx = h >> (64 - b);
+    // position of the first 1 bit in the remaining 64 - b bits
+    const uint64_t rest = (h << b) | (uint64_t(1) << (b - 1));
+    const uint8_t rank = uint8_t(__builtin_clzll(rest) + 1);
+    if (reg[idx] < rank) reg[idx] = rank;
   }
 
-  void save(graphlab::oarchive& oarc) const {
-    size_t num = bitmask1.size();
-    oarc << num;
-    for (size_t a = 0; a < num; ++a) {
-      size_t size = bitmask1[a].size();
-      oarc << size;
-      for (size_t i = 0; i < size; ++i)
-        oarc << (bool)bitmask1[a][i];
-      for (size_t i = 0; i < size; ++i)
-        oarc << (bool)bitmask2[a][i];
+  /*
+   * reg = max(reg, other.reg). Returns true if a register changed.
+   * 16 registers at a time with SSE2, else 8 at a time with broadword
+   * arithmetic: as registers are below 128, ((x | H) - y) & H has the
+   * high bit of a byte set exactly when x >= y, without borrows between
+   * bytes.
+   */
+  bool merge(const hll_counter& other) {
+#if defined(__SSE2__)
+    int unchanged = 0xffff;
+    for (size_t i = 0; i < NREG; i += 16) {
+      const __m128i x = _mm_loadu_si128((const __m128i*)(reg + i));
+      const __m128i y = _mm_loadu_si128((const __m128i*)(other.reg + i));
+      const __m128i m = _mm_max_epu8(x, y);
+      unchanged &= _mm_movemask_epi8(_mm_cmpeq_epi8(m, x));
+      _mm_storeu_si128((__m128i*)(reg + i), m);
     }
-    oarc << odd_iteration;
-  }
-  void load(graphlab::iarchive& iarc) {
-    bitmask1.clear();
-    bitmask2.clear();
-    size_t num = 0;
-    iarc >> num;
-    for (size_t a = 0; a < num; ++a) {
-      size_t size = 0;
-      iarc >> size;
-      std::vector<bool> mask1;
-      for (size_t i = 0; i < size; ++i) {
-        bool element = true;
-        iarc >> element;
-        mask1.push_back(element);
-      }
-      bitmask1.push_back(mask1);
-      std::vector<bool> mask2;
-      for (size_t i = 0; i < size; ++i) {
-        bool element = true;
-        iarc >> element;
-        mask2.push_back(element);
-      }
-      bitmask2.push_back(mask2);
+    return unchanged != 0xffff;
+#else
+    const uint64_t H = 0x8080808080808080ULL;
+    uint64_t changed = 0;
+    for (size_t i = 0; i < NREG; i += 8) {
+      uint64_t x, y;
+      std::memcpy(&x, reg + i, 8);
+      std::memcpy(&y, other.reg + i, 8);
+      const uint64_t x_ge_y = (((x | H) - y) & H) >> 7;
+      const uint64_t mask = x_ge_y * 0xff;
+      const uint64_t m = (x & mask) | (y & ~mask);
+      changed |= m ^ x;
+      std::memcpy(reg + i, &m, 8);
     }
-    iarc >> odd_iteration;
+    return changed != 0;
+#endif
   }
-};
-
-typedef graphlab::distributed_graph<vdata, graphlab::empty> graph_type;
 
-//initialize bitmask
-void initialize_vertex(graph_type::vertex_type& v) {
-  v.data().create_bitmask(v.id());
-}
-//initialize bitmask
-void initialize_vertex_with_hash(graph_type::vertex_type& v) {
-  v.data().create_hashed_bitmask(v.id());
-}
+  hll_counter& operator+=(const hll_counter& other) {
+    merge(other);
+    return *this;
+  }
 
-//helper function to compute bitwise-or
-void bitwise_or(std::vector<std::vector<bool> >& v1,
-    const std::vector<std::vector<bool> >& v2) {
-  for (size_t a = 0; a < v1.size(); ++a) {
-    while (v1[a].size() < v2[a].size()) {
-      v1[a].push_back(false);
-    }
-    for (size_t i = 0; i < v2[a].size(); ++i) {
-      v1[a][i] = v1[a][i] || v2[a][i];
+  // the estimated number of distinct keys inserted
+  double estimate() const {
+    double sum = 0;
+    size_t zeros = 0;
+    for (size_t i = 0; i < NREG; ++i) {
+      sum += std::ldexp(1.0, -int(reg[i]));
+      zeros += (reg[i] == 0);
     }
+    const double m = NREG;
+    double alpha = 0.7213 / (1.0 + 1.079 / m);
+    if (NREG == 16) alpha = 0.673;
+    else if (NREG == 32) alpha = 0.697;
+    else if (NREG == 64) alpha = 0.709;
+    const double e = alpha * m * m / sum;
+    // linear counting for small cardinalities
+    if (e <= 2.5 * m && zeros > 0) return m * std::log(m / zeros);
+    return e;
   }
-}
+};
 
-struct bitmask_gatherer {
-  std::vector<std::vector<bool> > bitmask;
+/*
+ * The exact set of reached vertices as a bitmask over the vertex ids.
+ * This needs (largest id + 1) bits per vertex, so it is only practical
+ * for small graphs.
+ */
+struct bitmask_counter {
+  std::vector<uint64_t> words;
 
-  bitmask_gatherer() :
-    bitmask() {
+  void insert(uint64_t key) {
+    if (words.size() <= key / 64) words.resize(key / 64 + 1, 0);
+    words[key / 64] |= uint64_t(1) << (key % 64);
   }
-  explicit bitmask_gatherer(const std::vector<std::vector<bool> > & in_b) :
-    bitmask(){
-    for(size_t i=0;i<in_b.size();++i){
-      bitmask.push_back(in_b[i]);
+
+  // words |= other.words. Returns true if a bit was set.
+  bool merge(const bitmask_counter& other) {
+    if (words.size() < other.words.size())
+      words.resize(other.words.size(), 0);
+    uint64_t changed = 0;
+    for (size_t i = 0; i < other.words.size(); ++i) {
+      const uint64_t w = words[i] | other.words[i];
+      changed |= w ^ words[i];
+      words[i] = w;
     }
+    return changed != 0;
   }
 
-  //bitwise-or
-  bitmask_gatherer& operator+=(const bitmask_gatherer& other) {
-    bitwise_or(bitmask, other.bitmask);
+  bitmask_counter& operator+=(const bitmask_counter& other) {
+    merge(other);
     return *this;
   }
 
-  void save(graphlab::oarchive& oarc) const {
-    size_t num = bitmask.size();
-    oarc << num;
-    for (size_t a = 0; a < num; ++a) {
-      size_t size = bitmask[a].size();
-      oarc << size;
-      for (size_t i = 0; i < size; ++i)
-        oarc << (bool)bitmask[a][i];
-    }
+  // the number of reached vertices
+  double estimate() const {
+    size_t count = 0;
+    for (size_t i = 0; i < words.size(); ++i)
+      count += __builtin_popcountll(words[i]);
+    return count;
   }
-  void load(graphlab::iarchive& iarc) {
-    bitmask.clear();
-    size_t num = 0;
-    iarc >> num;
-    for (size_t a = 0; a < num; ++a) {
-      size_t size = 0;
-      iarc >> size;
-      std::vector<bool> mask1;
-      for (size_t i = 0; i < size; ++i) {
-        bool element = true;
-        iarc >> element;
-        mask1.push_back(element);
-      }
-      bitmask.push_back(mask1);
-    }
+
+  void save(graphlab::oarchive& oarc) const { oarc << words; }
+  void load(graphlab::iarchive& iarc) { iarc >> words; }
+};
+
+template <typename CounterType>
+struct vdata {
+  CounterType counter;
+  // the last hop in which the counter changed
+  size_t last_changed;
+  vdata() : last_changed(0) { }
+  void save(graphlab::oarchive& oarc) const { oarc << counter << last_changed; }
+  void load(graphlab::iarchive& iarc) { iarc >> counter >> last_changed; }
+};
+
+// the neighborhood function at a hop and the number of changed counters
+struct hop_summary : public graphlab::IS_POD_TYPE {
+  double pairs;
+  size_t changed;
+  hop_summary() : pairs(0), changed(0) { }
+  hop_summary& operator+=(const hop_summary& other) {
+    pairs += other.pairs;
+    changed += other.changed;
+    return *this;
   }
 };
 
-//The next bitmask b(h + 1; i) of i at the hop h + 1 is given as:
-//b(h + 1; i) = b(h; i) BITWISE-OR {b(h; k) | source = i & target = k}.
-class one_hop: public graphlab::ivertex_program<graph_type, bitmask_gatherer>,
-    public graphlab::IS_POD_TYPE {
-public:
-  //gather on out edges
-  edge_dir_type gather_edges(icontext_type& context,
-      const vertex_type& vertex) const {
-    return graphlab::OUT_EDGES;
+template <typename CounterType>
+struct anf {
+  typedef graphlab::distributed_graph<vdata<CounterType>, graphlab::empty>
+    graph_type;
+  typedef CounterType counter_type;
+
+  static void initialize_vertex(typename graph_type::vertex_type& v) {
+    v.data().counter.insert(v.id());
+    v.data().last_changed = 0;
   }
 
-  //for each edge gather the bitmask of the edge
-  bitmask_gatherer gather(icontext_type& context, const vertex_type& vertex,
-      edge_type& edge) const {
-    if (vertex.data().odd_iteration) {
-      return bitmask_gatherer(edge.target().data().bitmask2);
-    } else {
-      return bitmask_gatherer(edge.target().data().bitmask1);
-    }
+  static hop_summary summarize(const typename graph_type::vertex_type& v) {
+    hop_summary s;
+    s.pairs = v.data().counter.estimate();
+    s.changed = (v.data().last_changed == CURRENT_HOP);
+    return s;
   }
 
-  //get bitwise-ORed bitmask and switch bitmasks
-  void apply(icontext_type& context, vertex_type& vertex,
-      const gather_type& total) {
-    if (vertex.data().odd_iteration) {
-      if (total.bitmask.size() > 0)
-        bitwise_or(vertex.data().bitmask1, total.bitmask);
-      vertex.data().odd_iteration = false;
-    } else {
-      if (total.bitmask.size() > 0)
-        bitwise_or(vertex.data().bitmask2, total.bitmask);
-      vertex.data().odd_iteration = true;
+  //The counter c(h + 1; i) of i at the hop h + 1 is given as:
+  //c(h + 1; i) = c(h; i) MAX {c(h; k) | source = i & target = k}.
+  class one_hop :
+      public graphlab::ivertex_program<graph_type, counter_type>,
+      public graphlab::IS_POD_TYPE {
+  public:
+    typedef graphlab::ivertex_program<graph_type, counter_type> base;
+    typedef typename base::icontext_type icontext_type;
+    typedef typename base::vertex_type vertex_type;
+    typedef typename base::edge_type edge_type;
+    typedef typename base::gather_type gather_type;
+    typedef graphlab::edge_dir_type edge_dir_type;
+
+    //gather on out edges
+    edge_dir_type gather_edges(icontext_type& context,
+                               const vertex_type& vertex) const {
+      return graphlab::OUT_EDGES;
     }
-  }
 
-  edge_dir_type scatter_edges(icontext_type& context,
-      const vertex_type& vertex) const {
-    return graphlab::NO_EDGES;
-  }
-  void scatter(icontext_type& context, const vertex_type& vertex,
-      edge_type& edge) const {
-  }
-};
+    //the counter of the target at the previous hop
+    gather_type gather(icontext_type& context, const vertex_type& vertex,
+                       edge_type& edge) const {
+      return edge.target().data().counter;
+    }
 
-//copy the updated bitmask to the other
-void copy_bitmasks(graph_type::vertex_type& vdata) {
-  if (vdata.data().odd_iteration == false) { //odd_iteration has just finished
-    vdata.data().bitmask2 = vdata.data().bitmask1;
-  } else {
-    vdata.data().bitmask1 = vdata.data().bitmask2;
-  }
-}
+    void apply(icontext_type& context, vertex_type& vertex,
+               const gather_type& total) {
+      if (vertex.num_out_edges() > 0 && vertex.data().counter.merge(total))
+        vertex.data().last_changed = CURRENT_HOP;
+    }
 
-//count the number of vertices reached in the current hop
-size_t absolute_vertex_data(const graph_type::vertex_type& vertex) {
-    size_t count = 0;
-    for (size_t i = 0; i < vertex.data().bitmask1[0].size(); ++i)
-      if (vertex.data().bitmask1[0][i])
-        count++;
-    return count;
-}
+    //the vertices pointing to a changed counter run in the next hop
+    edge_dir_type scatter_edges(icontext_type& context,
+                                const vertex_type& vertex) const {
+      return vertex.data().last_changed == CURRENT_HOP ?
+        graphlab::IN_EDGES : graphlab::NO_EDGES;
+    }
 
-//count the number of vertices reached in the current hop with Flajolet & Martin counting method
-size_t approximate_pair_number(std::vector<std::vector<bool> > bitmask) {
-  float sum = 0.0;
-  for (size_t a = 0; a < bitmask.size(); ++a) {
-    for (size_t i = 0; i < bitmask[a].size(); ++i) {
-      if (bitmask[a][i] == 0) {
-        sum += (float) i;
+    void scatter(icontext_type& context, const vertex_type& vertex,
+                 edge_type& edge) const {
+      context.signal(edge.source());
+    }
+  };
+
+  /*
+   * Fills nf with the neighborhood function: nf[h] is the estimated
+   * number of pairs (u, v) with v reachable from u in at most h hops.
+   * Stops when no counter changes, when nf grows by less than a factor
+   * (1 + tol) or after max_hops hops.
+   */
+  static void run(graphlab::distributed_control& dc,
+                  graphlab::command_line_options& clopts,
+                  const std::string& graph_dir, const std::string& format,
+                  float tol, size_t max_hops, std::vector<double>& nf) {
+    graph_type graph(dc, clopts);
+    dc.cout() << "Loading graph in format: "<< format << std::endl;
+    graph.load_format(graph_dir, format);
+    graph.finalize();
+
+    CURRENT_HOP = 0;
+    graph.transform_vertices(initialize_vertex);
+    nf.clear();
+    nf.push_back(graph.template map_reduce_vertices<hop_summary>(summarize).pairs);
+
+    // one hop per start(); the signals of the scatters remain for the next
+    clopts.get_engine_args().set_option("max_iterations", 1);
+    graphlab::synchronous_engine<one_hop> engine(dc, graph, clopts);
+    engine.signal_all();
+    for (CURRENT_HOP = 1; CURRENT_HOP <= max_hops; ++CURRENT_HOP) {
+      engine.start();
+      const hop_summary s =
+        graph.template map_reduce_vertices<hop_summary>(summarize);
+      dc.cout() << CURRENT_HOP << "-th hop: " << size_t(s.pairs)
+                << " vertex pairs are reached\n";
+      if (s.changed == 0 || s.pairs < nf.back() * (1.0 + tol)) {
+        dc.cout() << "converge\n";
         break;
       }
+      nf.push_back(s.pairs);
     }
   }
-  return (size_t) (pow(2.0, sum / (float) (bitmask.size())) / 0.77351);
-}
-//count the number of notes reached in the current hop
-size_t absolute_vertex_data_with_hash(
-    const graph_type::vertex_type& vertex) {
-    size_t count = approximate_pair_number(vertex.data().bitmask1);
-    return count;
+};
+
+/*
+ * The interpolated number of hops within which a fraction alpha of the
+ * reachable pairs are reached.
+ */
+double effective_diameter(const std::vector<double>& nf, double alpha) {
+  const double target = alpha * nf.back();
+  size_t h = 0;
+  while (h < nf.size() && nf[h] < target) ++h;
+  if (h == 0) return 0;
+  return (h - 1) + (target - nf[h - 1]) / (nf[h] - nf[h - 1]);
 }
 
 int main(int argc, char** argv) {
@@ -276,7 +329,6 @@ int main(int argc, char** argv) {
   graphlab::mpi_tools::init(argc, argv);
   graphlab::distributed_control dc;
 
-  std::string datafile;
   float termination_criteria = 0.0001;
   //parse command line
   graphlab::command_line_options clopts(
@@ -285,7 +337,10 @@ int main(int argc, char** argv) {
   std::string graph_dir;
   std::string format = "adj";
   bool use_sketch = true;
-  std::string exec_type = "synchronous";
+  size_t registers = 64;
+  size_t max_hops = 100;
+  double alpha = 0.9;
+  std::string nf_file;
   clopts.attach_option("graph", graph_dir,
                        "The graph file. This is not optional");
   clopts.add_positional("graph");
@@ -294,8 +349,23 @@ int main(int argc, char** argv) {
   clopts.attach_option("tol", termination_criteria,
                        "The permissible change at convergence.");
   clopts.attach_option("use-sketch", use_sketch,
-                       "If true, will use Flajolet & Martin bitmask, "
-                       "which is more compact and faster.");
+                       "If true, will use HyperLogLog counters, which are "
+                       "compact and fast. If false, will count exactly "
+                       "with a bitmask of the vertex ids per vertex.");
+  clopts.attach_option("registers", registers,
+                       "The number of HyperLogLog registers per vertex, a "
+                       "power of two from 16 to 1024. The relative error "
+                       "is about 1.04 / sqrt(registers).");
+  clopts.attach_option("seed", HASH_SEED,
+                       "The seed of the hash of the vertex ids.");
+  clopts.attach_option("max-hops", max_hops,
+                       "The maximum number of hops.");
+  clopts.attach_option("alpha", alpha,
+                       "The fraction of reachable pairs defining the "
+                       "effective diameter.");
+  clopts.attach_option("nf", nf_file,
+                       "If set, the neighborhood function is saved to "
+                       "this file, one line \"hops pairs\" per hop.");
 
   if (!clopts.parse(argc, argv)){
     dc.cout() << "Error in parsing command line arguments." << std::endl;
@@ -306,55 +376,59 @@ int main(int argc, char** argv) {
     return EXIT_FAILURE;
   }
 
-  //load graph
-  graph_type graph(dc, clopts);
-  dc.cout() << "Loading graph in format: "<< format << std::endl;
-  graph.load_format(graph_dir, format);
-  graph.finalize();
-
   time_t start, end;
-  //initialize vertices
   time(&start);
-  if (use_sketch == false)
-    graph.transform_vertices(initialize_vertex);
-  else
-    graph.transform_vertices(initialize_vertex_with_hash);
-
-  graphlab::omni_engine<one_hop> engine(dc, graph, exec_type, clopts);
-
-  //main iteration
-  size_t previous_count = 0;
-  size_t diameter = 0;
-  for (size_t iter = 0; iter < 100; ++iter) {
-    engine.signal_all();
-    engine.start();
-
-    graph.transform_vertices(copy_bitmasks);
-
-    size_t current_count = 0;
-    if (use_sketch == false)
-      current_count = graph.map_reduce_vertices<size_t>(absolute_vertex_data);
-    else
-      current_count = graph.map_reduce_vertices<size_t>(
-          absolute_vertex_data_with_hash);
-    dc.cout() << iter + 1 << "-th hop: " << current_count
-        << " vertex pairs are reached\n";
-    if (iter > 0
-        && (float) current_count
-            < (float) previous_count * (1.0 + termination_criteria)) {
-      diameter = iter;
-      dc.cout() << "converge\n";
+  std::vector<double> nf;
+  if (!use_sketch) {
+    anf<bitmask_counter>::run(dc, clopts, graph_dir, format,
+                              termination_criteria, max_hops, nf);
+  } else {
+    switch (registers) {
+    case 16: anf<hll_counter<16> >::run(dc, clopts, graph_dir, format,
+                                        termination_criteria, max_hops, nf);
+      break;
+    case 32: anf<hll_counter<32> >::run(dc, clopts, graph_dir, format,
+                                        termination_criteria, max_hops, nf);
+      break;
+    case 64: anf<hll_counter<64> >::run(dc, clopts, graph_dir, format,
+                                        termination_criteria, max_hops, nf);
+      break;
+    case 128: anf<hll_counter<128> >::run(dc, clopts, graph_dir, format,
+                                          termination_criteria, max_hops, nf);
+      break;
+    case 256: anf<hll_counter<256> >::run(dc, clopts, graph_dir, format,
+                                          termination_criteria, max_hops, nf);
       break;
+    case 512: anf<hll_counter<512> >::run(dc, clopts, graph_dir, format,
+                                          termination_criteria, max_hops, nf);
+      break;
+    case 1024: anf<hll_counter<1024> >::run(dc, clopts, graph_dir, format,
+                                            termination_criteria, max_hops, nf);
+      break;
+    default:
+      dc.cout() << "--registers must be a power of two from 16 to 1024\n";
+      graphlab::mpi_tools::finalize();
+      return EXIT_FAILURE;
     }
-    previous_count = current_count;
   }
   time(&end);
 
   dc.cout() << "graph calculation time is " << (end - start) << " sec\n";
-  dc.cout() << "The approximate diameter is " << diameter << "\n";
+  dc.cout() << "Neighborhood function:\n";
+  for (size_t h = 0; h < nf.size(); ++h)
+    dc.cout() << h << "\t" << size_t(nf[h]) << "\n";
+  dc.cout() << "The " << (use_sketch ? "approximate " : "")
+            << "diameter is " << nf.size() - 1 << "\n";
+  dc.cout() << "The effective diameter (alpha = " << alpha << ") is "
+            << effective_diameter(nf, alpha) << "\n";
+
+  if (!nf_file.empty() && dc.procid() == 0) {
+    std::ofstream fout(nf_file.c_str());
+    for (size_t h = 0; h < nf.size(); ++h)
+      fout << h << " " << nf[h] << "\n";
+  }
 
   graphlab::mpi_tools::finalize();
 
   return EXIT_SUCCESS;
 }
-
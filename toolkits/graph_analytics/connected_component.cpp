@@ -26,10 +26,13 @@
 #include <vector>
 #include <map>
 #include <boost/unordered_map.hpp>
+#include <boost/unordered_set.hpp>
 #include <time.h>
 
 #include <graphlab.hpp>
 #include <graphlab/graph/distributed_graph.hpp>
+#include <graphlab/util/union_find.hpp>
+#include <graphlab/macros_def.hpp>
 
 struct vdata {
   uint64_t labelid;
@@ -134,6 +137,233 @@ public:
   }
 };
 
+/*
+ * Union-find mode. Instead of propagating labels hop by hop, which takes
+ * as many supersteps as the diameter of the graph:
+ *
+ *  1) each machine runs a union-find over its own edges; every local
+ *     vertex is labeled with the smallest vertex id of its component in
+ *     the local edges,
+ *  2) a single superstep hooks the replicas of each vertex together:
+ *     the master takes the minimum of the local labels of its replicas,
+ *  3) a local component labeled a with a replica whose master took b
+ *     links a and b. The labels and links form a much smaller graph
+ *     whose components are found with rounds of hooking and pointer
+ *     jumping over a forest of labels spread over the machines
+ *     (label_forest). Each round hooks every tree to the smallest tree
+ *     it has a link to and then shortcuts every label to its root, so
+ *     the labels end up as the smallest vertex id of their component.
+ */
+
+// lvid -> the smallest vertex id of its component in the local edges
+std::vector<uint64_t> LOCAL_LABEL;
+
+// label -> the smallest vertex id of its component, for the labels of
+// the local masters
+boost::unordered_map<uint64_t, uint64_t> FINAL_LABEL;
+
+void local_union_find(graph_type& graph) {
+  const size_t n = graph.num_local_vertices();
+  graphlab::concurrent_union_find uf;
+  uf.init(n);
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+  for (size_t i = 0; i < n; ++i) {
+    graph_type::local_vertex_type v = graph.l_vertex(i);
+    foreach(graph_type::local_edge_type e, v.out_edges()) {
+      uf.merge(i, e.target().id());
+    }
+  }
+  LOCAL_LABEL.assign(n, std::numeric_limits<uint64_t>::max());
+  for (size_t i = 0; i < n; ++i) {
+    uint64_t& root_label = LOCAL_LABEL[uf.find(i)];
+    root_label = std::min<uint64_t>(root_label, graph.global_vid(i));
+  }
+  for (size_t i = 0; i < n; ++i) LOCAL_LABEL[i] = LOCAL_LABEL[uf.find(i)];
+}
+
+//the label of a vertex is the smallest local label of its replicas
+class hook_replicas: public graphlab::ivertex_program<graph_type, min_message>,
+    public graphlab::IS_POD_TYPE {
+public:
+  edge_dir_type gather_edges(icontext_type& context,
+      const vertex_type& vertex) const {
+    return graphlab::ALL_EDGES;
+  }
+  //all the local edges of a replica give the same label
+  min_message gather(icontext_type& context, const vertex_type& vertex,
+      edge_type& edge) const {
+    return min_message(LOCAL_LABEL[vertex.local_id()]);
+  }
+  void apply(icontext_type& context, vertex_type& vertex,
+      const gather_type& total) {
+    vertex.data().labelid =
+      std::min<uint64_t>(total.value, LOCAL_LABEL[vertex.local_id()]);
+  }
+  edge_dir_type scatter_edges(icontext_type& context,
+      const vertex_type& vertex) const {
+    return graphlab::NO_EDGES;
+  }
+};
+
+typedef std::pair<uint64_t, uint64_t> link_type;
+
+/*
+ * A forest over the labels of the local components, distributed by
+ * label: the parent of label x is kept by machine x % numprocs, and a
+ * label without an entry is a root. Trees are only hooked below smaller
+ * roots, so the root of a tree is its smallest label.
+ */
+class label_forest {
+  graphlab::dc_dist_object<label_forest> rmi;
+  boost::unordered_map<uint64_t, uint64_t> parent;
+
+  graphlab::procid_t owner(uint64_t label) const {
+    return label % rmi.numprocs();
+  }
+
+  /*
+   * Replaces every label by its parent. Must be called on all machines
+   * simultaneously.
+   */
+  void lookup(std::vector<uint64_t>& labels) {
+    std::vector<std::vector<uint64_t> > requests(rmi.numprocs());
+    for (size_t i = 0; i < labels.size(); ++i)
+      requests[owner(labels[i])].push_back(labels[i]);
+    rmi.all_to_all(requests);
+    for (size_t p = 0; p < requests.size(); ++p) {
+      for (size_t i = 0; i < requests[p].size(); ++i) {
+        boost::unordered_map<uint64_t, uint64_t>::const_iterator iter =
+          parent.find(requests[p][i]);
+        if (iter != parent.end()) requests[p][i] = iter->second;
+      }
+    }
+    rmi.all_to_all(requests);
+    // the replies come back in the order of the requests
+    std::vector<size_t> next(rmi.numprocs(), 0);
+    for (size_t i = 0; i < labels.size(); ++i) {
+      const graphlab::procid_t p = owner(labels[i]);
+      labels[i] = requests[p][next[p]++];
+    }
+  }
+
+  // points every label to its root
+  void pointer_jumping() {
+    while (true) {
+      std::vector<uint64_t> grandparent;
+      for (boost::unordered_map<uint64_t, uint64_t>::const_iterator iter =
+           parent.begin(); iter != parent.end(); ++iter) {
+        grandparent.push_back(iter->second);
+      }
+      lookup(grandparent);
+      size_t changed = 0, i = 0;
+      for (boost::unordered_map<uint64_t, uint64_t>::iterator iter =
+           parent.begin(); iter != parent.end(); ++iter, ++i) {
+        if (iter->second != grandparent[i]) {
+          iter->second = grandparent[i];
+          ++changed;
+        }
+      }
+      rmi.all_reduce(changed);
+      if (changed == 0) break;
+    }
+  }
+
+public:
+  label_forest(graphlab::distributed_control& dc) : rmi(dc, this) {
+    rmi.barrier();
+  }
+
+  /*
+   * Joins the labels of the links of every machine. Each round hooks
+   * the larger end of every link below the smallest root linked to it,
+   * shortcuts the forest and replaces the links by the links between
+   * their roots, dropping those inside a tree. Returns the number of
+   * rounds.
+   */
+  size_t join(std::vector<link_type>& links) {
+    size_t rounds = 0;
+    while (true) {
+      size_t num_links = links.size();
+      rmi.all_reduce(num_links);
+      if (num_links == 0) break;
+      ++rounds;
+      // the ends of the links are roots
+      std::vector<std::vector<link_type> > hooks(rmi.numprocs());
+      for (size_t i = 0; i < links.size(); ++i) {
+        const uint64_t hi = std::max(links[i].first, links[i].second);
+        const uint64_t lo = std::min(links[i].first, links[i].second);
+        hooks[owner(hi)].push_back(link_type(hi, lo));
+      }
+      rmi.all_to_all(hooks);
+      for (size_t p = 0; p < hooks.size(); ++p) {
+        for (size_t i = 0; i < hooks[p].size(); ++i) {
+          uint64_t& root = parent.insert(hooks[p][i]).first->second;
+          root = std::min(root, hooks[p][i].second);
+        }
+      }
+      pointer_jumping();
+      std::vector<uint64_t> ends;
+      ends.reserve(2 * links.size());
+      for (size_t i = 0; i < links.size(); ++i) {
+        ends.push_back(links[i].first);
+        ends.push_back(links[i].second);
+      }
+      lookup(ends);
+      links.clear();
+      for (size_t i = 0; i < ends.size(); i += 2) {
+        if (ends[i] != ends[i + 1])
+          links.push_back(link_type(std::min(ends[i], ends[i + 1]),
+                                    std::max(ends[i], ends[i + 1])));
+      }
+      std::sort(links.begin(), links.end());
+      links.erase(std::unique(links.begin(), links.end()), links.end());
+    }
+    return rounds;
+  }
+
+  /*
+   * Replaces every label by its root, which is the smallest label of
+   * its component once join() has returned.
+   */
+  void find_roots(std::vector<uint64_t>& labels) { lookup(labels); }
+};
+
+/*
+ * Joins the local components through their links and fills FINAL_LABEL
+ * for the labels of the local masters.
+ */
+void join_links(graphlab::distributed_control& dc, graph_type& graph) {
+  boost::unordered_set<link_type> local_links;
+  boost::unordered_set<uint64_t> master_labels;
+  for (size_t i = 0; i < graph.num_local_vertices(); ++i) {
+    const uint64_t label = graph.l_vertex(i).data().labelid;
+    if (LOCAL_LABEL[i] != label) local_links.insert(link_type(LOCAL_LABEL[i], label));
+    if (graph.l_is_master(i)) master_labels.insert(label);
+  }
+  std::vector<link_type> links(local_links.begin(), local_links.end());
+  size_t num_links = links.size();
+  dc.all_reduce(num_links);
+
+  label_forest forest(dc);
+  const size_t rounds = forest.join(links);
+  dc.cout() << num_links << " links between local components joined in "
+            << rounds << " rounds\n";
+
+  std::vector<uint64_t> labels(master_labels.begin(), master_labels.end());
+  std::vector<uint64_t> roots(labels);
+  forest.find_roots(roots);
+  FINAL_LABEL.clear();
+  for (size_t i = 0; i < labels.size(); ++i) FINAL_LABEL[labels[i]] = roots[i];
+}
+
+void finalize_label(graph_type::vertex_type& v) {
+  boost::unordered_map<uint64_t, uint64_t>::const_iterator iter =
+    FINAL_LABEL.find(v.data().labelid);
+  if (iter != FINAL_LABEL.end()) v.data().labelid = iter->second;
+}
+
 class graph_writer {
 public:
   std::string save_vertex(graph_type::vertex_type v) {
@@ -158,6 +388,7 @@ int main(int argc, char** argv) {
   std::string saveprefix;
   std::string format = "adj";
   std::string exec_type = "synchronous";
+  std::string algorithm = "union_find";
   clopts.attach_option("graph", graph_dir,
                        "The graph file. This is not optional");
   clopts.add_positional("graph");
@@ -167,6 +398,10 @@ int main(int argc, char** argv) {
                        "If set, will save the pairs of a vertex id and "
                        "a component id to a sequence of files with prefix "
                        "saveprefix");
+  clopts.attach_option("algorithm", algorithm,
+                       "union_find (default) joins the components of "
+                       "the edges of each machine, label_propagation "
+                       "propagates the smallest vertex id.");
   if (!clopts.parse(argc, argv)) {
     dc.cout() << "Error in parsing command line arguments." << std::endl;
     return EXIT_FAILURE;
@@ -184,14 +419,28 @@ int main(int argc, char** argv) {
   graphlab::timer ti;
   graph.finalize();
   dc.cout() << "Finalization in " << ti.current_time() << std::endl;
-  graph.transform_vertices(initialize_vertex);
 
   //running the engine
-  time_t start, end;
-  graphlab::omni_engine<label_propagation> engine(dc, graph, exec_type, clopts);
-  engine.signal_all();
-  time(&start);
-  engine.start();
+  ti.start();
+  if (algorithm == "union_find") {
+    local_union_find(graph);
+    graphlab::synchronous_engine<hook_replicas> hook_engine(dc, graph, clopts);
+    hook_engine.signal_all();
+    hook_engine.start();
+    join_links(dc, graph);
+    graph.transform_vertices(finalize_label);
+    std::vector<uint64_t>().swap(LOCAL_LABEL);
+    FINAL_LABEL.clear();
+  } else if (algorithm == "label_propagation") {
+    graph.transform_vertices(initialize_vertex);
+    graphlab::omni_engine<label_propagation> engine(dc, graph, exec_type, clopts);
+    engine.signal_all();
+    engine.start();
+  } else {
+    dc.cout() << "--algorithm must be union_find or label_propagation\n";
+    return EXIT_FAILURE;
+  }
+  dc.cout() << "Connected components in " << ti.current_time() << " sec\n";
 
   //write results
   if (saveprefix.size() > 0) {
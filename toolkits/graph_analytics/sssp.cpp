@@ -23,6 +23,9 @@
 #include <vector>
 #include <string>
 #include <fstream>
+#include <cmath>
+#include <map>
+#include <algorithm>
 
 
 #include <graphlab.hpp>
@@ -76,6 +79,52 @@ get_other_vertex(const graph_type::edge_type& edge,
 bool DIRECTED_SSSP = false;
 
 
+/**
+ * \brief The bucket width of delta-stepping. If zero every change of a
+ * distance is relaxed immediately along all edges.
+ */
+distance_type DELTA = 0;
+
+/**
+ * \brief With delta-stepping, the index of the bucket being processed.
+ * Vertices in later buckets keep their new distance but wait for their
+ * bucket before relaxing their edges.
+ */
+size_t CURRENT_BUCKET = 0;
+
+/**
+ * \brief With delta-stepping, whether the heavy edges (weight > DELTA)
+ * of the settled bucket are relaxed instead of the light ones.
+ */
+bool HEAVY_PHASE = false;
+
+/**
+ * \brief With delta-stepping, the local masters whose distance dropped
+ * into a later bucket, by bucket index. A vertex may be listed in
+ * several buckets; it only runs in the one holding its distance.
+ */
+std::map<size_t, std::vector<graphlab::vertex_id_type> > PENDING;
+
+/**
+ * \brief With delta-stepping, the local masters which relaxed their
+ * light edges in the current bucket. Their heavy edges are relaxed
+ * once the bucket is settled.
+ */
+std::vector<graphlab::vertex_id_type> SETTLED;
+
+/**
+ * \brief Protects PENDING and SETTLED, which are filled by apply.
+ */
+graphlab::mutex BUCKET_LOCK;
+
+/**
+ * \brief The delta-stepping bucket of a distance.
+ */
+inline size_t bucket_of(distance_type dist) {
+  return size_t(dist / DELTA);
+}
+
+
 /**
  * \brief This class is used as the gather type.
  */
@@ -136,6 +185,24 @@ public:
     if(vertex.data().dist > min_dist) {
       changed = true;
       vertex.data().dist = min_dist;
+    } else if(DELTA > 0 && context.iteration() == 0) {
+      // delta-stepping signals the vertices of a bucket to relax them.
+      // Skip those which moved to an earlier bucket since being listed.
+      changed = bucket_of(vertex.data().dist) == CURRENT_BUCKET;
+    }
+    if(DELTA > 0 && changed) {
+      // Distances only drop into the current bucket or a later one
+      // since the relaxed vertices are in the current bucket.
+      const size_t bucket = bucket_of(vertex.data().dist);
+      if(bucket != CURRENT_BUCKET) {
+        BUCKET_LOCK.lock();
+        PENDING[bucket].push_back(vertex.id());
+        BUCKET_LOCK.unlock();
+      } else if(!HEAVY_PHASE) {
+        BUCKET_LOCK.lock();
+        SETTLED.push_back(vertex.id());
+        BUCKET_LOCK.unlock();
+      }
     }
   }
 
@@ -144,7 +211,8 @@ public:
    */
   edge_dir_type scatter_edges(icontext_type& context, 
                              const vertex_type& vertex) const {
-    if(changed)
+    if(changed && (DELTA == 0 ||
+                   bucket_of(vertex.data().dist) == CURRENT_BUCKET))
       return DIRECTED_SSSP? graphlab::OUT_EDGES : graphlab::ALL_EDGES; 
     else return graphlab::NO_EDGES;
   }; // end of scatter_edges
@@ -154,6 +222,8 @@ public:
    */
   void scatter(icontext_type& context, const vertex_type& vertex,
                edge_type& edge) const {
+    // delta-stepping relaxes light and heavy edges separately
+    if(DELTA > 0 && (edge.data().dist > DELTA) != HEAVY_PHASE) return;
     const vertex_type other = get_other_vertex(edge, vertex);
     distance_type newd = vertex.data().dist + edge.data().dist;
     if (other.data().dist > newd) {
@@ -200,6 +270,104 @@ max_deg_vertex_reducer find_max_deg_vertex(const graph_type::vertex_type vtx) {
   return red;
 }
 
+
+
+/**
+ * \brief Finds the lowest bucket which has pending vertices on any
+ * machine.
+ */
+struct min_bucket_type : graphlab::IS_POD_TYPE {
+  size_t bucket;
+  min_bucket_type(size_t bucket = size_t(-1)) : bucket(bucket) { }
+  min_bucket_type& operator+=(const min_bucket_type& other) {
+    bucket = std::min(bucket, other.bucket);
+    return *this;
+  }
+};
+
+double edge_weight(const graph_type::edge_type& edge) {
+  return edge.data().dist;
+}
+
+
+/**
+ * \brief Delta-stepping (Meyer and Sanders) on the synchronous engine.
+ *
+ * Distances are grouped in buckets of width DELTA. The vertices of the
+ * current bucket relax their light edges (weight <= DELTA) until the
+ * bucket no longer changes, which settles it. They then relax their
+ * heavy edges once, which can only reach later buckets. A vertex whose
+ * distance drops into a later bucket keeps it and is filed under that
+ * bucket on its machine. The next bucket is the lowest one filed on
+ * any machine. Each phase is a run of the engine which only touches the
+ * vertices of the bucket and their neighbors, so the number of
+ * supersteps per bucket is bounded by the number of light edges on a
+ * shortest path within the bucket instead of the hop count of the
+ * whole graph.
+ */
+void delta_stepping(graphlab::distributed_control& dc,
+                    graph_type& graph,
+                    graphlab::command_line_options& clopts,
+                    const std::vector<unsigned int>& sources) {
+  typedef graphlab::synchronous_engine<sssp> engine_type;
+  engine_type engine(dc, graph, clopts);
+  graphlab::timer timer;
+  size_t nbuckets = 0, nsupersteps = 0;
+  CURRENT_BUCKET = 0;
+  PENDING.clear(); SETTLED.clear();
+  for(size_t i = 0; i < sources.size(); ++i) {
+    engine.signal(sources[i], min_distance_type(0));
+  }
+  while(true) {
+    // light edges until the bucket is settled
+    HEAVY_PHASE = false;
+    engine.start();
+    nsupersteps += engine.iteration();
+    // heavy edges of the settled bucket, once per vertex
+    std::sort(SETTLED.begin(), SETTLED.end());
+    SETTLED.erase(std::unique(SETTLED.begin(), SETTLED.end()), SETTLED.end());
+    HEAVY_PHASE = true;
+    engine.signal_vids(SETTLED, min_distance_type(), true);
+    SETTLED.clear();
+    engine.start();
+    nsupersteps += engine.iteration();
+    ++nbuckets;
+    // agree on the next non-empty bucket
+    min_bucket_type next;
+    if (!PENDING.empty()) next.bucket = PENDING.begin()->first;
+    dc.all_reduce(next);
+    if (next.bucket == size_t(-1)) break;
+    CURRENT_BUCKET = next.bucket;
+    std::vector<graphlab::vertex_id_type> bucket;
+    if (!PENDING.empty() && PENDING.begin()->first == CURRENT_BUCKET) {
+      bucket.swap(PENDING.begin()->second);
+      PENDING.erase(PENDING.begin());
+    }
+    HEAVY_PHASE = false;
+    engine.signal_vids(bucket, min_distance_type(), true);
+  }
+  dc.cout() << "Delta-stepping processed " << nbuckets << " buckets in "
+            << nsupersteps << " supersteps and " << timer.current_time()
+            << " seconds." << std::endl;
+} // end of delta_stepping
+
+
+/**
+ * \brief The distances computed without delta-stepping, by local vertex
+ * id, to check the delta-stepping result against.
+ */
+std::vector<distance_type> REFERENCE_DIST;
+
+void save_reference(graph_type::vertex_type& vtx) {
+  REFERENCE_DIST[vtx.local_id()] = vtx.data().dist;
+  vtx.data() = vertex_data();
+}
+
+size_t count_mismatches(const graph_type::vertex_type& vtx) {
+  return vtx.data().dist != REFERENCE_DIST[vtx.local_id()];
+}
+
+
 int main(int argc, char** argv) {
   // Initialize control plain using mpi
   graphlab::mpi_tools::init(argc, argv);
@@ -233,6 +401,17 @@ int main(int argc, char** argv) {
 
   clopts.attach_option("engine", exec_type, 
                        "The engine type synchronous or asynchronous");
+  bool use_delta_stepping = false;
+  clopts.attach_option("delta_stepping", use_delta_stepping,
+                       "Use delta-stepping on the synchronous engine "
+                       "(for graphs with a large weighted diameter).");
+  clopts.attach_option("delta", DELTA,
+                       "The bucket width of delta-stepping. "
+                       "Defaults to the average edge weight.");
+  bool check = false;
+  clopts.attach_option("check", check,
+                       "With delta_stepping, first run without it and "
+                       "fail if the distances differ.");
  
   
   clopts.attach_option("powerlaw", powerlaw,
@@ -288,19 +467,43 @@ int main(int argc, char** argv) {
 
 
   // Running The Engine -------------------------------------------------------
-  graphlab::omni_engine<sssp> engine(dc, graph, exec_type, clopts);
+  if (use_delta_stepping && check) {
+    DELTA = 0;
+    graphlab::omni_engine<sssp> engine(dc, graph, exec_type, clopts);
+    for(size_t i = 0; i < sources.size(); ++i) {
+      engine.signal(sources[i], min_distance_type(0));
+    }
+    engine.start();
+    REFERENCE_DIST.resize(graph.num_local_vertices());
+    graph.transform_vertices(save_reference);
+  }
+  if (use_delta_stepping) {
+    if (DELTA <= 0) {
+      DELTA = graph.map_reduce_edges<double>(edge_weight) / graph.num_edges();
+      if (!(DELTA > 0)) DELTA = 1;
+      dc.cout() << "Delta-stepping bucket width: " << DELTA << std::endl;
+    }
+    delta_stepping(dc, graph, clopts, sources);
+  } else {
+    DELTA = 0;
+    graphlab::omni_engine<sssp> engine(dc, graph, exec_type, clopts);
 
+    // Signal all the vertices in the source set
+    for(size_t i = 0; i < sources.size(); ++i) {
+      engine.signal(sources[i], min_distance_type(0));
+    }
 
-  
-  // Signal all the vertices in the source set
-  for(size_t i = 0; i < sources.size(); ++i) {
-    engine.signal(sources[i], min_distance_type(0));
+    engine.start();
+    const float runtime = engine.elapsed_seconds();
+    dc.cout() << "Finished Running engine in " << runtime
+              << " seconds." << std::endl;
+  }
+  size_t mismatches = 0;
+  if (use_delta_stepping && check) {
+    mismatches = graph.map_reduce_vertices<size_t>(count_mismatches);
+    dc.cout() << "Delta-stepping distances differ on " << mismatches
+              << " vertices." << std::endl;
   }
-
-  engine.start();
-  const float runtime = engine.elapsed_seconds();
-  dc.cout() << "Finished Running engine in " << runtime
-            << " seconds." << std::endl;
 
 
   // Save the final graph -----------------------------------------------------
@@ -313,7 +516,7 @@ int main(int argc, char** argv) {
 
   // Tear-down communication layer and quit -----------------------------------
   graphlab::mpi_tools::finalize();
-  return EXIT_SUCCESS;
+  return mismatches == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
 } // End of main
 
 
@@ -0,0 +1,470 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+/*
+ * Topic-sensitive PageRank: K PageRank vectors, each teleporting to its
+ * own set of vertices, computed together. The K ranks of a vertex are
+ * stored contiguously as blocks of 8 floats so that the gather and the
+ * apply of all vectors are a few SIMD operations per edge, and one pass
+ * over the graph serves all K vectors. Vectors are masked out once they
+ * converge; a block of 8 vectors is skipped entirely once all of them
+ * have.
+ *
+ * The same update runs either as a vertex program on the synchronous
+ * engine (Jacobi iterations) or as a warp::parfor_all_vertices() sweep
+ * using warp::map_reduce_neighborhood() (Gauss-Seidel like sweeps).
+ */
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <cmath>
+#include <boost/unordered_map.hpp>
+#if defined(__AVX__) || defined(__SSE__)
+#include <immintrin.h>
+#endif
+
+#include <graphlab.hpp>
+#include <graphlab/engine/warp_graph_mapreduce.hpp>
+#include <graphlab/engine/warp_parfor_all_vertices.hpp>
+
+// Global random reset probability
+float RESET_PROB = 0.15;
+
+// A vector has converged when its L1 change in an iteration is below this
+double TOLERANCE = 1.0E-6;
+
+size_t ITERATIONS = 100;
+
+// The number of vectors
+size_t NUM_VECTORS = 0;
+
+static const size_t BLOCK = 8;
+
+// Per lane (vector): the teleport probability of each member of its set
+std::vector<float> TELEPORT;
+// Per lane: 1 while the vector has not converged, else 0
+std::vector<float> LANE_MASK;
+// Per block: whether any of its vectors has not converged
+std::vector<unsigned char> BLOCK_ACTIVE;
+
+// The vectors whose teleport set contains a vertex, read from --topics
+boost::unordered_map<graphlab::vertex_id_type, std::vector<uint32_t> >
+  TOPIC_MEMBERS;
+
+/*
+ * Operations on blocks of 8 floats. The blocks are not assumed to be
+ * aligned as vertex data lives in std::vector.
+ */
+
+// y = a * x
+inline void scale_block(float* y, const float* x, float a) {
+#if defined(__AVX__)
+  _mm256_storeu_ps(y, _mm256_mul_ps(_mm256_loadu_ps(x), _mm256_set1_ps(a)));
+#elif defined(__SSE__)
+  const __m128 va = _mm_set1_ps(a);
+  _mm_storeu_ps(y, _mm_mul_ps(_mm_loadu_ps(x), va));
+  _mm_storeu_ps(y + 4, _mm_mul_ps(_mm_loadu_ps(x + 4), va));
+#else
+  for (size_t i = 0; i < BLOCK; ++i) y[i] = a * x[i];
+#endif
+}
+
+// y += x
+inline void add_block(float* y, const float* x) {
+#if defined(__AVX__)
+  _mm256_storeu_ps(y, _mm256_add_ps(_mm256_loadu_ps(y), _mm256_loadu_ps(x)));
+#elif defined(__SSE__)
+  _mm_storeu_ps(y, _mm_add_ps(_mm_loadu_ps(y), _mm_loadu_ps(x)));
+  _mm_storeu_ps(y + 4, _mm_add_ps(_mm_loadu_ps(y + 4), _mm_loadu_ps(x + 4)));
+#else
+  for (size_t i = 0; i < BLOCK; ++i) y[i] += x[i];
+#endif
+}
+
+// change = mask * (target - rank); rank += change
+inline void masked_update_block(float* rank, float* change,
+                                const float* target, const float* mask) {
+#if defined(__AVX__)
+  const __m256 r = _mm256_loadu_ps(rank);
+  const __m256 c = _mm256_mul_ps(_mm256_loadu_ps(mask),
+                                 _mm256_sub_ps(_mm256_loadu_ps(target), r));
+  _mm256_storeu_ps(change, c);
+  _mm256_storeu_ps(rank, _mm256_add_ps(r, c));
+#elif defined(__SSE__)
+  for (size_t i = 0; i < BLOCK; i += 4) {
+    const __m128 r = _mm_loadu_ps(rank + i);
+    const __m128 c = _mm_mul_ps(_mm_loadu_ps(mask + i),
+                                _mm_sub_ps(_mm_loadu_ps(target + i), r));
+    _mm_storeu_ps(change + i, c);
+    _mm_storeu_ps(rank + i, _mm_add_ps(r, c));
+  }
+#else
+  for (size_t i = 0; i < BLOCK; ++i) {
+    change[i] = mask[i] * (target[i] - rank[i]);
+    rank[i] += change[i];
+  }
+#endif
+}
+
+
+/*
+ * NB blocks of 8 floats, one lane per vector. The lanes of the blocks
+ * which are not active are left untouched by all operations.
+ */
+template <size_t NB>
+struct rank_vector : public graphlab::IS_POD_TYPE {
+  float value[NB * BLOCK];
+
+  rank_vector() { std::fill(value, value + NB * BLOCK, 0.0f); }
+
+  rank_vector& operator+=(const rank_vector& other) {
+    for (size_t b = 0; b < NB; ++b) {
+      if (BLOCK_ACTIVE[b]) add_block(value + b * BLOCK, other.value + b * BLOCK);
+    }
+    return *this;
+  }
+
+  // this = a * x
+  void scale(const rank_vector& x, float a) {
+    for (size_t b = 0; b < NB; ++b) {
+      if (BLOCK_ACTIVE[b]) scale_block(value + b * BLOCK, x.value + b * BLOCK, a);
+    }
+  }
+};
+
+
+template <size_t NB>
+struct vertex_data : public graphlab::HAS_MIRROR_DATA {
+  rank_vector<NB> rank;
+  // the change of each rank in the last iteration
+  rank_vector<NB> change;
+  // the vectors teleporting to this vertex
+  std::vector<uint32_t> topics;
+
+  void save(graphlab::oarchive& oarc) const {
+    oarc << rank << change << topics;
+  }
+  void load(graphlab::iarchive& iarc) {
+    iarc >> rank >> change >> topics;
+  }
+  // mirrors only read the active blocks of the ranks
+  void save_mirror(graphlab::oarchive& oarc) const {
+    for (size_t b = 0; b < NB; ++b) {
+      if (BLOCK_ACTIVE[b]) oarc.write((const char*)(rank.value + b * BLOCK),
+                                      sizeof(float) * BLOCK);
+    }
+  }
+  void load_mirror(graphlab::iarchive& iarc) {
+    for (size_t b = 0; b < NB; ++b) {
+      if (BLOCK_ACTIVE[b]) iarc.read((char*)(rank.value + b * BLOCK),
+                                     sizeof(float) * BLOCK);
+    }
+  }
+};
+
+
+template <size_t NB>
+struct topic_pagerank {
+  typedef vertex_data<NB> vertex_data_type;
+  typedef rank_vector<NB> vector_type;
+  typedef graphlab::distributed_graph<vertex_data_type, graphlab::empty>
+    graph_type;
+  typedef typename graph_type::vertex_type vertex_type;
+  typedef typename graph_type::edge_type edge_type;
+
+  static void init_vertex(vertex_type& vertex) {
+    if (TOPIC_MEMBERS.empty()) {
+      vertex.data().topics.assign(1, vertex.id() % NUM_VECTORS);
+    } else {
+      boost::unordered_map<graphlab::vertex_id_type,
+                           std::vector<uint32_t> >::const_iterator it =
+        TOPIC_MEMBERS.find(vertex.id());
+      if (it != TOPIC_MEMBERS.end()) vertex.data().topics = it->second;
+    }
+  }
+
+  static vector_type count_members(const vertex_type& vertex) {
+    vector_type count;
+    for (size_t i = 0; i < vertex.data().topics.size(); ++i)
+      count.value[vertex.data().topics[i]] = 1;
+    return count;
+  }
+
+  // start from the teleport distribution
+  static void init_rank(vertex_type& vertex) {
+    const std::vector<uint32_t>& topics = vertex.data().topics;
+    for (size_t i = 0; i < topics.size(); ++i)
+      vertex.data().rank.value[topics[i]] = TELEPORT[topics[i]];
+  }
+
+  /*
+   * The new ranks of a vertex from the sum of the ranks of its in
+   * neighbors divided by their out degree. Only the vectors which have
+   * not converged change.
+   */
+  static void update(vertex_data_type& vdata, const vector_type& total) {
+    vector_type target;
+    target.scale(total, 1.0 - RESET_PROB);
+    for (size_t i = 0; i < vdata.topics.size(); ++i)
+      target.value[vdata.topics[i]] += RESET_PROB * TELEPORT[vdata.topics[i]];
+    for (size_t b = 0; b < NB; ++b) {
+      if (!BLOCK_ACTIVE[b]) continue;
+      masked_update_block(vdata.rank.value + b * BLOCK,
+                          vdata.change.value + b * BLOCK,
+                          target.value + b * BLOCK, &LANE_MASK[b * BLOCK]);
+    }
+  }
+
+  static vector_type abs_change(const vertex_type& vertex) {
+    vector_type ret;
+    for (size_t i = 0; i < NB * BLOCK; ++i)
+      ret.value[i] = std::fabs(vertex.data().change.value[i]);
+    return ret;
+  }
+
+  // the synchronous engine vertex program
+  class pagerank :
+    public graphlab::ivertex_program<graph_type, vector_type>,
+    public graphlab::IS_POD_TYPE {
+  public:
+    typedef graphlab::ivertex_program<graph_type, vector_type> base;
+    typedef typename base::icontext_type icontext_type;
+    typedef typename base::gather_type gather_type;
+    typedef graphlab::edge_dir_type edge_dir_type;
+
+    edge_dir_type gather_edges(icontext_type& context,
+                               const vertex_type& vertex) const {
+      return graphlab::IN_EDGES;
+    }
+
+    gather_type gather(icontext_type& context, const vertex_type& vertex,
+                       edge_type& edge) const {
+      gather_type ret;
+      ret.scale(edge.source().data().rank,
+                1.0f / edge.source().num_out_edges());
+      return ret;
+    }
+
+    void apply(icontext_type& context, vertex_type& vertex,
+               const gather_type& total) {
+      update(vertex.data(), total);
+    }
+
+    edge_dir_type scatter_edges(icontext_type& context,
+                                const vertex_type& vertex) const {
+      return graphlab::NO_EDGES;
+    }
+  };
+
+  // the warp update
+  static vector_type warp_map(edge_type edge, vertex_type other) {
+    vector_type ret;
+    ret.scale(other.data().rank, 1.0f / other.num_out_edges());
+    return ret;
+  }
+
+  static void warp_update(vertex_type vertex) {
+    update(vertex.data(),
+           graphlab::warp::map_reduce_neighborhood(vertex, graphlab::IN_EDGES,
+                                                   warp_map));
+  }
+
+  struct pagerank_writer {
+    std::string save_vertex(vertex_type v) {
+      std::stringstream strm;
+      strm << v.id();
+      for (size_t k = 0; k < NUM_VECTORS; ++k)
+        strm << "\t" << v.data().rank.value[k];
+      strm << "\n";
+      return strm.str();
+    }
+    std::string save_edge(edge_type e) { return ""; }
+  };
+
+  static int run(graphlab::distributed_control& dc,
+                 graphlab::command_line_options& clopts,
+                 const std::string& graph_dir, const std::string& format,
+                 const std::string& exec_type,
+                 const std::string& saveprefix) {
+    graph_type graph(dc, clopts);
+    dc.cout() << "Loading graph in format: "<< format << std::endl;
+    graph.load_format(graph_dir, format);
+    graph.finalize();
+    dc.cout() << "#vertices: " << graph.num_vertices()
+              << " #edges:" << graph.num_edges() << std::endl;
+
+    // Teleport sets. Lanes past NUM_VECTORS are always masked out.
+    TELEPORT.assign(NB * BLOCK, 0);
+    LANE_MASK.assign(NB * BLOCK, 0);
+    BLOCK_ACTIVE.assign(NB, 1);
+    graph.transform_vertices(init_vertex);
+    const vector_type count =
+      graph.template map_reduce_vertices<vector_type>(count_members);
+    for (size_t k = 0; k < NUM_VECTORS; ++k) {
+      if (count.value[k] == 0) {
+        dc.cout() << "Vector " << k << " has an empty teleport set\n";
+        continue;
+      }
+      TELEPORT[k] = 1.0 / count.value[k];
+      LANE_MASK[k] = 1;
+    }
+    graph.transform_vertices(init_rank);
+
+    graphlab::timer ti; ti.start();
+    clopts.get_engine_args().set_option("max_iterations", 1);
+    graphlab::synchronous_engine<pagerank>* engine = NULL;
+    if (exec_type == "synchronous")
+      engine = new graphlab::synchronous_engine<pagerank>(dc, graph, clopts);
+
+    size_t iter = 0;
+    for (; iter < ITERATIONS; ++iter) {
+      if (engine) {
+        engine->signal_all();
+        engine->start();
+      } else {
+        graphlab::warp::parfor_all_vertices(graph, warp_update);
+      }
+      // mask out the vectors which converged
+      const vector_type change =
+        graph.template map_reduce_vertices<vector_type>(abs_change);
+      size_t active = 0;
+      for (size_t b = 0; b < NB; ++b) {
+        BLOCK_ACTIVE[b] = 0;
+        for (size_t k = b * BLOCK; k < (b + 1) * BLOCK; ++k) {
+          if (LANE_MASK[k] && change.value[k] < TOLERANCE) LANE_MASK[k] = 0;
+          BLOCK_ACTIVE[b] |= (LANE_MASK[k] != 0);
+          active += (LANE_MASK[k] != 0);
+        }
+      }
+      dc.cout() << "Iteration " << iter + 1 << ": " << active
+                << " vectors not converged\n";
+      if (active == 0) break;
+    }
+    delete engine;
+    dc.cout() << "Finished Running engine in " << ti.current_time()
+              << " seconds." << std::endl;
+
+    // Save the final graph ---------------------------------------------------
+    if (saveprefix != "") {
+      graph.save(saveprefix, pagerank_writer(),
+                 false,    // do not gzip
+                 true,     // save vertices
+                 false);   // do not save edges
+    }
+    return EXIT_SUCCESS;
+  }
+};
+
+
+/*
+ * Reads the teleport sets: line k lists the ids of the vertices of the
+ * teleport set of vector k.
+ */
+size_t load_topics(const std::string& fname) {
+  std::ifstream fin(fname.c_str());
+  std::string line;
+  size_t k = 0;
+  while (std::getline(fin, line)) {
+    std::stringstream strm(line);
+    graphlab::vertex_id_type vid;
+    while (strm >> vid) TOPIC_MEMBERS[vid].push_back(k);
+    ++k;
+  }
+  return k;
+}
+
+
+int main(int argc, char** argv) {
+  // Initialize control plain using mpi
+  graphlab::mpi_tools::init(argc, argv);
+  graphlab::distributed_control dc;
+  global_logger().set_log_level(LOG_INFO);
+
+  // Parse command line options -----------------------------------------------
+  graphlab::command_line_options clopts("Topic-sensitive PageRank algorithm.");
+  std::string graph_dir;
+  std::string format = "adj";
+  std::string exec_type = "synchronous";
+  std::string topics;
+  clopts.attach_option("graph", graph_dir, "The graph file.");
+  clopts.add_positional("graph");
+  clopts.attach_option("format", format,
+                       "The graph file format");
+  clopts.attach_option("engine", exec_type,
+                       "The engine type synchronous or warp");
+  clopts.attach_option("topics", topics,
+                       "The teleport sets, one line of vertex ids per "
+                       "vector.");
+  clopts.attach_option("vectors", NUM_VECTORS,
+                       "If --topics is not set, the number of vectors. "
+                       "Vector k then teleports to the vertices with "
+                       "id = k mod vectors.");
+  clopts.attach_option("tol", TOLERANCE,
+                       "A vector has converged when the L1 norm of its "
+                       "change in an iteration is below tol.");
+  clopts.attach_option("iterations", ITERATIONS,
+                       "The maximum number of iterations.");
+  std::string saveprefix;
+  clopts.attach_option("saveprefix", saveprefix,
+                       "If set, will save the resultant pageranks to a "
+                       "sequence of files with prefix saveprefix");
+
+  if(!clopts.parse(argc, argv)) {
+    dc.cout() << "Error in parsing command line arguments." << std::endl;
+    return EXIT_FAILURE;
+  }
+  if (graph_dir == "") {
+    dc.cout() << "--graph is not optional\n";
+    return EXIT_FAILURE;
+  }
+  if (exec_type != "synchronous" && exec_type != "warp") {
+    dc.cout() << "--engine must be synchronous or warp\n";
+    return EXIT_FAILURE;
+  }
+  if (topics != "") NUM_VECTORS = load_topics(topics);
+  if (NUM_VECTORS == 0 || NUM_VECTORS > 8 * BLOCK) {
+    dc.cout() << "The number of vectors must be from 1 to " << 8 * BLOCK
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  int ret;
+  if (NUM_VECTORS <= BLOCK) {
+    ret = topic_pagerank<1>::run(dc, clopts, graph_dir, format, exec_type,
+                                 saveprefix);
+  } else if (NUM_VECTORS <= 2 * BLOCK) {
+    ret = topic_pagerank<2>::run(dc, clopts, graph_dir, format, exec_type,
+                                 saveprefix);
+  } else if (NUM_VECTORS <= 4 * BLOCK) {
+    ret = topic_pagerank<4>::run(dc, clopts, graph_dir, format, exec_type,
+                                 saveprefix);
+  } else {
+    ret = topic_pagerank<8>::run(dc, clopts, graph_dir, format, exec_type,
+                                 saveprefix);
+  }
+
+  // Tear-down communication layer and quit -----------------------------------
+  graphlab::mpi_tools::finalize();
+  return ret;
+} // End of main
@@ -0,0 +1,290 @@
+/**
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ *
+ */
+
+
+#ifndef BP_SPLASH_ENGINE_HPP
+#define BP_SPLASH_ENGINE_HPP
+
+/**
+ * This file defines a residual splash engine for belief propagation.
+ *
+ * The bp_vertex_program signals its neighbors with the residual
+ * (linf_diff) of the message it just sent them. The splash engine keeps
+ * the largest pending residual of every vertex in a priority queue and
+ * repeatedly
+ *
+ *   -# pops the vertex with the largest residual (the root),
+ *   -# grows a breadth first tree of at most splash_size vertices around
+ *      the root, only adding vertices whose residual exceeds the bound,
+ *   -# updates the tree from the leaves up to the root and then back
+ *      down to the leaves.
+ *
+ * The two sweeps push evidence across the whole tree in one splash,
+ * which is what makes splash BP converge in far fewer updates than
+ * residual BP on large grid-like models. Execution stops once the
+ * largest residual in the queue drops below the bound (or after
+ * max_updates updates).
+ *
+ * The engine runs sequentially on a single machine: bp_vertex_program
+ * updates its neighbors' edges in place, so splashes may not overlap.
+ * For distributed execution use --engine=async --scheduler=priority.
+ *
+ * Engine options (passed with --engine_opts):
+ *   - splash_size (default 100) the maximum number of vertices per splash
+ *   - max_updates (default 0, i.e., unbounded) stop after this many updates
+ *   - bound (default 0) the termination bound on the largest residual
+ */
+
+#include <vector>
+#include <string>
+#include <limits>
+
+#include <boost/unordered_set.hpp>
+
+#include <graphlab/options/graphlab_options.hpp>
+#include <graphlab/rpc/dc.hpp>
+#include <graphlab/vertex_program/icontext.hpp>
+#include <graphlab/util/mutable_queue.hpp>
+#include <graphlab/util/timer.hpp>
+#include <graphlab/logger/logger.hpp>
+
+#include <graphlab/macros_def.hpp>
+
+namespace belief_prop {
+
+
+template<typename VertexProgram>
+class bp_splash_engine {
+public:
+  typedef VertexProgram                             vertex_program_type;
+  typedef typename VertexProgram::graph_type        graph_type;
+  typedef typename VertexProgram::gather_type       gather_type;
+  typedef typename VertexProgram::message_type      message_type;
+  typedef typename VertexProgram::icontext_type     icontext_type;
+  typedef typename graph_type::vertex_type          vertex_type;
+  typedef typename graph_type::edge_type            edge_type;
+  typedef typename graph_type::local_vertex_type    local_vertex_type;
+  typedef typename graph_type::local_edge_type      local_edge_type;
+
+private:
+  typedef graphlab::mutable_queue<graphlab::lvid_type, double> queue_type;
+
+  /**
+   * The context handed to the vertex program. Signals raise the
+   * residual of the target vertex to the priority of the message.
+   */
+  class context_type : public icontext_type {
+    bp_splash_engine& engine;
+  public:
+    context_type(bp_splash_engine& engine) : engine(engine) { }
+    size_t num_vertices() const { return engine.graph.num_vertices(); }
+    size_t num_edges() const { return engine.graph.num_edges(); }
+    size_t procid() const { return engine.rmi.procid(); }
+    size_t num_procs() const { return engine.rmi.numprocs(); }
+    float elapsed_seconds() const { return engine.timer.current_time(); }
+    void stop() { engine.stop_requested = true; }
+    void signal(const vertex_type& vertex,
+                const message_type& message = message_type()) {
+      engine.raise_residual(vertex.lvid, message.priority());
+    }
+    void signal_vid(graphlab::vertex_id_type gvid,
+                    const message_type& message = message_type()) {
+      if(engine.graph.is_master(gvid)) {
+        engine.raise_residual(engine.graph.local_vid(gvid), message.priority());
+      }
+    }
+  }; // end of class context_type
+
+  graphlab::distributed_control& rmi;
+  graph_type& graph;
+  size_t splash_size;
+  size_t max_updates;
+  double bound;
+
+  /** the largest pending residual of each local vertex */
+  std::vector<double> residual;
+  /** residual ordered queue of the vertices. Updated vertices are kept with
+   * a zero priority rather than removed */
+  queue_type queue;
+  size_t nupdates;
+  bool stop_requested;
+  graphlab::timer timer;
+  float runtime;
+
+public:
+  bp_splash_engine(graphlab::distributed_control& dc, graph_type& graph,
+                   const graphlab::graphlab_options& opts) :
+      rmi(dc), graph(graph), splash_size(100), max_updates(0), bound(0),
+      nupdates(0), stop_requested(false), runtime(0) {
+    if(dc.numprocs() > 1) {
+      logstream(LOG_FATAL) << "The splash engine runs on a single machine. "
+          << "Use --engine=async --scheduler=priority instead." << std::endl;
+    }
+    std::vector<std::string> keys = opts.get_engine_args().get_option_keys();
+    foreach(std::string opt, keys) {
+      if (opt == "splash_size") {
+        opts.get_engine_args().get_option("splash_size", splash_size);
+        logstream(LOG_EMPH) << "Engine Option: splash_size = " << splash_size << std::endl;
+      } else if (opt == "max_updates") {
+        opts.get_engine_args().get_option("max_updates", max_updates);
+        logstream(LOG_EMPH) << "Engine Option: max_updates = " << max_updates << std::endl;
+      } else if (opt == "bound") {
+        opts.get_engine_args().get_option("bound", bound);
+        logstream(LOG_EMPH) << "Engine Option: bound = " << bound << std::endl;
+      } else {
+        logstream(LOG_FATAL) << "Unexpected Engine Option: " << opt << std::endl;
+      }
+    }
+    ASSERT_GT(splash_size, 0);
+    residual.resize(graph.num_local_vertices(), 0);
+  }
+
+  /** Schedules every vertex with an infinite residual */
+  void signal_all() {
+    for(graphlab::lvid_type lvid = 0; lvid < graph.num_local_vertices(); ++lvid) {
+      raise_residual(lvid, std::numeric_limits<double>::max());
+    }
+  }
+
+  void signal(graphlab::vertex_id_type gvid,
+              const message_type& message = message_type()) {
+    context_type context(*this);
+    context.signal_vid(gvid, message);
+  }
+
+  /** Runs splashes until the largest residual is below the bound */
+  void start() {
+    timer.start();
+    stop_requested = false;
+    context_type context(*this);
+    std::vector<graphlab::lvid_type> splash;
+    while(!stop_requested && !queue.empty() && queue.top().second > bound) {
+      build_splash(queue.top().first, splash);
+      // push evidence up to the root...
+      for(size_t i = splash.size(); i > 0 && !done(); --i) {
+        update(context, splash[i-1]);
+      }
+      // ...and back out to the leaves
+      for(size_t i = 1; i < splash.size() && !done(); ++i) {
+        update(context, splash[i]);
+      }
+      if(done()) break;
+    }
+    runtime = timer.current_time();
+    logstream(LOG_INFO) << "Splash engine finished after " << nupdates
+        << " updates with largest residual " << max_residual() << std::endl;
+  }
+
+  size_t num_updates() const { return nupdates; }
+  float elapsed_seconds() const { return runtime; }
+
+  /** the largest residual still pending */
+  double max_residual() const {
+    return queue.empty() ? 0 : queue.top().second;
+  }
+
+private:
+  bool done() const {
+    return stop_requested || (max_updates > 0 && nupdates >= max_updates);
+  }
+
+  void raise_residual(graphlab::lvid_type lvid, double value) {
+    if(value > residual[lvid]) {
+      residual[lvid] = value;
+      queue.push_or_update(lvid, value);
+    }
+  }
+
+  /** Breadth first search from the root over vertices above the bound */
+  void build_splash(graphlab::lvid_type root,
+                    std::vector<graphlab::lvid_type>& splash) {
+    splash.clear();
+    splash.push_back(root);
+    boost::unordered_set<graphlab::lvid_type> visited;
+    visited.insert(root);
+    for(size_t head = 0;
+        head < splash.size() && splash.size() < splash_size; ++head) {
+      local_vertex_type lvertex = graph.l_vertex(splash[head]);
+      foreach(local_edge_type edge, lvertex.in_edges()) {
+        visit(edge.source().id(), visited, splash);
+      }
+      foreach(local_edge_type edge, lvertex.out_edges()) {
+        visit(edge.target().id(), visited, splash);
+      }
+    }
+  }
+
+  void visit(graphlab::lvid_type lvid,
+             boost::unordered_set<graphlab::lvid_type>& visited,
+             std::vector<graphlab::lvid_type>& splash) {
+    if(splash.size() >= splash_size || residual[lvid] <= bound) return;
+    if(visited.insert(lvid).second) splash.push_back(lvid);
+  }
+
+  /** Runs the vertex program once on the vertex */
+  void update(context_type& context, graphlab::lvid_type lvid) {
+    // the program may signal this vertex again during scatter
+    const message_type message(residual[lvid]);
+    residual[lvid] = 0;
+    queue.push_or_update(lvid, 0);
+
+    vertex_type vertex(graph, lvid);
+    local_vertex_type lvertex(graph, lvid);
+    vertex_program_type vprog;
+    vprog.init(context, vertex, message);
+
+    const graphlab::edge_dir_type gather_dir = vprog.gather_edges(context, vertex);
+    gather_type accum;
+    bool accum_is_set = false;
+    if(gather_dir == graphlab::IN_EDGES || gather_dir == graphlab::ALL_EDGES) {
+      foreach(local_edge_type local_edge, lvertex.in_edges()) {
+        edge_type edge(local_edge);
+        if(accum_is_set) accum += vprog.gather(context, vertex, edge);
+        else { accum = vprog.gather(context, vertex, edge); accum_is_set = true; }
+      }
+    }
+    if(gather_dir == graphlab::OUT_EDGES || gather_dir == graphlab::ALL_EDGES) {
+      foreach(local_edge_type local_edge, lvertex.out_edges()) {
+        edge_type edge(local_edge);
+        if(accum_is_set) accum += vprog.gather(context, vertex, edge);
+        else { accum = vprog.gather(context, vertex, edge); accum_is_set = true; }
+      }
+    }
+    vprog.apply(context, vertex, accum);
+
+    const graphlab::edge_dir_type scatter_dir = vprog.scatter_edges(context, vertex);
+    if(scatter_dir == graphlab::IN_EDGES || scatter_dir == graphlab::ALL_EDGES) {
+      foreach(local_edge_type local_edge, lvertex.in_edges()) {
+        edge_type edge(local_edge);
+        vprog.scatter(context, vertex, edge);
+      }
+    }
+    if(scatter_dir == graphlab::OUT_EDGES || scatter_dir == graphlab::ALL_EDGES) {
+      foreach(local_edge_type local_edge, lvertex.out_edges()) {
+        edge_type edge(local_edge);
+        vprog.scatter(context, vertex, edge);
+      }
+    }
+    ++nupdates;
+  }
+}; // end of class bp_splash_engine
+
+
+} // end of namespace belief_prop
+
+#include <graphlab/macros_undef.hpp>
+
+#endif // BP_SPLASH_ENGINE_HPP
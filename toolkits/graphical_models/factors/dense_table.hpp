@@ -420,13 +420,37 @@ namespace graphlab {
     inline dense_table_impl& for_each_assignment(const dense_table_impl& other, 
         const Func& f) {
       //ASSERT_TRUE(is_finite());
+      if(_data.empty()) return *this;
       if(args() == other.args()) {
         DCHECK_EQ(size(), other.size());
         // More verctorizable version
-        for(size_t i = 0; i < size(); ++i) {
-          double val = f(logP(i), other.logP(i));
-          set_logP( i, val );
-          //logP(i) -= other.logP(i);
+        const size_t n = _data.size();
+        double* data = &_data[0];
+        const double* other_data = &other._data[0];
+        for(size_t i = 0; i < n; ++i) {
+          data[i] = std::max(f(data[i], other_data[i]), APPROX_LOG_ZERO());
+        }
+      } else if(other.num_vars() == 1 && 
+                args().var_location(other.args().var(0)) < num_vars()) {
+        // Broadcasting a unary table (e.g., a message) across the domain.
+        // Since the variable with the lowest id iterates fastest, every 
+        // value of the message covers a contiguous run of 'stride' 
+        // entries, which avoids building an assignment per entry.
+        const size_t location = args().var_location(other.args().var(0));
+        size_t stride = 1;
+        for(size_t i = 0; i < location; ++i) stride *= args().var(i).size();
+        const size_t arity = other.size();
+        const size_t n = _data.size();
+        double* data = &_data[0];
+        const double* other_data = &other._data[0];
+        for(size_t block = 0; block < n; block += stride * arity) {
+          for(size_t k = 0; k < arity; ++k) {
+            const double val = other_data[k];
+            double* run = data + block + k * stride;
+            for(size_t i = 0; i < stride; ++i) {
+              run[i] = std::max(f(run[i], val), APPROX_LOG_ZERO());
+            }
+          }
         }
       } else { 
         // other domain must be a subset of this domain
@@ -25,6 +25,7 @@
  * belief propagation in a factor graph to denoise a synthetic noisy image.
  *
  * ./denoise --damping=.3 --ncpus=4 
+ * ./denoise --damping=.3 --engine=splash --engine_opts="splash_size=100"
  *
  *  \author Scott Richardson 
  *          based on toolkits/graphical_models/deprecated/loopybp_denoise.cpp
@@ -54,6 +55,7 @@
 // #include "image.hpp"
 #include <factors/factor_graph.hpp>
 #include <factors/bp_vertex_program.hpp>
+#include <factors/bp_splash_engine.hpp>
 
 // Include the macro for each operation
 #include <graphlab/macros_def.hpp>
@@ -305,7 +307,7 @@ int setup_cli(graphlab::command_line_options& clopts, clopts_vals& clvals,
 //  clopts.attach_option("beliefs", &beliefs_filename,
 //                       "The file to save the belief predictions"); 
   clopts.attach_option("engine", clvals.exec_type,
-                       "The type of engine to use {async, sync}.");
+                       "The type of engine to use {async, sync, splash}.");
   clopts.set_scheduler_type("fifo");
 
 
@@ -333,15 +335,29 @@ void run_engine(graphlab::distributed_control& dc,
 
   // Create the engine -------------------------------------------------------->
   std::cout << "Creating the engine. " << std::endl;
-  typedef graphlab::omni_engine<belief_prop::bp_vertex_program<MAX_DIM> > engine_type;
-  engine_type engine(dc, graph, exec_type, clopts);
-
-  std::cout << "Scheduling all vertices" << std::endl;
-  engine.signal_all();
-  std::cout << "Starting the engine" << std::endl;
-  engine.start();
-  const float runtime = engine.elapsed_seconds();
-  size_t update_count = engine.num_updates();
+  float runtime = 0;
+  size_t update_count = 0;
+  if(exec_type == "splash") {
+    typedef belief_prop::bp_splash_engine<belief_prop::bp_vertex_program<MAX_DIM> > engine_type;
+    engine_type engine(dc, graph, clopts);
+
+    std::cout << "Scheduling all vertices" << std::endl;
+    engine.signal_all();
+    std::cout << "Starting the engine" << std::endl;
+    engine.start();
+    runtime = engine.elapsed_seconds();
+    update_count = engine.num_updates();
+  } else {
+    typedef graphlab::omni_engine<belief_prop::bp_vertex_program<MAX_DIM> > engine_type;
+    engine_type engine(dc, graph, exec_type, clopts);
+
+    std::cout << "Scheduling all vertices" << std::endl;
+    engine.signal_all();
+    std::cout << "Starting the engine" << std::endl;
+    engine.start();
+    runtime = engine.elapsed_seconds();
+    update_count = engine.num_updates();
+  }
   std::cout << "Finished Running engine in " << runtime 
             << " seconds with " << clopts.get_ncpus() << " cpus." << std::endl
             << "Total updates: " << update_count << std::endl
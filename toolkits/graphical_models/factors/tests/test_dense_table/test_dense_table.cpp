@@ -200,6 +200,13 @@ void multiplyTest(unsigned v0_id, unsigned v1_id, unsigned v2_id)
     assignment_t msg_asg = dt_asg.restrict(msg.domain());
     ASSERT_EQ(dt.logP(dt_asg), dt_gm.logP(dt_asg)+msg.logP(msg_asg));
   }
+
+  // dividing the message back out recovers the original table
+  dt /= msg;
+  for(size_t i=0; i < dt.size(); ++i) {
+    assignment_t dt_asg(dt.domain(), i);
+    ASSERT_EQ(dt.logP(dt_asg), dt_gm.logP(dt_asg));
+  }
 }
 
 int main() {
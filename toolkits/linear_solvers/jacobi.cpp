@@ -24,6 +24,19 @@
  * A assumed to be full column rank.  Algorithm is described
  * http://en.wikipedia.org/wiki/Jacobi_method
  * Written by Danny Bickson 
+ *
+ * Additional solvers (--solver):
+ *  gauss_seidel - asynchronous Gauss-Seidel on the asynchronous engine. A vertex
+ *                 which changed by more than tol signals the rows depending on it.
+ *  chebyshev    - Chebyshev acceleration of Jacobi. The spectral radius of the
+ *                 Jacobi iteration matrix is estimated from the decay of the
+ *                 first Jacobi steps. Assumes the Jacobi iteration matrix has a
+ *                 real spectrum (e.g. A symmetric positive definite).
+ *  cg           - Jacobi preconditioned conjugate gradient, A has to be
+ *                 symmetric positive definite.
+ * http://en.wikipedia.org/wiki/Gauss-Seidel_method
+ * http://en.wikipedia.org/wiki/Chebyshev_iteration
+ * http://en.wikipedia.org/wiki/Conjugate_gradient_method
  */
 #include "../collaborative_filtering/eigen_wrapper.hpp"
 #include "../collaborative_filtering/types.hpp"
@@ -38,9 +51,18 @@ enum jacobi_fields{
   JACOBI_REAL_X = 1,
   JACOBI_Y = 2,
   JACOBI_PREV_X = 3,
-  JACOBI_PREC = 4
+  JACOBI_PREC = 4,
+  JACOBI_R = 5,          //cg residual
+  JACOBI_P = 6,          //cg search direction
+  JACOBI_Q = 7,          //cg A*p, chebyshev jacobi step
+  JACOBI_CHEB_PREV = 8,  //chebyshev previous iterate
+  JACOBI_UPDATES = 9,    //gauss seidel updates of this vertex
+  JACOBI_SLOTS = 10
 };
 
+//number of jacobi steps used for estimating the spectral radius
+const int CHEB_WARMUP = 5;
+
 int actual_vector_len = 5;
 int data_size = 5;
 bool final_residual = true;
@@ -53,6 +75,9 @@ int max_iter = 10;
 double tol = 1e-5;
 int quiet = 0;
 int unittest = 0;
+std::string solver = "jacobi";
+double cheb_omega = 1;
+double cg_alpha = 0, cg_beta = 0;
 
 struct vertex_data {
   vec pvec;
@@ -180,6 +205,109 @@ inline bool graph_loader(graph_type& graph,
 typedef graphlab::omni_engine<Axb> engine_type;
 engine_type * pengine = NULL;
 
+/**
+ * Asynchronous Gauss-Seidel: every update solves row i for x_i using the
+ * latest values of its neighbors, and signals the rows depending on x_i
+ * with the size of the change as priority.
+ */
+class gauss_seidel :
+  public graphlab::ivertex_program<graph_type, double,
+                                   graphlab::messages::max_priority>,
+  public graphlab::IS_POD_TYPE {
+    double change;
+    public:
+    gauss_seidel() : change(0) { }
+
+    edge_dir_type gather_edges(icontext_type& context,
+        const vertex_type& vertex) const {
+      return OUT_EDGES;
+    }
+
+    double gather(icontext_type& context, const vertex_type& vertex,
+        edge_type& edge) const {
+      if (edge.data().role == edge_data::PREDICT)
+        return 0;
+      return edge.data().obs * edge.target().data().pvec[JACOBI_X];
+    }
+
+    void apply(icontext_type& context, vertex_type& vertex,
+        const double& total) {
+      vertex_data & user = vertex.data();
+      if (user.pvec[JACOBI_UPDATES] >= max_iter){
+        change = 0;
+        return;
+      }
+      const double x = (user.pvec[JACOBI_Y] - total) / (user.A_ii + regularization);
+      change = fabs(x - user.pvec[JACOBI_X]);
+      user.pvec[JACOBI_PREV_X] = user.pvec[JACOBI_X];
+      user.pvec[JACOBI_X] = x;
+      user.pvec[JACOBI_UPDATES]++;
+    }
+
+    edge_dir_type scatter_edges(icontext_type& context,
+        const vertex_type& vertex) const {
+      return change > tol ? IN_EDGES : NO_EDGES;
+    }
+
+    void scatter(icontext_type& context, const vertex_type& vertex,
+        edge_type& edge) const {
+      if (edge.data().role == edge_data::PREDICT)
+        return;
+      context.signal(edge.source(),
+          graphlab::messages::max_priority(change * fabs(edge.data().obs)));
+    }
+};
+
+/* squared size of the last jacobi step q - x */
+gather_type cheb_step(const graph_type::vertex_type & vertex){
+  gather_type ret;
+  const vec & pvec = vertex.data().pvec;
+  ret.training_rmse = pow(pvec[JACOBI_Q] - pvec[JACOBI_X], 2);
+  return ret;
+}
+
+/* x_{k+1} = omega*(q - x_{k-1}) + x_{k-1} where q is the jacobi step from x_k */
+void cheb_update(graph_type::vertex_type & vertex){
+  vec & pvec = vertex.data().pvec;
+  const double x = cheb_omega * (pvec[JACOBI_Q] - pvec[JACOBI_CHEB_PREV]) + pvec[JACOBI_CHEB_PREV];
+  pvec[JACOBI_CHEB_PREV] = pvec[JACOBI_X];
+  pvec[JACOBI_X] = x;
+}
+
+/* inverse of the jacobi preconditioner, matches the diagonal used by Axb */
+inline double cg_precond(const vertex_data & data){
+  return 1.0 / (data.A_ii + regularization);
+}
+
+gather_type cg_pq(const graph_type::vertex_type & vertex){
+  gather_type ret;
+  const vec & pvec = vertex.data().pvec;
+  ret.training_rmse = pvec[JACOBI_P] * pvec[JACOBI_Q];
+  return ret;
+}
+
+/* x += alpha*p, r -= alpha*q */
+void cg_step(graph_type::vertex_type & vertex){
+  vec & pvec = vertex.data().pvec;
+  pvec[JACOBI_X] += cg_alpha * pvec[JACOBI_P];
+  pvec[JACOBI_R] -= cg_alpha * pvec[JACOBI_Q];
+}
+
+/* returns r'r in training_rmse and r'M^-1r in validation_rmse */
+gather_type cg_residual(const graph_type::vertex_type & vertex){
+  gather_type ret;
+  const double r = vertex.data().pvec[JACOBI_R];
+  ret.training_rmse = r * r;
+  ret.validation_rmse = r * r * cg_precond(vertex.data());
+  return ret;
+}
+
+/* p = M^-1 r + beta*p */
+void cg_direction(graph_type::vertex_type & vertex){
+  vec & pvec = vertex.data().pvec;
+  pvec[JACOBI_P] = pvec[JACOBI_R] * cg_precond(vertex.data()) + cg_beta * pvec[JACOBI_P];
+}
+
 struct linear_model_saver {
   typedef graph_type::vertex_type vertex_type;
   typedef graph_type::edge_type   edge_type;
@@ -228,6 +356,8 @@ int main(int argc, char** argv) {
   clopts.attach_option("rows", rows, "number of rows");
   clopts.attach_option("cols", cols, "number of cols");
   clopts.attach_option("quiet", quiet, "quiet mode (less verbose)");
+  clopts.attach_option("solver", solver,
+      "jacobi, gauss_seidel, chebyshev or cg");
   if(!clopts.parse(argc, argv) || input_dir == "") {
     std::cout << "Error in parsing command line arguments." << std::endl;
     clopts.print_description();
@@ -240,6 +370,11 @@ int main(int argc, char** argv) {
 
   if (rows <= 0 || cols <= 0 || rows != cols)
     logstream(LOG_FATAL)<<"Please specify number of rows/cols of the input matrix" << std::endl;
+  if (solver != "jacobi" && solver != "gauss_seidel" && solver != "chebyshev" && solver != "cg")
+    logstream(LOG_FATAL)<<"Unknown solver: " << solver << std::endl;
+  //the additional solvers keep their state in the vertex data
+  if (solver != "jacobi")
+    data_size = JACOBI_SLOTS;
     
  
   info.rows = rows;
@@ -306,6 +441,8 @@ int main(int argc, char** argv) {
   }  
 
   dc.cout() << "Running Jacobi" << std::endl;
+  if (solver != "jacobi")
+    dc.cout() << "Solver: " << solver << std::endl;
   dc.cout() << "(C) Code by Danny Bickson, CMU " << std::endl;
   dc.cout() << "Please send bug reports to danny.bickson@gmail.com" << std::endl;
   timer.start();
@@ -318,14 +455,107 @@ int main(int argc, char** argv) {
   PRINT_VEC(b);
   PRINT_VEC(x);
   PRINT_VEC(A_ii);
-  for (int i=0; i < max_iter; i++){
-    mi.use_diag = false;
-    x = (b - A*x)/A_ii;
+  size_t gs_updates = 0;
+  int iterations = 0;
+  if (solver == "gauss_seidel"){
+    graphlab::omni_engine<gauss_seidel> gs_engine(dc, graph, "asynchronous", clopts);
+    gs_engine.signal_all();
+    gs_engine.start();
+    gs_updates = gs_engine.num_updates();
     PRINT_VEC(x);
   }
+  else if (solver == "chebyshev"){
+    DistVec q(info, JACOBI_Q, true, "q");
+    double rho = 0, prev_step = 0, min_step = 0;
+    int warmup = CHEB_WARMUP, cheb_steps = 0;
+    for (; iterations < max_iter; iterations++){
+      mi.use_diag = false;
+      q = (b - A*x)/A_ii;
+      const double step = sqrt(graph.map_reduce_vertices<gather_type>(cheb_step).training_rmse);
+      if (warmup > 0){
+        //plain jacobi steps, the ratio of successive steps converges to rho
+        if (prev_step > 0)
+          rho = step / prev_step;
+        cheb_omega = 1;
+        if (--warmup == 0){
+          if (rho >= 1){
+            logstream(LOG_WARNING)<<"Jacobi does not converge (rho = " << rho << "), not accelerating" << std::endl;
+            warmup = -1;
+          }
+          else {
+            dc.cout() << "Estimated spectral radius: " << rho << std::endl;
+            cheb_steps = 0;
+          }
+        }
+      }
+      else if (warmup == 0){
+        if (cheb_steps > 0 && step > 2 * min_step){
+          //rho was underestimated, estimate it again
+          dc.cout() << "Chebyshev diverging, estimating spectral radius again" << std::endl;
+          warmup = CHEB_WARMUP;
+          cheb_omega = 1;
+        }
+        else {
+          cheb_omega = (cheb_steps == 0) ? 1 / (1 - rho*rho/2) : 1 / (1 - rho*rho*cheb_omega/4);
+          min_step = (cheb_steps == 0) ? step : std::min(min_step, step);
+          cheb_steps++;
+        }
+      }
+      graph.transform_vertices(cheb_update);
+      prev_step = step;
+      PRINT_VEC(x);
+      if (!quiet)
+        dc.cout() << "Iteration " << iterations << " step " << step << " omega " << cheb_omega << std::endl;
+      if (step < tol){
+        iterations++;
+        break;
+      }
+    }
+  }
+  else if (solver == "cg"){
+    DistVec r(info, JACOBI_R, true, "r");
+    DistVec p(info, JACOBI_P, true, "p");
+    DistVec q(info, JACOBI_Q, true, "q");
+    mi.use_diag = true;
+    r = b - A*x;
+    cg_beta = 0;
+    graph.transform_vertices(cg_direction);
+    double rz = graph.map_reduce_vertices<gather_type>(cg_residual).validation_rmse;
+    for (; iterations < max_iter; iterations++){
+      mi.use_diag = true;
+      q = A*p;
+      const double pq = graph.map_reduce_vertices<gather_type>(cg_pq).training_rmse;
+      if (pq <= 0){
+        logstream(LOG_WARNING)<<"p'Ap = " << pq << ", matrix is not positive definite" << std::endl;
+        break;
+      }
+      cg_alpha = rz / pq;
+      graph.transform_vertices(cg_step);
+      gather_type ret = graph.map_reduce_vertices<gather_type>(cg_residual);
+      PRINT_VEC(x);
+      if (!quiet)
+        dc.cout() << "Iteration " << iterations << " residual " << sqrt(ret.training_rmse) << std::endl;
+      if (sqrt(ret.training_rmse) < tol){
+        iterations++;
+        break;
+      }
+      cg_beta = ret.validation_rmse / rz;
+      rz = ret.validation_rmse;
+      graph.transform_vertices(cg_direction);
+    }
+  }
+  else {
+    for (; iterations < max_iter; iterations++){
+      mi.use_diag = false;
+      x = (b - A*x)/A_ii;
+      PRINT_VEC(x);
+    }
+  }
  
-  dc.cout() << "Jacobi finished in " << runtime << std::endl;
-  dc.cout() << "\t Updates: " << engine.num_updates() << std::endl;
+  dc.cout() << "Jacobi finished in " << timer.current_time() << std::endl;
+  dc.cout() << "\t Updates: " << engine.num_updates() + gs_updates << std::endl;
+  if (solver != "gauss_seidel")
+    dc.cout() << "\t Iterations: " << iterations << std::endl;
 
     DistVec p(info, JACOBI_PREV_X, true, "p");
     mi.use_diag = true;
@@ -337,13 +567,14 @@ int main(int argc, char** argv) {
   //vec ret = fill_output(&core.graph(), info, JACOBI_X);
   //write_output_vector(datafile + "x.out", format, ret, false);
   const double runtime = timer.current_time();
+  const size_t updates = engine.num_updates() + gs_updates;
   dc.cout() << "----------------------------------------------------------"
     << std::endl
     << "Final Runtime (seconds):   " << runtime 
                                         << std::endl
-                                        << "Updates executed: " << engine.num_updates() << std::endl
+                                        << "Updates executed: " << updates << std::endl
                                         << "Update Rate (updates/second): " 
-                                          << engine.num_updates() / runtime << std::endl;
+                                          << updates / runtime << std::endl;
 
   graph.save("x.out", linear_model_saver(JACOBI_X), false, true, false, 1);
   graphlab::mpi_tools::finalize();
@@ -32,6 +32,7 @@
 
 #include <vector>
 #include <algorithm>
+#include <limits>
 
 #include <graphlab/ui/mongoose/mongoose.h>
 #include <boost/math/special_functions/gamma.hpp>
@@ -42,7 +43,6 @@
 #include <boost/spirit/include/phoenix_core.hpp>
 #include <boost/spirit/include/phoenix_operator.hpp>
 #include <boost/spirit/include/phoenix_stl.hpp>
-#include <graphlab/parallel/atomic.hpp>
 
 
 
@@ -51,36 +51,7 @@
 typedef long count_type;
 
 
-/**
- * \brief The factor type is used to store the counts of tokens in
- * each topic for words, documents, and assignments.
- *
- * Atomic counts are used because we violate the abstraction by
- * modifying adjacent vertex data on scatter.  As a consequence
- * multiple threads on the same machine may try to update the same
- * vertex data at the same time.  The graphlab::atomic type ensures
- * that multiple increments are serially consistent.
- */
-typedef std::vector< graphlab::atomic<count_type> > factor_type;
-
-
-/**
- * \brief We use the factor type in accumulators and so we define an
- * operator+=
- */
-inline factor_type& operator+=(factor_type& lvalue,
-                               const factor_type& rvalue) {
-  if(!rvalue.empty()) {
-    if(lvalue.empty()) lvalue = rvalue;
-    else {
-      for(size_t t = 0; t < lvalue.size(); ++t) lvalue[t] += rvalue[t];
-    }
-  }
-  return lvalue;
-} // end of operator +=
-
-// We include the rest of GraphLab after we define the operator+= for
-// vector.
+// We include the rest of GraphLab
 #include <graphlab.hpp>
 #include <graphlab/macros_def.hpp>
 
@@ -161,11 +132,17 @@ size_t INTERVAL = 10;
  */
 size_t LIK_INTERVAL = 5;
 
+/**
+ * \brief The number of Metropolis-Hastings steps (each a document
+ * proposal followed by a word proposal) taken for each token.
+ */
+size_t MH_STEPS = 2;
+
 /**
  * \brief The global variable storing the global topic count across
  * all machines.  This is maintained periodically using aggregation.
  */
-factor_type GLOBAL_TOPIC_COUNT;
+std::vector<count_type> GLOBAL_TOPIC_COUNT;
 
 /**
  * \brief A dictionary of words used to print the top words during
@@ -231,12 +208,168 @@ word_cloud_callback(std::map<std::string, std::string>& varmap) {
 DECLARE_EVENT(TOKEN_CHANGES);
 
 
+// Topic Counts
+// ============================================================================
+
+/**
+ * \brief The counts of tokens in each topic for a word, a document or
+ * a sum of assignments.
+ *
+ * With many topics most documents and most words only use a few of
+ * them, so the counts are stored as the nonzero (topic, count) pairs
+ * sorted by topic.  Sums which become dense (as the sum of the edges
+ * of a frequent word) switch to a vector of NTOPICS counts so that
+ * accumulating stays proportional to the number of tokens added.
+ * The counts stored in the vertex data are always sparse.
+ */
+class topic_counts {
+public:
+  typedef std::pair<topic_id_type, count_type> entry_type;
+
+  /** \brief The nonzero counts sorted by topic if not dense */
+  std::vector<entry_type> sparse;
+  /** \brief The counts of every topic if not empty */
+  std::vector<count_type> dense;
+
+  /** \brief Counts of a sparse sum above this size are kept dense */
+  static size_t dense_threshold() { return std::max(NTOPICS / 16, size_t(16)); }
+
+  /** \brief The counts of a list of assignments */
+  explicit topic_counts(const std::vector<topic_id_type>& assignment =
+                        std::vector<topic_id_type>()) {
+    std::vector<topic_id_type> topics;
+    foreach(topic_id_type asg, assignment) {
+      if(asg != NULL_TOPIC) topics.push_back(asg);
+    }
+    std::sort(topics.begin(), topics.end());
+    for(size_t i = 0; i < topics.size(); ++i) {
+      if(sparse.empty() || sparse.back().first != topics[i])
+        sparse.push_back(entry_type(topics[i], 0));
+      ++sparse.back().second;
+    }
+  }
+
+  /** \brief The count of topic t */
+  count_type operator[](topic_id_type t) const {
+    if(!dense.empty()) return dense[t];
+    std::vector<entry_type>::const_iterator iter =
+      std::lower_bound(sparse.begin(), sparse.end(),
+                       entry_type(t, std::numeric_limits<count_type>::min()));
+    return (iter != sparse.end() && iter->first == t)? iter->second : 0;
+  }
+
+  /** \brief Convert dense counts back to the sparse form */
+  void make_sparse() {
+    if(dense.empty()) return;
+    sparse.clear();
+    for(size_t t = 0; t < dense.size(); ++t) {
+      if(dense[t] != 0) sparse.push_back(entry_type(t, dense[t]));
+    }
+    std::vector<count_type>().swap(dense);
+  }
+
+  topic_counts& operator+=(const topic_counts& other) {
+    if(dense.empty() && other.dense.empty() &&
+       sparse.size() + other.sparse.size() <= dense_threshold()) {
+      // merge the two sorted lists
+      std::vector<entry_type> merged;
+      merged.reserve(sparse.size() + other.sparse.size());
+      size_t i = 0, j = 0;
+      while(i < sparse.size() || j < other.sparse.size()) {
+        if(j == other.sparse.size() ||
+           (i < sparse.size() && sparse[i].first < other.sparse[j].first)) {
+          merged.push_back(sparse[i++]);
+        } else if(i == sparse.size() ||
+                  other.sparse[j].first < sparse[i].first) {
+          merged.push_back(other.sparse[j++]);
+        } else {
+          merged.push_back(entry_type(sparse[i].first,
+                                      sparse[i].second + other.sparse[j].second));
+          ++i; ++j;
+        }
+      }
+      sparse.swap(merged);
+      return *this;
+    }
+    if(dense.empty()) {
+      dense.resize(NTOPICS, 0);
+      foreach(const entry_type& entry, sparse) dense[entry.first] += entry.second;
+      std::vector<entry_type>().swap(sparse);
+    }
+    if(!other.dense.empty()) {
+      for(size_t t = 0; t < dense.size(); ++t) dense[t] += other.dense[t];
+    } else {
+      foreach(const entry_type& entry, other.sparse)
+        dense[entry.first] += entry.second;
+    }
+    return *this;
+  } // end of operator +=
+
+  void save(graphlab::oarchive& arc) const { arc << sparse << dense; }
+  void load(graphlab::iarchive& arc) { arc >> sparse >> dense; }
+}; // end of topic_counts
+
+
+/**
+ * \brief An alias table (Walker, Vose) samples a topic with
+ * probability proportional to its count in constant time.
+ *
+ * The table is built from sparse counts in time linear in the number
+ * of nonzero counts.
+ */
+class alias_table {
+  std::vector<float> prob;
+  std::vector<topic_id_type> topic, alias;
+  count_type total;
+public:
+  alias_table() : total(0) { }
+
+  /** \brief The sum of the counts the table was built from */
+  count_type weight() const { return total; }
+
+  void build(const topic_counts& counts) {
+    const std::vector<topic_counts::entry_type>& entries = counts.sparse;
+    const size_t n = entries.size();
+    prob.resize(n); topic.resize(n); alias.resize(n);
+    total = 0;
+    foreach(const topic_counts::entry_type& entry, entries) total += entry.second;
+    std::vector<size_t> small, large;
+    for(size_t i = 0; i < n; ++i) {
+      topic[i] = alias[i] = entries[i].first;
+      prob[i] = float(double(entries[i].second) * n / total);
+      if(prob[i] < 1) small.push_back(i); else large.push_back(i);
+    }
+    while(!small.empty() && !large.empty()) {
+      const size_t s = small.back(); small.pop_back();
+      const size_t l = large.back();
+      alias[s] = topic[l];
+      prob[l] -= 1 - prob[s];
+      if(prob[l] < 1) { large.pop_back(); small.push_back(l); }
+    }
+    // what is left over is 1 up to rounding
+    foreach(size_t i, small) prob[i] = 1;
+    foreach(size_t i, large) prob[i] = 1;
+  } // end of build
+
+  /** \brief Draw a topic; the table must not be empty */
+  topic_id_type sample() const {
+    const size_t i = graphlab::random::fast_uniform(size_t(0), prob.size() - 1);
+    return graphlab::random::rand01() < prob[i]? topic[i] : alias[i];
+  }
+}; // end of alias_table
+
+
+
 // Graph Types
 // ============================================================================
 
 /**
  * \brief The vertex data represents each term and document in the
  * corpus and contains the counts of tokens in each topic.
+ *
+ * The alias table over the counts is used to propose topics and is
+ * rebuilt whenever the counts change (in apply and when a mirror
+ * receives new counts) rather than being sent over the network.
  */
 struct vertex_data {
   ///! The total number of updates
@@ -244,13 +377,16 @@ struct vertex_data {
   ///! The total number of changes to adjacent tokens
   uint32_t nchanges;
   ///! The count of tokens in each topic
-  factor_type factor;
-  vertex_data() : nupdates(0), nchanges(0), factor(NTOPICS) { }
+  topic_counts counts;
+  ///! Samples topics proportionally to counts
+  alias_table proposal;
+  vertex_data() : nupdates(0), nchanges(0) { }
   void save(graphlab::oarchive& arc) const {
-    arc << nupdates << nchanges << factor;
+    arc << nupdates << nchanges << counts;
   }
   void load(graphlab::iarchive& arc) {
-    arc >> nupdates >> nchanges >> factor;
+    arc >> nupdates >> nchanges >> counts;
+    proposal.build(counts);
   }
 }; // end of vertex_data
 
@@ -413,14 +549,15 @@ get_other_vertex(const graph_type::edge_type& edge,
  *
  */
 struct gather_type {
-  factor_type factor;
+  topic_counts counts;
   uint32_t nchanges;
   gather_type() : nchanges(0) { };
-  gather_type(uint32_t nchanges) : factor(NTOPICS), nchanges(nchanges) { };
-  void save(graphlab::oarchive& arc) const { arc << factor << nchanges; }
-  void load(graphlab::iarchive& arc) { arc >> factor >> nchanges; }
+  gather_type(const assignment_type& assignment, uint32_t nchanges) :
+    counts(assignment), nchanges(nchanges) { };
+  void save(graphlab::oarchive& arc) const { arc << counts << nchanges; }
+  void load(graphlab::iarchive& arc) { arc >> counts >> nchanges; }
   gather_type& operator+=(const gather_type& other) {
-    factor += other.factor;
+    counts += other.counts;
     nchanges += other.nchanges;
     return *this;
   }
@@ -428,8 +565,58 @@ struct gather_type {
 
 
 
+/**
+ * \brief The (unnormalized) conditional probability of assigning a
+ * token to topic t given all other assignments.
+ *
+ * The counts of the document, the word and GLOBAL_TOPIC_COUNT still
+ * include the token in its old topic which is therefore removed (the
+ * cavity).  Counts can be slightly stale and so are kept nonnegative.
+ */
+inline double conditional(const vertex_data& doc, const vertex_data& word,
+                          topic_id_type old_asg, topic_id_type t) {
+  const count_type cavity = (t == old_asg)? 1 : 0;
+  const double n_dt =
+    std::max(doc.counts[t] - cavity, count_type(0));
+  const double n_wt =
+    std::max(word.counts[t] - cavity, count_type(0));
+  const double n_t =
+    std::max(GLOBAL_TOPIC_COUNT[t] - cavity, count_type(0));
+  return (ALPHA + n_dt) * (BETA + n_wt) / (BETA * NWORDS + n_t);
+} // end of conditional
 
 
+/**
+ * \brief One Metropolis-Hastings step from topic s using the proposal
+ * q(t) proportional to count(t) + prior of the given vertex (the
+ * document with the alpha prior or the word with the beta prior).
+ *
+ * The proposal is a mixture of the alias table of the counts and a
+ * uniform topic so it is drawn in constant time.  p_s is the
+ * conditional of s and is updated when the proposal is accepted.
+ */
+inline topic_id_type mh_step(const vertex_data& doc, const vertex_data& word,
+                             const vertex_data& proposer, double prior,
+                             topic_id_type old_asg,
+                             topic_id_type s, double& p_s) {
+  const double total = proposer.proposal.weight();
+  topic_id_type t;
+  if(graphlab::random::rand01() * (total + NTOPICS * prior) < total) {
+    t = proposer.proposal.sample();
+  } else {
+    t = graphlab::random::fast_uniform(size_t(0), NTOPICS - 1);
+  }
+  if(t == s) return s;
+  const double p_t = conditional(doc, word, old_asg, t);
+  const double accept = (p_t * (proposer.counts[s] + prior)) /
+    (p_s * (proposer.counts[t] + prior));
+  if(accept >= 1 || graphlab::random::rand01() < accept) {
+    p_s = p_t;
+    return t;
+  }
+  return s;
+} // end of mh_step
+
 
 
 /**
@@ -460,12 +647,7 @@ public:
    */
   gather_type gather(icontext_type& context, const vertex_type& vertex,
                      edge_type& edge) const {
-    gather_type ret(edge.data().nchanges);
-    const assignment_type& assignment = edge.data().assignment;
-    foreach(topic_id_type asg, assignment) {
-      if(asg != NULL_TOPIC) ++ret.factor[asg];
-    }
-    return ret;
+    return gather_type(edge.data().assignment, edge.data().nchanges);
   } // end of gather
 
 
@@ -480,11 +662,11 @@ public:
     ASSERT_GT(num_neighbors, 0);
     // There should be no new edge data since the vertex program has been cleared
     vertex_data& vdata = vertex.data();
-    ASSERT_EQ(sum.factor.size(), NTOPICS);
-    ASSERT_EQ(vdata.factor.size(), NTOPICS);
     vdata.nupdates++;
     vdata.nchanges = sum.nchanges;
-    vdata.factor = sum.factor;
+    vdata.counts = sum.counts;
+    vdata.counts.make_sparse();
+    vdata.proposal.build(vdata.counts);
   } // end of apply
 
 
@@ -503,50 +685,34 @@ public:
   /**
    * \brief Draw new topic assignments for each edge token.
    *
-   * Note that we exploit the GraphLab caching model here by DIRECTLY
-   * modifying the topic counts of adjacent vertices.  Making the
-   * changes immediately visible to any adjacent vertex programs
-   * running on the same machine.  However, these changes will be
-   * overwritten during the apply step and are only used to accelerate
-   * sampling.  This is a potentially dangerous violation of the
-   * abstraction and should be taken with caution.  In our case all
-   * vertex topic counts are preallocated and atomic operations are
-   * used.  In addition during the sampling phase we must be careful
-   * to guard against potentially negative temporary counts.
+   * Rather than computing the conditional of all NTOPICS topics each
+   * token takes MH_STEPS Metropolis-Hastings steps alternating between
+   * a document proposal and a word proposal (Yuan et al., LightLDA),
+   * each drawn in constant time from the alias tables of the adjacent
+   * vertices.  The counts are only read: they are updated from the
+   * new assignments when the adjacent vertices next run apply.  This
+   * delays the effect of a change on other tokens but needs neither
+   * atomic counts nor dense counts and keeps the acceptance
+   * probabilities consistent with the proposals.
    */
   void scatter(icontext_type& context, const vertex_type& vertex,
                edge_type& edge) const {
-    factor_type& doc_topic_count =  is_doc(edge.source()) ?
-      edge.source().data().factor : edge.target().data().factor;
-    factor_type& word_topic_count = is_word(edge.source()) ?
-      edge.source().data().factor : edge.target().data().factor;
-    ASSERT_EQ(doc_topic_count.size(), NTOPICS);
-    ASSERT_EQ(word_topic_count.size(), NTOPICS);
-    // run the actual gibbs sampling
-    std::vector<double> prob(NTOPICS);
+    const vertex_data& doc = is_doc(edge.source()) ?
+      edge.source().data() : edge.target().data();
+    const vertex_data& word = is_word(edge.source()) ?
+      edge.source().data() : edge.target().data();
     assignment_type& assignment = edge.data().assignment;
     edge.data().nchanges = 0;
     foreach(topic_id_type& asg, assignment) {
       const topic_id_type old_asg = asg;
-      if(asg != NULL_TOPIC) { // construct the cavity
-        --doc_topic_count[asg];
-        --word_topic_count[asg];
-        --GLOBAL_TOPIC_COUNT[asg];
+      topic_id_type s = (asg != NULL_TOPIC)? asg :
+        topic_id_type(graphlab::random::fast_uniform(size_t(0), NTOPICS - 1));
+      double p_s = conditional(doc, word, old_asg, s);
+      for(size_t i = 0; i < MH_STEPS; ++i) {
+        s = mh_step(doc, word, doc, ALPHA, old_asg, s, p_s);
+        s = mh_step(doc, word, word, BETA, old_asg, s, p_s);
       }
-      for(size_t t = 0; t < NTOPICS; ++t) {
-        const double n_dt =
-          std::max(count_type(doc_topic_count[t]), count_type(0));
-        const double n_wt =
-          std::max(count_type(word_topic_count[t]), count_type(0));
-        const double n_t  =
-          std::max(count_type(GLOBAL_TOPIC_COUNT[t]), count_type(0));
-        prob[t] = (ALPHA + n_dt) * (BETA + n_wt) / (BETA * NWORDS + n_t);
-      }
-      asg = graphlab::random::multinomial(prob);
-      // asg = std::max_element(prob.begin(), prob.end()) - prob.begin();
-      ++doc_topic_count[asg];
-      ++word_topic_count[asg];
-      ++GLOBAL_TOPIC_COUNT[asg];
+      asg = s;
       if(asg != old_asg) {
         ++edge.data().nchanges;
         INCREMENT_EVENT(TOKEN_CHANGES,1);
@@ -618,10 +784,10 @@ public:
     ret_value.nupdates = vdata.nupdates;
     if(is_word(vertex)) {
       const graphlab::vertex_id_type wordid = vertex.id();
-      ret_value.top_words.resize(vdata.factor.size());
-      for(size_t i = 0; i < vdata.factor.size(); ++i) {
-        const cw_pair_type pair(vdata.factor[i], wordid);
-        ret_value.top_words[i].insert(pair);
+      ret_value.top_words.resize(NTOPICS);
+      foreach(const topic_counts::entry_type& entry, vdata.counts.sparse) {
+        const cw_pair_type pair(entry.second, wordid);
+        ret_value.top_words[entry.first].insert(pair);
       }
     }
     return ret_value;
@@ -667,21 +833,20 @@ public:
 
 /**
  * \brief The global counts aggregator computes the total number of
- * tokens in each topic across all words and documents and then
- * updates the \ref GLOBAL_TOPIC_COUNT variable.
+ * tokens in each topic across all words and then updates the \ref
+ * GLOBAL_TOPIC_COUNT variable.
  *
  */
 struct global_counts_aggregator {
   typedef graph_type::vertex_type vertex_type;
-  static factor_type map(icontext_type& context, const vertex_type& vertex) {
-    return vertex.data().factor;
+  static topic_counts map(icontext_type& context, const vertex_type& vertex) {
+    return is_word(vertex)? vertex.data().counts : topic_counts();
   } // end of map function
 
-  static void finalize(icontext_type& context, const factor_type& total) {
+  static void finalize(icontext_type& context, const topic_counts& total) {
     size_t sum = 0;
-    for(size_t t = 0; t < total.size(); ++t) {
-      GLOBAL_TOPIC_COUNT[t] =
-        std::max(count_type(total[t]/2), count_type(0));
+    for(size_t t = 0; t < NTOPICS; ++t) {
+      GLOBAL_TOPIC_COUNT[t] = std::max(total[t], count_type(0));
       sum += GLOBAL_TOPIC_COUNT[t];
     }
     context.cout() << "Total Tokens: " << sum << std::endl;
@@ -765,23 +930,27 @@ public:
   static likelihood_aggregator
   map(icontext_type& context, const vertex_type& vertex) {
     // using boost::math::lgamma;
-    const factor_type& factor = vertex.data().factor;
-    ASSERT_EQ(factor.size(), NTOPICS);
+    // The topics with a zero count each contribute log gamma of the prior
+    const std::vector<topic_counts::entry_type>& counts =
+      vertex.data().counts.sparse;
+    const double nzeros = NTOPICS - counts.size();
     likelihood_aggregator ret;
     if(is_word(vertex)) {
-      for(size_t t = 0; t < NTOPICS; ++t) {
-        const count_type value = std::max(count_type(factor[t]), count_type(0));
+      foreach(const topic_counts::entry_type& entry, counts) {
+        const count_type value = std::max(entry.second, count_type(0));
         //ret.lik_words_given_topics += lgamma(value + BETA);
         ret.lik_words_given_topics += BETA_LGAMMA(value);
       }
+      ret.lik_words_given_topics += nzeros * BETA_LGAMMA(0);
     } else {  ASSERT_TRUE(is_doc(vertex));
       double ntokens_in_doc = 0;
-      for(size_t t = 0; t < NTOPICS; ++t) {
-        const count_type value = std::max(count_type(factor[t]), count_type(0));
+      foreach(const topic_counts::entry_type& entry, counts) {
+        const count_type value = std::max(entry.second, count_type(0));
         //ret.lik_topics += lgamma(value + ALPHA);
         ret.lik_topics += ALPHA_LGAMMA(value);
         ntokens_in_doc += value;
       }
+      ret.lik_topics += nzeros * ALPHA_LGAMMA(0);
       ret.lik_topics -= lgamma(ntokens_in_doc + NTOPICS * ALPHA);
     }
     return ret;
@@ -1022,10 +1191,14 @@ struct count_saver {
       const graphlab::vertex_id_type vid = (-vertex.id()) - 2;
       strm << vid << '\t';
     }
-    const factor_type& factor = vertex.data().factor;
-    for(size_t i = 0; i < factor.size(); ++i) { 
-      strm << factor[i];
-      if(i+1 < factor.size()) strm << '\t';
+    const std::vector<topic_counts::entry_type>& counts =
+      vertex.data().counts.sparse;
+    size_t next = 0;
+    for(size_t i = 0; i < NTOPICS; ++i) { 
+      if(next < counts.size() && counts[next].first == i) {
+        strm << counts[next++].second;
+      } else strm << 0;
+      if(i+1 < NTOPICS) strm << '\t';
     }
     strm << '\n';
     return strm.str();
@@ -1113,6 +1286,9 @@ int main(int argc, char** argv) {
                        "statistics reporting interval (in seconds)");
   clopts.attach_option("lik_interval", LIK_INTERVAL,
                        "likelihood reporting interval (in seconds)");
+  clopts.attach_option("mh_steps", MH_STEPS,
+                       "The number of Metropolis-Hastings steps (a document "
+                       "and a word proposal) taken for each token.");
   clopts.attach_option("max_count", MAX_COUNT,
                        "The maximum number of occurences of a word in a document.");
   clopts.attach_option("format", format,
@@ -1162,6 +1338,12 @@ int main(int argc, char** argv) {
     return EXIT_FAILURE;
   }
 
+  if(NTOPICS == 0 || NTOPICS >= size_t(NULL_TOPIC)) {
+    logstream(LOG_ERROR) 
+      << "The number of topics must be in [1, " << NULL_TOPIC << ")!" << std::endl;
+    return EXIT_FAILURE;
+  }
+
   if(BETA <= 0) {
     logstream(LOG_ERROR) 
       << "Beta must be positive (beta=" << BETA << ")!"  << std::endl;
@@ -1202,7 +1384,7 @@ int main(int argc, char** argv) {
 
   { // Add the Global counts aggregator
     const bool success =
-      engine.add_vertex_aggregator<factor_type>
+      engine.add_vertex_aggregator<topic_counts>
       ("global_counts", 
        global_counts_aggregator::map, 
        global_counts_aggregator::finalize) &&